@@ -0,0 +1,121 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "FrustumCull.h"
+
+#include <math.h>
+
+#if !defined(TEAPOT_FRUSTUMCULL_SCALAR)
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define TEAPOT_FRUSTUMCULL_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(__x86_64__)
+#define TEAPOT_FRUSTUMCULL_SSE2 1
+#include <emmintrin.h>
+#endif
+#endif
+
+void ExtractFrustum(const float *m, FRUSTUM *frustum) {
+  // Row i of the column major matrix is m[i], m[4 + i], m[8 + i], m[12 + i];
+  // each plane is the w row plus or minus the x, y or z row
+  for (int32_t p = 0; p < 6; ++p) {
+    int32_t row = p / 2;
+    float sign = (p & 1) ? -1.f : 1.f;
+    float *plane = frustum->planes[p];
+    for (int32_t c = 0; c < 4; ++c) {
+      plane[c] = m[c * 4 + 3] + sign * m[c * 4 + row];
+    }
+    float length =
+        sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+    float scale = length > 0.f ? 1.f / length : 0.f;
+    for (int32_t c = 0; c < 4; ++c) plane[c] *= scale;
+  }
+}
+
+size_t CullSpheresScalar(const FRUSTUM &frustum, const SPHERES_SOA &spheres,
+                         size_t first, uint32_t *visible) {
+  size_t count = 0;
+  for (size_t i = first; i < spheres.Size(); ++i) {
+    bool inside = true;
+    for (int32_t p = 0; p < 6; ++p) {
+      const float *plane = frustum.planes[p];
+      float d = plane[0] * spheres.x[i] + plane[1] * spheres.y[i] +
+                plane[2] * spheres.z[i] + plane[3];
+      inside = inside && d >= -spheres.radius[i];
+    }
+    visible[count] = static_cast<uint32_t>(i);
+    count += inside ? 1 : 0;
+  }
+  return count;
+}
+
+size_t CullSpheres(const FRUSTUM &frustum, const SPHERES_SOA &spheres,
+                   uint32_t *visible) {
+  const size_t size = spheres.Size();
+  size_t count = 0;
+  size_t i = 0;
+#if defined(TEAPOT_FRUSTUMCULL_NEON)
+  static const uint32_t kLaneBits[4] = {1, 2, 4, 8};
+  const uint32x4_t lane_bits = vld1q_u32(kLaneBits);
+  for (; i + 4 <= size; i += 4) {
+    float32x4_t x = vld1q_f32(&spheres.x[i]);
+    float32x4_t y = vld1q_f32(&spheres.y[i]);
+    float32x4_t z = vld1q_f32(&spheres.z[i]);
+    float32x4_t neg_r = vnegq_f32(vld1q_f32(&spheres.radius[i]));
+    uint32x4_t inside = vdupq_n_u32(0xFFFFFFFF);
+    for (int32_t p = 0; p < 6; ++p) {
+      const float *plane = frustum.planes[p];
+      float32x4_t d = vmlaq_n_f32(vdupq_n_f32(plane[3]), x, plane[0]);
+      d = vmlaq_n_f32(d, y, plane[1]);
+      d = vmlaq_n_f32(d, z, plane[2]);
+      inside = vandq_u32(inside, vcgeq_f32(d, neg_r));
+    }
+    // One bit per lane, like _mm_movemask_ps
+    uint32x4_t bits = vandq_u32(inside, lane_bits);
+    uint32x2_t sum = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+    uint32_t mask = vget_lane_u32(vpadd_u32(sum, sum), 0);
+    // Branchless compaction, a rejected index is overwritten by the next
+    for (uint32_t lane = 0; lane < 4; ++lane) {
+      visible[count] = static_cast<uint32_t>(i + lane);
+      count += (mask >> lane) & 1;
+    }
+  }
+#elif defined(TEAPOT_FRUSTUMCULL_SSE2)
+  for (; i + 4 <= size; i += 4) {
+    __m128 x = _mm_loadu_ps(&spheres.x[i]);
+    __m128 y = _mm_loadu_ps(&spheres.y[i]);
+    __m128 z = _mm_loadu_ps(&spheres.z[i]);
+    __m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int32_t p = 0; p < 6; ++p) {
+      const float *plane = frustum.planes[p];
+      __m128 d = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane[0])),
+                            _mm_set1_ps(plane[3]));
+      d = _mm_add_ps(d, _mm_mul_ps(y, _mm_set1_ps(plane[1])));
+      d = _mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(plane[2])));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(d, neg_r));
+    }
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+    // Branchless compaction, a rejected index is overwritten by the next
+    for (uint32_t lane = 0; lane < 4; ++lane) {
+      visible[count] = static_cast<uint32_t>(i + lane);
+      count += (mask >> lane) & 1;
+    }
+  }
+#endif
+  return count + CullSpheresScalar(frustum, spheres, i, visible + count);
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// FrustumCull.h
+// View frustum culling of bounding spheres, four at a time with NEON or
+// SSE2. Keep it free of Android and GL includes.
+//--------------------------------------------------------------------------------
+#ifndef TEAPOTS_FRUSTUMCULL_H
+#define TEAPOTS_FRUSTUMCULL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/**
+ * Left, right, bottom, top, near and far planes as (a, b, c, d), with
+ * a * x + b * y + c * z + d >= 0 on the inside and (a, b, c) of unit length.
+ */
+struct FRUSTUM {
+  float planes[6][4];
+};
+
+/**
+ * Bounding spheres in structure of arrays layout, so four of them load
+ * into one register per component.
+ */
+struct SPHERES_SOA {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+  std::vector<float> radius;
+
+  void Resize(size_t count) {
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    radius.resize(count);
+  }
+  size_t Size() const { return x.size(); }
+};
+
+// Planes of clip = matrix * p, matrix column major like ndk_helper::Mat4
+void ExtractFrustum(const float *matrix, FRUSTUM *frustum);
+
+/**
+ * Write the indices of the spheres inside or crossing the frustum to
+ * visible, in increasing order, and return how many there are. visible
+ * needs room for every sphere. Uses NEON or SSE2 when available.
+ */
+size_t CullSpheres(const FRUSTUM &frustum, const SPHERES_SOA &spheres,
+                   uint32_t *visible);
+
+// One sphere at a time, the reference for the SIMD paths
+size_t CullSpheresScalar(const FRUSTUM &frustum, const SPHERES_SOA &spheres,
+                         size_t first, uint32_t *visible);
+
+#endif  // TEAPOTS_FRUSTUMCULL_H
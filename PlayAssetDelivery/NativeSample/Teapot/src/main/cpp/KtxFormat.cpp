@@ -0,0 +1,200 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "KtxFormat.h"
+
+#include <string.h>
+
+#include "MipChain.h"
+
+namespace {
+
+// ASTC block footprints in the order of both the GL and the Vulkan enums
+const uint8_t kAstcBlocks[14][2] = {
+    {4, 4}, {5, 4}, {5, 5}, {6, 5},  {6, 6},   {8, 5},   {8, 6},
+    {8, 8}, {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12}};
+
+// VK_FORMAT_* values of the formats in KTX_FORMAT
+const uint32_t kVkEtc2Rgb8 = 147;
+const uint32_t kVkEtc2Srgb8 = 148;
+const uint32_t kVkEtc2Rgba8 = 151;
+const uint32_t kVkEtc2Srgb8Alpha8 = 152;
+const uint32_t kVkAstc4x4Unorm = 157;  // UNORM/SRGB pairs up to 12x12
+const uint32_t kVkAstc12x12Srgb = 184;
+
+bool BlockInfo(uint32_t format, uint32_t *block_width, uint32_t *block_height,
+               uint32_t *block_bytes) {
+  switch (format) {
+    case KTX_FORMAT_ETC1_RGB8:
+    case KTX_FORMAT_ETC2_RGB8:
+    case KTX_FORMAT_ETC2_SRGB8:
+      *block_width = *block_height = 4;
+      *block_bytes = 8;
+      return true;
+    case KTX_FORMAT_ETC2_RGBA8:
+    case KTX_FORMAT_ETC2_SRGB8_ALPHA8:
+      *block_width = *block_height = 4;
+      *block_bytes = 16;
+      return true;
+    default:
+      break;
+  }
+  if (!KtxIsAstc(format)) return false;
+  uint32_t index = format >= KTX_FORMAT_SRGB8_ALPHA8_ASTC_4x4
+                       ? format - KTX_FORMAT_SRGB8_ALPHA8_ASTC_4x4
+                       : format - KTX_FORMAT_ASTC_4x4;
+  *block_width = kAstcBlocks[index][0];
+  *block_height = kAstcBlocks[index][1];
+  *block_bytes = 16;
+  return true;
+}
+
+uint32_t VkFormatToGl(uint32_t vk_format) {
+  switch (vk_format) {
+    case kVkEtc2Rgb8:
+      return KTX_FORMAT_ETC2_RGB8;
+    case kVkEtc2Srgb8:
+      return KTX_FORMAT_ETC2_SRGB8;
+    case kVkEtc2Rgba8:
+      return KTX_FORMAT_ETC2_RGBA8;
+    case kVkEtc2Srgb8Alpha8:
+      return KTX_FORMAT_ETC2_SRGB8_ALPHA8;
+    default:
+      break;
+  }
+  if (vk_format >= kVkAstc4x4Unorm && vk_format <= kVkAstc12x12Srgb) {
+    uint32_t index = (vk_format - kVkAstc4x4Unorm) / 2;
+    bool srgb = (vk_format - kVkAstc4x4Unorm) & 1;
+    return (srgb ? KTX_FORMAT_SRGB8_ALPHA8_ASTC_4x4 : KTX_FORMAT_ASTC_4x4) +
+           index;
+  }
+  return 0;
+}
+
+// Byte size of a mip level, 0 for an unknown format
+uint64_t LevelSize(uint32_t format, uint32_t width, uint32_t height) {
+  uint32_t block_width, block_height, block_bytes;
+  if (!BlockInfo(format, &block_width, &block_height, &block_bytes)) return 0;
+  uint64_t blocks_x = (width + block_width - 1) / block_width;
+  uint64_t blocks_y = (height + block_height - 1) / block_height;
+  return blocks_x * blocks_y * block_bytes;
+}
+
+/**
+ * Most levels a width x height texture can have, 0 for a size no GL
+ * accepts. Also keeps the shifts of MipSize() below 32 bits.
+ */
+uint32_t MaxLevelCount(uint32_t width, uint32_t height) {
+  const uint32_t kMaxDimension = 1 << 16;
+  if (width == 0 || height == 0 || width > kMaxDimension ||
+      height > kMaxDimension)
+    return 0;
+  return static_cast<uint32_t>(MipLevelCount(width, height));
+}
+
+uint32_t MipSize(uint32_t size, uint32_t level) {
+  uint32_t s = size >> level;
+  return s ? s : 1;
+}
+
+bool ParseKtx1(const uint8_t *data, size_t size, KTX_TEXTURE *texture) {
+  KTX1_HEADER header;
+  if (size < sizeof(header)) return false;
+  memcpy(&header, data, sizeof(header));
+  // Files written on a big endian machine are not worth supporting
+  if (header.endianness != kKtxEndianness) return false;
+  if (header.gl_type != 0 || header.pixel_depth > 1 ||
+      header.number_of_array_elements > 0 || header.number_of_faces != 1)
+    return false;
+
+  texture->internal_format = header.gl_internal_format;
+  texture->width = header.pixel_width;
+  texture->height = header.pixel_height;
+  uint32_t level_count =
+      header.number_of_mipmap_levels ? header.number_of_mipmap_levels : 1;
+  if (level_count > MaxLevelCount(texture->width, texture->height))
+    return false;
+
+  uint64_t offset = sizeof(header) + (uint64_t) header.bytes_of_key_value_data;
+  for (uint32_t level = 0; level < level_count; ++level) {
+    if (offset > size || sizeof(uint32_t) > size - offset) return false;
+    uint32_t image_size;
+    memcpy(&image_size, data + offset, sizeof(image_size));
+    offset += sizeof(uint32_t);
+
+    uint64_t expected =
+        LevelSize(texture->internal_format, MipSize(texture->width, level),
+                  MipSize(texture->height, level));
+    if (expected == 0 || image_size != expected) return false;
+    if (offset > size || image_size > size - offset) return false;
+
+    KTX_TEXTURE::LEVEL l = {data + offset, image_size};
+    texture->levels.push_back(l);
+    // mipPadding to 4 bytes; block sizes are multiples of 8 already
+    offset += (image_size + 3) & ~3u;
+  }
+  return true;
+}
+
+bool ParseKtx2(const uint8_t *data, size_t size, KTX_TEXTURE *texture) {
+  KTX2_HEADER header;
+  if (size < sizeof(header)) return false;
+  memcpy(&header, data, sizeof(header));
+  if (header.supercompression_scheme != 0 || header.pixel_depth > 1 ||
+      header.layer_count > 1 || header.face_count != 1)
+    return false;
+
+  texture->internal_format = VkFormatToGl(header.vk_format);
+  texture->width = header.pixel_width;
+  texture->height = header.pixel_height;
+  uint32_t level_count = header.level_count ? header.level_count : 1;
+  if (level_count > MaxLevelCount(texture->width, texture->height))
+    return false;
+  if (sizeof(header) + level_count * sizeof(KTX2_LEVEL) > size) return false;
+
+  for (uint32_t level = 0; level < level_count; ++level) {
+    KTX2_LEVEL index;
+    memcpy(&index, data + sizeof(header) + level * sizeof(KTX2_LEVEL),
+           sizeof(index));
+    uint64_t expected =
+        LevelSize(texture->internal_format, MipSize(texture->width, level),
+                  MipSize(texture->height, level));
+    if (expected == 0 || index.byte_length != expected) return false;
+    // Checked so that a huge offset can't wrap around past size
+    if (index.byte_offset > size ||
+        index.byte_length > size - index.byte_offset)
+      return false;
+
+    KTX_TEXTURE::LEVEL l = {data + index.byte_offset,
+                            static_cast<uint32_t>(index.byte_length)};
+    texture->levels.push_back(l);
+  }
+  return true;
+}
+
+}  // namespace
+
+bool ParseKtx(const uint8_t *data, size_t size, KTX_TEXTURE *texture) {
+  texture->levels.clear();
+  if (size < sizeof(kKtx1Identifier)) return false;
+  if (memcmp(data, kKtx1Identifier, sizeof(kKtx1Identifier)) == 0) {
+    return ParseKtx1(data, size, texture);
+  }
+  if (memcmp(data, kKtx2Identifier, sizeof(kKtx2Identifier)) == 0) {
+    return ParseKtx2(data, size, texture);
+  }
+  return false;
+}
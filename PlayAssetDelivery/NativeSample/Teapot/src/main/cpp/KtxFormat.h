@@ -0,0 +1,140 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// KtxFormat.h
+// KTX 1.1 and KTX 2.0 texture containers with GPU compressed payloads.
+// Shared by the runtime loader (Texture.cpp) and the host side converter
+// (tools/texture_converter); keep it free of Android and GL includes.
+//--------------------------------------------------------------------------------
+#ifndef TEAPOTS_KTXFORMAT_H
+#define TEAPOTS_KTXFORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+const uint8_t kKtx1Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '1',
+                                     '1',  0xBB, '\r', '\n', 0x1A, '\n'};
+const uint8_t kKtx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2',
+                                     '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+const uint32_t kKtxEndianness = 0x04030201;
+
+/**
+ * Compressed formats the loader understands, as GL internal formats
+ */
+enum KTX_FORMAT {
+  KTX_FORMAT_ETC1_RGB8 = 0x8D64,         // GL_ETC1_RGB8_OES
+  KTX_FORMAT_ETC2_RGB8 = 0x9274,         // GL_COMPRESSED_RGB8_ETC2
+  KTX_FORMAT_ETC2_SRGB8 = 0x9275,        // GL_COMPRESSED_SRGB8_ETC2
+  KTX_FORMAT_ETC2_RGBA8 = 0x9278,        // GL_COMPRESSED_RGBA8_ETC2_EAC
+  KTX_FORMAT_ETC2_SRGB8_ALPHA8 = 0x9279,  // GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC
+  KTX_FORMAT_ASTC_4x4 = 0x93B0,  // GL_COMPRESSED_RGBA_ASTC_4x4_KHR, the 14
+                                 // block sizes follow in Vulkan order
+  KTX_FORMAT_ASTC_12x12 = 0x93BD,
+  KTX_FORMAT_SRGB8_ALPHA8_ASTC_4x4 = 0x93D0,
+  KTX_FORMAT_SRGB8_ALPHA8_ASTC_12x12 = 0x93DD,
+};
+
+/**
+ * KTX 1.1 file header, followed by bytes_of_key_value_data of key/value
+ * pairs and then, per mip level, a uint32_t image size and the image.
+ */
+struct KTX1_HEADER {
+  uint8_t identifier[12];
+  uint32_t endianness;
+  uint32_t gl_type;  // 0 for compressed formats
+  uint32_t gl_type_size;
+  uint32_t gl_format;  // 0 for compressed formats
+  uint32_t gl_internal_format;
+  uint32_t gl_base_internal_format;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t number_of_array_elements;
+  uint32_t number_of_faces;
+  uint32_t number_of_mipmap_levels;
+  uint32_t bytes_of_key_value_data;
+};
+
+/**
+ * KTX 2.0 file header, followed by level_count level index entries
+ */
+struct KTX2_HEADER {
+  uint8_t identifier[12];
+  uint32_t vk_format;
+  uint32_t type_size;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t layer_count;
+  uint32_t face_count;
+  uint32_t level_count;
+  uint32_t supercompression_scheme;
+  uint32_t dfd_byte_offset;
+  uint32_t dfd_byte_length;
+  uint32_t kvd_byte_offset;
+  uint32_t kvd_byte_length;
+  uint64_t sgd_byte_offset;
+  uint64_t sgd_byte_length;
+};
+
+struct KTX2_LEVEL {
+  uint64_t byte_offset;
+  uint64_t byte_length;
+  uint64_t uncompressed_byte_length;
+};
+
+/**
+ * A parsed container. Level data points into the buffer that was parsed,
+ * level 0 is the full size image.
+ */
+struct KTX_TEXTURE {
+  uint32_t internal_format;  // KTX_FORMAT
+  uint32_t width;
+  uint32_t height;
+  struct LEVEL {
+    const uint8_t *data;
+    uint32_t size;
+  };
+  std::vector<LEVEL> levels;
+};
+
+/**
+ * Parse a single 2D texture (no arrays, cube maps or supercompression) with
+ * one of the KTX_FORMAT payloads. Returns false for anything else.
+ */
+bool ParseKtx(const uint8_t *data, size_t size, KTX_TEXTURE *texture);
+
+// True for the ASTC formats, which need KHR_texture_compression_astc_ldr
+inline bool KtxIsAstc(uint32_t internal_format) {
+  return (internal_format >= KTX_FORMAT_ASTC_4x4 &&
+          internal_format <= KTX_FORMAT_ASTC_12x12) ||
+         (internal_format >= KTX_FORMAT_SRGB8_ALPHA8_ASTC_4x4 &&
+          internal_format <= KTX_FORMAT_SRGB8_ALPHA8_ASTC_12x12);
+}
+
+// True for .ktx and .ktx2 file names
+inline bool KtxIsFileName(const std::string &file) {
+  size_t dot = file.rfind('.');
+  if (dot == std::string::npos) return false;
+  return file.compare(dot, std::string::npos, ".ktx") == 0 ||
+         file.compare(dot, std::string::npos, ".ktx2") == 0;
+}
+
+#endif //TEAPOTS_KTXFORMAT_H
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Mesh.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "GLContext.h"
+#include "glStateCache.h"
+#include "third_party/gl3stub.h"
+#include "PlayAssetDeliveryUtil.h"
+#define MODULE_NAME "Teapot::Mesh"
+// JNIHelper.h, through GLContext.h, has its own log macros
+#undef LOGI
+#undef LOGW
+#undef LOGE
+#include "android_debug.h"
+
+#define BUFFER_OFFSET(i) ((char*)NULL + (i))
+
+Mesh::Mesh() : vbo_(0), ibo_(0), vao_(0) {
+  memset(&header_, 0, sizeof(header_));
+  memset(bounding_sphere_, 0, sizeof(bounding_sphere_));
+}
+
+Mesh::~Mesh() { Unload(); }
+
+bool Mesh::Load(std::string &meshFile,
+                AAssetManager *assetManager,
+                std::string &packName,
+                bool isUnderApk) {
+  Unload();
+
+  ndk_helper::AssetView view;
+  if (!OpenPackAsset(assetManager, meshFile, packName, isUnderApk, &view)) {
+    LOGE("Unable to open %s from %s", meshFile.c_str(), packName.c_str());
+    return false;
+  }
+  return Upload(view.Data(), view.Size(), meshFile.c_str());
+}
+
+bool Mesh::Upload(const uint8_t *data, size_t size, const char *name) {
+  const MESH_FILE_HEADER *header =
+      reinterpret_cast<const MESH_FILE_HEADER *>(data);
+  if (!ValidateMeshHeader(header, size)) {
+    LOGE("%s is not a version %u mesh file", name, kMeshVersion);
+    return false;
+  }
+  if (MeshRequiresGLES3(header) &&
+      ndk_helper::GLContext::GetInstance()->GetGLVersion() < 3.0f) {
+    LOGE("%s uses a quantized vertex layout that needs OpenGL ES 3", name);
+    return false;
+  }
+  header_ = *header;
+  ComputeBoundingSphere(data + header_.vertex_offset);
+
+  ndk_helper::GLStateCache *cache = ndk_helper::GLStateCache::GetInstance();
+  // Keep the element buffer binding of whatever vertex array is bound
+  cache->BindVertexArray(0);
+
+  glGenBuffers(1, &vbo_);
+  cache->BindBuffer(GL_ARRAY_BUFFER, vbo_);
+  glBufferData(GL_ARRAY_BUFFER, header_.vertex_count * header_.vertex_stride,
+               data + header_.vertex_offset, GL_STATIC_DRAW);
+  cache->BindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glGenBuffers(1, &ibo_);
+  cache->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               header_.index_count * MeshIndexSize(header_.index_type),
+               data + header_.index_offset, GL_STATIC_DRAW);
+  cache->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  if (glGenVertexArrays &&
+      ndk_helper::GLContext::GetInstance()->GetGLVersion() >= 3.0f) {
+    glGenVertexArrays(1, &vao_);
+    cache->BindVertexArray(vao_);
+    SetupAttributes();
+    cache->BindVertexArray(0);
+    cache->BindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+  return true;
+}
+
+/*
+ * Centered on the AABB of the header, with the radius of the farthest
+ * position. Not the tightest sphere, but close for compact meshes and a
+ * single pass over the vertices.
+ */
+void Mesh::ComputeBoundingSphere(const uint8_t *vertices) {
+  float *sphere = bounding_sphere_;
+  float radius_sq = 0.f;
+  for (int32_t i = 0; i < 3; ++i) {
+    sphere[i] = (header_.bounds_min[i] + header_.bounds_max[i]) * 0.5f;
+    float half = (header_.bounds_max[i] - header_.bounds_min[i]) * 0.5f;
+    radius_sq += half * half;
+  }
+  // The AABB corner is the fallback when positions can't be decoded here
+  sphere[3] = sqrtf(radius_sq);
+
+  const MESH_ATTRIBUTE *position = NULL;
+  for (uint32_t i = 0; i < header_.attribute_count; ++i) {
+    if (header_.attributes[i].semantic == MESH_SEMANTIC_POSITION) {
+      position = &header_.attributes[i];
+    }
+  }
+  if (!position || position->components < 3) return;
+  bool quantized = position->type == MESH_TYPE_UNSIGNED_SHORT &&
+                   position->encoding == MESH_ENCODING_SCALE_BIAS;
+  if (!quantized && position->type != MESH_TYPE_FLOAT) return;
+  // Normalized like the vertex shader sees it
+  float q_scale = position->normalized ? 1.f / 65535.f : 1.f;
+
+  radius_sq = 0.f;
+  for (uint32_t v = 0; v < header_.vertex_count; ++v) {
+    const uint8_t *vertex =
+        vertices + v * header_.vertex_stride + position->offset;
+    float p[3];
+    for (int32_t i = 0; i < 3; ++i) {
+      if (quantized) {
+        uint16_t q;
+        memcpy(&q, vertex + i * sizeof(q), sizeof(q));
+        p[i] = q * q_scale * header_.position_scale[i] +
+               header_.position_bias[i];
+      } else {
+        memcpy(&p[i], vertex + i * sizeof(float), sizeof(float));
+      }
+    }
+    float dx = p[0] - sphere[0], dy = p[1] - sphere[1], dz = p[2] - sphere[2];
+    float d_sq = dx * dx + dy * dy + dz * dz;
+    if (d_sq > radius_sq) radius_sq = d_sq;
+  }
+  sphere[3] = sqrtf(radius_sq);
+}
+
+void Mesh::Unload() {
+  ndk_helper::GLStateCache *cache = ndk_helper::GLStateCache::GetInstance();
+  if (vao_) {
+    cache->DeleteVertexArray(vao_);
+    vao_ = 0;
+  }
+  if (vbo_) {
+    cache->DeleteBuffer(vbo_);
+    vbo_ = 0;
+  }
+  if (ibo_) {
+    cache->DeleteBuffer(ibo_);
+    ibo_ = 0;
+  }
+}
+
+void Mesh::SetupAttributes() {
+  ndk_helper::GLStateCache *cache = ndk_helper::GLStateCache::GetInstance();
+  cache->BindBuffer(GL_ARRAY_BUFFER, vbo_);
+  for (uint32_t i = 0; i < header_.attribute_count; ++i) {
+    const MESH_ATTRIBUTE &attr = header_.attributes[i];
+    glVertexAttribPointer(attr.semantic, attr.components, attr.type,
+                          attr.normalized ? GL_TRUE : GL_FALSE,
+                          header_.vertex_stride, BUFFER_OFFSET(attr.offset));
+    glEnableVertexAttribArray(attr.semantic);
+  }
+  cache->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+}
+
+void Mesh::Bind() {
+  if (vao_) {
+    ndk_helper::GLStateCache::GetInstance()->BindVertexArray(vao_);
+  } else {
+    SetupAttributes();
+  }
+}
+
+void Mesh::Draw() {
+  glDrawElements(GL_TRIANGLES, header_.index_count, header_.index_type,
+                 BUFFER_OFFSET(0));
+}
+
+void Mesh::DrawInstanced(GLsizei instanceCount) {
+  glDrawElementsInstanced(GL_TRIANGLES, header_.index_count,
+                          header_.index_type, BUFFER_OFFSET(0),
+                          instanceCount);
+}
+
+void Mesh::Unbind() {
+  ndk_helper::GLStateCache *cache = ndk_helper::GLStateCache::GetInstance();
+  if (vao_) {
+    cache->BindVertexArray(0);
+  } else {
+    cache->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  }
+  cache->BindBuffer(GL_ARRAY_BUFFER, 0);
+}
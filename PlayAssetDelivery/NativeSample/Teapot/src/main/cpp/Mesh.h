@@ -0,0 +1,85 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TEAPOTS_MESH_H
+#define TEAPOTS_MESH_H
+
+#include <GLES2/gl2.h>
+#include <android/asset_manager.h>
+#include <string>
+
+#include "MeshFormat.h"
+
+/**
+ *  class Mesh
+ *    GPU buffers for a mesh stored in the binary format of MeshFormat.h
+ *     - the file is mapped through ndk_helper::AssetView and uploaded
+ *       without repacking
+ *     - vertex attribute pointers come from the attribute table in the file
+ *     - on OpenGL ES 3 they are recorded once into a vertex array object
+ *  Bindings go through ndk_helper::GLStateCache.
+ *  The mesh files are produced by tools/mesh_converter.
+ */
+class Mesh {
+  GLuint vbo_;
+  GLuint ibo_;
+  GLuint vao_;  // OpenGL ES 3 only, holds the state set by SetupAttributes()
+  MESH_FILE_HEADER header_;
+  float bounding_sphere_[4];  // object space center and radius
+
+  bool Upload(const uint8_t *data, size_t size, const char *name);
+  void ComputeBoundingSphere(const uint8_t *vertices);
+  void SetupAttributes();
+
+  Mesh(const Mesh &);
+  void operator=(const Mesh &);
+
+ public:
+  Mesh();
+  ~Mesh();
+
+  /**
+   * Load a mesh file
+   * @param meshFile holds the mesh file name under the pack's assets folder
+   * @param assetManager is used to open mesh files inside the APK
+   * @param packName holds the asset pack name
+   * @param isUnderApk is used to determine the method for open the mesh file
+   */
+  bool Load(std::string &meshFile,
+            AAssetManager *assetManager,
+            std::string &packName,
+            bool isUnderApk);
+  void Unload();
+
+  // Bind the vertex array object, or the buffers and vertex attributes.
+  void Bind();
+  void Draw();
+  // glDrawElementsInstanced, OpenGL ES 3 only
+  void DrawInstanced(GLsizei instanceCount);
+  void Unbind();
+
+  bool IsLoaded() const { return vbo_ != 0; }
+  int32_t GetVertexCount() const { return header_.vertex_count; }
+  int32_t GetIndexCount() const { return header_.index_count; }
+  const MESH_FILE_HEADER &GetHeader() const { return header_; }
+  // Dequantization of the position attribute: p = q * scale + bias
+  const float *GetPositionScale() const { return header_.position_scale; }
+  const float *GetPositionBias() const { return header_.position_bias; }
+  // Sphere around every position, center xyz then radius, for culling
+  const float *GetBoundingSphere() const { return bounding_sphere_; }
+};
+
+#endif //TEAPOTS_MESH_H
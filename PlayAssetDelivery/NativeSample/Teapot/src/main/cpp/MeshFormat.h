@@ -0,0 +1,185 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// MeshFormat.h
+// Binary mesh file layout shared by the runtime loader (Mesh.cpp) and the
+// host side converter (tools/mesh_converter).
+// Keep this file free of Android and GL includes so it builds on the host.
+//--------------------------------------------------------------------------------
+#ifndef TEAPOTS_MESHFORMAT_H
+#define TEAPOTS_MESHFORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * File layout (little endian, which all Android ABIs are):
+ *
+ *   MESH_FILE_HEADER
+ *   vertex data   at vertex_offset, vertex_count * vertex_stride bytes,
+ *                 already interleaved as described by attributes[]
+ *   index data    at index_offset, index_count * index size bytes
+ *
+ * Both data blocks start on a kMeshDataAlignment boundary, so a mapped file
+ * can be handed to glBufferData() as is.
+ * Bump kMeshVersion whenever the layout changes; the loader rejects files with
+ * a different version.
+ *
+ * Quantized meshes (mesh_converter --quantize) use a 16 byte vertex:
+ *   position  3 x unsigned short, normalized, dequantized in the vertex shader
+ *             with position_scale/position_bias:  p = q * scale + bias
+ *   normal    octahedral encoded into x/y of a signed 10:10:10:2 int
+ *   uv        2 x half float
+ * The 10:10:10:2 and half float vertex types require OpenGL ES 3.0.
+ */
+const uint32_t kMeshMagic = 0x534D5054;  // 'TPMS'
+const uint32_t kMeshVersion = 2;
+const uint32_t kMeshDataAlignment = 16;
+const uint32_t kMeshMaxAttributes = 8;
+
+/**
+ * Attribute semantics. Values match SHADER_ATTRIBUTES in TeapotRenderer.h so
+ * the semantic doubles as the vertex attribute location.
+ */
+enum MESH_SEMANTIC {
+  MESH_SEMANTIC_POSITION = 0,
+  MESH_SEMANTIC_NORMAL = 1,
+  MESH_SEMANTIC_UV = 2,
+};
+
+/**
+ * Component and index types. Values match the GL enums so they can be passed
+ * straight to glVertexAttribPointer()/glDrawElements().
+ */
+enum MESH_TYPE {
+  MESH_TYPE_UNSIGNED_SHORT = 0x1403,      // GL_UNSIGNED_SHORT
+  MESH_TYPE_FLOAT = 0x1406,               // GL_FLOAT
+  MESH_TYPE_HALF_FLOAT = 0x140B,          // GL_HALF_FLOAT
+  MESH_TYPE_INT_2_10_10_10_REV = 0x8D9F,  // GL_INT_2_10_10_10_REV
+};
+
+/**
+ * How the shader turns the fetched attribute into its final value.
+ */
+enum MESH_ENCODING {
+  MESH_ENCODING_NONE = 0,
+  MESH_ENCODING_SCALE_BIAS = 1,  // position_scale/position_bias of the header
+  MESH_ENCODING_OCTAHEDRAL = 2,  // unit vector folded onto the xy plane
+};
+
+struct MESH_ATTRIBUTE {
+  uint32_t semantic;    // MESH_SEMANTIC
+  uint32_t components;  // 1-4
+  uint32_t type;        // MESH_TYPE
+  uint32_t normalized;  // 0 or 1, as glVertexAttribPointer()
+  uint32_t offset;      // byte offset inside a vertex
+  uint32_t encoding;    // MESH_ENCODING
+};
+
+struct MESH_FILE_HEADER {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vertex_count;
+  uint32_t vertex_stride;
+  uint32_t vertex_offset;
+  uint32_t index_count;
+  uint32_t index_type;  // MESH_TYPE
+  uint32_t index_offset;
+  float bounds_min[3];  // object space AABB of all positions
+  float bounds_max[3];
+  float position_scale[3];  // (1, 1, 1) unless the position is quantized
+  float position_bias[3];   // (0, 0, 0) unless the position is quantized
+  uint32_t attribute_count;
+  MESH_ATTRIBUTE attributes[kMeshMaxAttributes];
+};
+
+inline uint32_t MeshIndexSize(uint32_t index_type) {
+  return index_type == MESH_TYPE_UNSIGNED_SHORT ? 2 : 0;
+}
+
+inline uint32_t MeshAlign(uint32_t offset) {
+  return (offset + kMeshDataAlignment - 1) & ~(kMeshDataAlignment - 1);
+}
+
+/**
+ * Bytes an attribute takes inside a vertex, 0 for an unknown type or a
+ * component count GL can't fetch it with.
+ */
+inline uint32_t MeshAttributeSize(const MESH_ATTRIBUTE &attr) {
+  if (attr.components < 1 || attr.components > 4) return 0;
+  switch (attr.type) {
+    case MESH_TYPE_UNSIGNED_SHORT:
+    case MESH_TYPE_HALF_FLOAT:
+      return attr.components * 2;
+    case MESH_TYPE_FLOAT:
+      return attr.components * 4;
+    case MESH_TYPE_INT_2_10_10_10_REV:
+      // All four components packed into one 32 bit word
+      return attr.components == 4 ? 4 : 0;
+    default:
+      return 0;
+  }
+}
+
+/**
+ * True when the vertex layout uses types that OpenGL ES 2.0 can't fetch.
+ */
+inline bool MeshRequiresGLES3(const MESH_FILE_HEADER *header) {
+  for (uint32_t i = 0; i < header->attribute_count; ++i) {
+    uint32_t type = header->attributes[i].type;
+    if (type == MESH_TYPE_HALF_FLOAT || type == MESH_TYPE_INT_2_10_10_10_REV)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * Sanity check a header against the size of the file it was read from.
+ * Returns false for a foreign, stale or truncated file.
+ */
+inline bool ValidateMeshHeader(const MESH_FILE_HEADER *header, size_t size) {
+  if (size < sizeof(MESH_FILE_HEADER)) return false;
+  if (header->magic != kMeshMagic || header->version != kMeshVersion)
+    return false;
+  if (header->attribute_count == 0 ||
+      header->attribute_count > kMeshMaxAttributes)
+    return false;
+
+  uint32_t index_size = MeshIndexSize(header->index_type);
+  if (index_size == 0) return false;
+  if (header->vertex_offset % kMeshDataAlignment ||
+      header->index_offset % kMeshDataAlignment)
+    return false;
+
+  uint64_t vertex_end = (uint64_t) header->vertex_offset +
+      (uint64_t) header->vertex_count * header->vertex_stride;
+  uint64_t index_end = (uint64_t) header->index_offset +
+      (uint64_t) header->index_count * index_size;
+  if (vertex_end > size || index_end > size) return false;
+
+  for (uint32_t i = 0; i < header->attribute_count; ++i) {
+    const MESH_ATTRIBUTE &attr = header->attributes[i];
+    // The whole attribute of the last vertex is inside the vertex block
+    uint32_t attr_size = MeshAttributeSize(attr);
+    if (attr_size == 0 || attr.offset > header->vertex_stride ||
+        attr_size > header->vertex_stride - attr.offset)
+      return false;
+  }
+  return true;
+}
+
+#endif //TEAPOTS_MESHFORMAT_H
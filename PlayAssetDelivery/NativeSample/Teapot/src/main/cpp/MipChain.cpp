@@ -0,0 +1,145 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MipChain.h"
+
+#if !defined(TEAPOT_MIPCHAIN_SCALAR)
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define TEAPOT_MIPCHAIN_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(__x86_64__)
+#define TEAPOT_MIPCHAIN_SSE2 1
+#include <emmintrin.h>
+#endif
+#endif
+
+namespace {
+
+/**
+ * Average pixels [first, dst_width) of one destination row from the two
+ * source rows, (a + b + c + d + 2) / 4 per channel.
+ */
+void DownsampleRowScalar(const uint8_t *row0, const uint8_t *row1,
+                         int32_t src_width, int32_t first, int32_t dst_width,
+                         uint8_t *dst) {
+  for (int32_t x = first; x < dst_width; ++x) {
+    int32_t x0 = x * 2;
+    int32_t x1 = x0 + 1 < src_width ? x0 + 1 : x0;
+    for (int32_t c = 0; c < 4; ++c) {
+      uint32_t sum = row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] +
+                     row1[x1 * 4 + c];
+      dst[x * 4 + c] = static_cast<uint8_t>((sum + 2) >> 2);
+    }
+  }
+}
+
+// Returns the number of destination pixels written
+int32_t DownsampleRowSimd(const uint8_t *row0, const uint8_t *row1,
+                          int32_t dst_width, uint8_t *dst) {
+  int32_t x = 0;
+#if defined(TEAPOT_MIPCHAIN_NEON)
+  // 8 source pixels per row in, 4 pixels out
+  for (; x + 4 <= dst_width; x += 4) {
+    // Even pixels in val[0], odd ones in val[1]
+    uint32x4x2_t a = vld2q_u32(reinterpret_cast<const uint32_t *>(row0 + x * 8));
+    uint32x4x2_t b = vld2q_u32(reinterpret_cast<const uint32_t *>(row1 + x * 8));
+    uint8x16_t a0 = vreinterpretq_u8_u32(a.val[0]);
+    uint8x16_t a1 = vreinterpretq_u8_u32(a.val[1]);
+    uint8x16_t b0 = vreinterpretq_u8_u32(b.val[0]);
+    uint8x16_t b1 = vreinterpretq_u8_u32(b.val[1]);
+    uint16x8_t lo = vaddq_u16(vaddl_u8(vget_low_u8(a0), vget_low_u8(a1)),
+                              vaddl_u8(vget_low_u8(b0), vget_low_u8(b1)));
+    uint16x8_t hi = vaddq_u16(vaddl_u8(vget_high_u8(a0), vget_high_u8(a1)),
+                              vaddl_u8(vget_high_u8(b0), vget_high_u8(b1)));
+    vst1q_u8(dst + x * 4,
+             vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+  }
+#elif defined(TEAPOT_MIPCHAIN_SSE2)
+  // 4 source pixels per row in, 2 pixels out
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i two = _mm_set1_epi16(2);
+  for (; x + 2 <= dst_width; x += 2) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x * 8));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x * 8));
+    // Vertical sums of pixels 0, 1 and 2, 3
+    __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                               _mm_unpacklo_epi8(b, zero));
+    __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                               _mm_unpackhi_epi8(b, zero));
+    // Horizontal pairs: 0 + 1 and 2 + 3
+    __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi),
+                                _mm_unpackhi_epi64(lo, hi));
+    sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x * 4),
+                     _mm_packus_epi16(sum, sum));
+  }
+#else
+  (void) row0;
+  (void) row1;
+  (void) dst_width;
+  (void) dst;
+#endif
+  return x;
+}
+
+}  // namespace
+
+int32_t MipLevelCount(int32_t width, int32_t height) {
+  int32_t size = width > height ? width : height;
+  int32_t levels = 1;
+  while (size > 1) {
+    size >>= 1;
+    ++levels;
+  }
+  return levels;
+}
+
+void DownsampleRgba8(const uint8_t *src, int32_t width, int32_t height,
+                     uint8_t *dst) {
+  const int32_t dst_width = MipLevelSize(width, 1);
+  const int32_t dst_height = MipLevelSize(height, 1);
+  const size_t src_stride = static_cast<size_t>(width) * 4;
+  for (int32_t y = 0; y < dst_height; ++y) {
+    const uint8_t *row0 = src + (y * 2) * src_stride;
+    const uint8_t *row1 = y * 2 + 1 < height ? row0 + src_stride : row0;
+    uint8_t *out = dst + static_cast<size_t>(y) * dst_width * 4;
+    // The vector loops need two source columns per destination pixel
+    int32_t done = width > 1 ? DownsampleRowSimd(row0, row1, dst_width, out)
+                             : 0;
+    DownsampleRowScalar(row0, row1, width, done, dst_width, out);
+  }
+}
+
+void BuildMipChain(const uint8_t *level0, int32_t width, int32_t height,
+                   MIP_CHAIN *chain) {
+  const int32_t levels = MipLevelCount(width, height);
+  chain->offsets.clear();
+  size_t size = 0;
+  for (int32_t level = 1; level < levels; ++level) {
+    chain->offsets.push_back(size);
+    size += static_cast<size_t>(MipLevelSize(width, level)) *
+            MipLevelSize(height, level) * 4;
+  }
+  chain->pixels.resize(size);
+
+  const uint8_t *src = level0;
+  for (int32_t level = 1; level < levels; ++level) {
+    uint8_t *dst = &chain->pixels[chain->offsets[level - 1]];
+    DownsampleRgba8(src, MipLevelSize(width, level - 1),
+                    MipLevelSize(height, level - 1), dst);
+    src = dst;
+  }
+}
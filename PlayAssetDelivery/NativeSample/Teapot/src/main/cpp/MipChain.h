@@ -0,0 +1,62 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// MipChain.h
+// RGBA8 mip chain generation with a 2x2 box filter.
+// Used by the texture decode workers (TextureLoader.cpp) and the host side
+// converter (tools/texture_converter); keep it free of Android and GL
+// includes.
+//--------------------------------------------------------------------------------
+#ifndef TEAPOTS_MIPCHAIN_H
+#define TEAPOTS_MIPCHAIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/**
+ * RGBA8 levels 1 to n - 1 of an image, level 0 stays with the caller.
+ * Levels are stored one after the other, level i at offsets[i - 1].
+ */
+struct MIP_CHAIN {
+  std::vector<uint8_t> pixels;
+  std::vector<size_t> offsets;
+};
+
+// Number of levels down to 1x1, including level 0
+int32_t MipLevelCount(int32_t width, int32_t height);
+
+inline int32_t MipLevelSize(int32_t size, int32_t level) {
+  int32_t s = size >> level;
+  return s ? s : 1;
+}
+
+/**
+ * Halve an RGBA8 image, every destination pixel is the rounded average of
+ * a 2x2 source square. An odd last row or column is dropped, a dimension of
+ * 1 is kept. Uses NEON or SSE2 when available; all paths give the same
+ * result.
+ */
+void DownsampleRgba8(const uint8_t *src, int32_t width, int32_t height,
+                     uint8_t *dst);
+
+// Fill chain with every level below level0, each made from the previous one
+void BuildMipChain(const uint8_t *level0, int32_t width, int32_t height,
+                   MIP_CHAIN *chain);
+
+#endif  // TEAPOTS_MIPCHAIN_H
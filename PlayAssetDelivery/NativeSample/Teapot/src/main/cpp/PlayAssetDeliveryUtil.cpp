@@ -18,6 +18,7 @@
 #include <jni.h>
 #include <third_party/stb/stb_image.h>
 #include "PlayAssetDeliveryUtil.h"
+#include "trace.h"
 #include "android_debug.h"
 
 static char *selected_asset_pack = nullptr;
@@ -80,33 +81,60 @@ void LogInfo(struct android_app *app, const char *str) {
 uint8_t *AssetReadTextureFile(AAssetManager *assetManager,
                               std::string &assetName, std::string &packName, bool isUnderApk,
                               int *imgWidth, int *imgHeight, int *channelCount) {
+  NDK_TRACE_SCOPE("AssetReadTextureFile");
   if (!assetName.length())
     return nullptr;
 
   stbi_set_flip_vertically_on_load(1);
 
+  // Decode straight from the mapped file, no intermediate copy
+  ndk_helper::AssetView view;
+  bool opened = OpenPackAsset(assetManager, assetName, packName, isUnderApk, &view);
+  ASSERT(opened, "%s does not exist in %s",
+         assetName.c_str(), __FUNCTION__);
+  if (!opened) return nullptr;
+
+  return stbi_load_from_memory(
+      view.Data(), view.Size(),
+      imgWidth, imgHeight, channelCount, 4);
+}
+
+/**
+ * Map an asset for reading without copying it
+ * @param assetManager is used to open files inside the APK
+ * @param assetName holds the asset name in assets folder of inside asset packs
+ * @param packName holds the asset pack name
+ * @param isUnderApk is used to determine the method for open the file
+ * @param view receives the mapping, valid until it is closed or destroyed
+ */
+bool OpenPackAsset(AAssetManager *assetManager,
+                   std::string &assetName, std::string &packName, bool isUnderApk,
+                   ndk_helper::AssetView *view) {
   if (isUnderApk) {  //install_time_pack
-    AAsset
-        *assetDescriptor = AAssetManager_open(assetManager, assetName.c_str(), AASSET_MODE_BUFFER);
-    ASSERT(assetDescriptor, "%s does not exist in %s",
-           assetName.c_str(), __FUNCTION__);
-    size_t fileLength = AAsset_getLength(assetDescriptor);
-    std::vector<uint8_t> buf(fileLength);
-    AAsset_read(assetDescriptor, buf.data(), buf.size());
-
-    return stbi_load_from_memory(
-        buf.data(), buf.size(),
-        imgWidth, imgHeight, channelCount, 4);
-
-  } else {    //on_demand_pack & fast_follow_pack
-    AssetPackLocation *location;
-    AssetPackManager_getAssetPackLocation(packName.c_str(), &location);
-    std::string path = std::string(AssetPackLocation_getAssetsPath(location));
-    path += assetName;
-    FILE *file = fopen(path.c_str(), "rb");
-    assert(file != nullptr);
-    return stbi_load_from_file(file, imgWidth, imgHeight, channelCount, 4);
+    return view->OpenAsset(assetManager, assetName.c_str());
+  }
+  //on_demand_pack & fast_follow_pack
+  std::string path = GetAssetPackFilePath(packName, assetName);
+  return !path.empty() && view->OpenFile(path.c_str());
+}
+
+/**
+ * Get the path of an asset inside a downloaded asset pack
+ * (on_demand_pack & fast_follow_pack).
+ * @param packName holds the asset pack name
+ * @param assetName holds the asset name inside the pack's assets folder
+ * @return the file path, or an empty string when the pack is not available
+ */
+std::string GetAssetPackFilePath(std::string &packName, std::string &assetName) {
+  AssetPackLocation *location;
+  if (AssetPackManager_getAssetPackLocation(packName.c_str(), &location)
+      != ASSET_PACK_NO_ERROR) {
+    return std::string();
   }
+  const char *assets_path = AssetPackLocation_getAssetsPath(location);
+  std::string path = assets_path ? std::string(assets_path) + assetName : std::string();
+  AssetPackLocation_destroy(location);
+  return path;
 }
 
 /**
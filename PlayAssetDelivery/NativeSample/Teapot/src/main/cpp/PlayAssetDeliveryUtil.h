@@ -22,10 +22,15 @@
 #include <android_native_app_glue.h>
 #include <android/asset_manager.h>
 #include <play/asset_pack.h>
+#include "assetView.h"
 
 uint8_t *AssetReadTextureFile(AAssetManager *assetManager,
                               std::string &assetName, std::string &packName, bool isUnderApk,
                               int *imgWidth, int *imgHeight, int *channelCount);
+bool OpenPackAsset(AAssetManager *assetManager,
+                   std::string &assetName, std::string &packName, bool isUnderApk,
+                   ndk_helper::AssetView *view);
+std::string GetAssetPackFilePath(std::string &packName, std::string &assetName);
 
 void SelectAssetPack(struct android_app *app, const char *pack_name);
 char *GetCurrentPackName();
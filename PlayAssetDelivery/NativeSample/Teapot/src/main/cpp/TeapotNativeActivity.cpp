@@ -20,6 +20,12 @@
 #include <jni.h>
 #include <errno.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include <android/sensor.h>
 #include <android/log.h>
 #include <android_native_app_glue.h>
@@ -51,8 +57,50 @@ class Engine {
   ndk_helper::PinchDetector pinch_detector_;
   ndk_helper::DragDetector drag_detector_;
   ndk_helper::PerfMonitor monitor_;
+  ndk_helper::GpuTimer gpu_timer_;
+  int32_t clear_pass_;
+  int32_t render_pass_;
+
+  // Frames start from vsync callbacks on the looper, unless unsupported or
+  // the debug.teapot.paced property is 0
+  ndk_helper::ChoreographerVsync vsync_;
+  ndk_helper::FrameScheduler scheduler_;
+
+  /*
+   * Render on demand: frames are drawn only while something changes.
+   * Input, app commands, UI buttons and finished texture decodes set
+   * redraw_, from any thread, and wake the looper. The camera momentum and
+   * the renderer's own animations keep frames coming. Otherwise the looper
+   * blocks, with the simulation thread and the accelerometer stopped.
+   * debug.teapot.on_demand=0 draws every frame.
+   */
+  std::atomic<bool> redraw_;
+  bool on_demand_;
+  int32_t frames_left_;
+  bool idle_;
+  bool IsAnimating();
+  void SetIdle(bool idle);
+  static void OnTextureDecoded(void *data);
 
   ndk_helper::TapCamera tap_camera_;
+  // Input handling and the simulation thread both use tap_camera_
+  std::mutex camera_mutex_;
+
+  /*
+   * The simulation of frame N + 1 runs on its own thread while frame N is
+   * drawn. It hands snapshots over through frames_ and starts a new one
+   * each time DrawFrame() bumps frames_requested_. The thread only runs
+   * while animating; anything that reloads resources stops it first.
+   */
+  ndk_helper::Mailbox<FRAME_SNAPSHOT> frames_;
+  bool threaded_;
+  std::thread simulation_thread_;
+  std::mutex simulation_mutex_;
+  std::condition_variable simulation_cond_;
+  uint64_t frames_requested_;
+  bool simulation_quit_;
+  void Simulate(FRAME_SNAPSHOT *frame);
+  void SimulationMain();
 
   android_app *app_;
 
@@ -73,10 +121,18 @@ class Engine {
   int InitDisplay(android_app *app);
   void LoadResources();
   void UnloadResources();
-  void DrawFrame();
+  void DrawFrame(const ndk_helper::FRAME_TIMING *timing = NULL);
+  void StartSimulation();
+  void StopSimulation();
   void TermDisplay();
   void TrimMemory();
   bool IsReady();
+  void InitScheduler();
+  void ReleaseScheduler();
+  int32_t ScheduleFrame();
+  bool BeginFrame(ndk_helper::FRAME_TIMING *timing);
+  // Any thread
+  void RequestRedraw();
 
   void UpdatePosition(AInputEvent *event, int32_t iIndex, float &fX, float &fY);
 
@@ -94,6 +150,15 @@ bool Engine::double_tap = false;
 Engine::Engine()
     : initialized_resources_(false),
       has_focus_(false),
+      clear_pass_(-1),
+      render_pass_(-1),
+      redraw_(true),
+      on_demand_(true),
+      frames_left_(0),
+      idle_(false),
+      threaded_(true),
+      frames_requested_(0),
+      simulation_quit_(false),
       app_(NULL),
       sensor_manager_(NULL),
       accelerometer_sensor_(NULL),
@@ -110,14 +175,26 @@ Engine::~Engine() {}
  * Load resources
  */
 void Engine::LoadResources() {
+  // The context is new or was restored, its state is unknown
+  ndk_helper::GLStateCache::GetInstance()->Reset();
   renderer_.Init(app_);
   renderer_.Bind(&tap_camera_);
+
+  // GPU time of each pass and texture swap times show up in the frame
+  // statistics
+  renderer_.SetPerfMonitor(&monitor_);
+  gpu_timer_.Init(&monitor_);
+  clear_pass_ = gpu_timer_.AddPass("GPU clear");
+  render_pass_ = gpu_timer_.AddPass("GPU teapot");
 }
 
 /**
  * Unload resources
  */
-void Engine::UnloadResources() { renderer_.Unload(); }
+void Engine::UnloadResources() {
+  gpu_timer_.Release();
+  renderer_.Unload();
+}
 
 /**
  * Initialize an EGL context for the current display.
@@ -134,6 +211,9 @@ int Engine::InitDisplay(android_app *app) {
     // On some devices, ANativeWindow is re-created when the app is resumed
     assert(gl_context_->GetANativeWindow());
     UnloadResources();
+    renderer_.UnloadTextures();
+    // The shader worker shares the context about to go away
+    ndk_helper::ProgramBuilder::GetInstance()->Shutdown();
     gl_context_->Invalidate();
     app_ = app;
     gl_context_->Init(app->window);
@@ -168,26 +248,121 @@ int Engine::InitDisplay(android_app *app) {
 }
 
 /**
- * Just the current frame in the display.
+ * Just the current frame in the display. timing is NULL for the frames
+ * drawn outside the schedule, on window and focus changes.
  */
-void Engine::DrawFrame() {
-  renderer_.Update(monitor_.GetCurrentTime());
+void Engine::DrawFrame(const ndk_helper::FRAME_TIMING *timing) {
+  NDK_TRACE_SCOPE("Engine::DrawFrame");
+  monitor_.BeginFrame();
+  const FRAME_SNAPSHOT *frame;
+  if (simulation_thread_.joinable()) {
+    // The newest snapshot; the next one is simulated while this is drawn
+    frame = frames_.Acquire();
+    {
+      std::lock_guard<std::mutex> lock(simulation_mutex_);
+      ++frames_requested_;
+    }
+    simulation_cond_.notify_one();
+  } else {
+    Simulate(frames_.BeginWrite());
+    frames_.EndWrite();
+    frame = frames_.Acquire();
+  }
 
   // Just fill the screen with a color.
   glClearColor(0.5f, 0.5f, 0.5f, 1.f);
+  gpu_timer_.Begin(clear_pass_);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  renderer_.Render();
+  gpu_timer_.End();
+  gpu_timer_.Begin(render_pass_);
+  renderer_.Render(*frame);
+  gpu_timer_.End();
+
+  // A double tap only changes the texture, the next frame shows it
+  if (double_tap == true) {
+    renderer_.SwapTexture();
+    double_tap = false;
+    LogHeader(app_, renderer_.GetRenderInfo().c_str());
+  }
 
   // Swap
-  if (double_tap == true || EGL_SUCCESS != gl_context_->Swap()) {
+  if (timing && timing->present_ns) {
+    gl_context_->SetPresentationTime(timing->present_ns);
+  }
+  NDK_TRACE_BEGIN("eglSwapBuffers");
+  EGLint swapResult = gl_context_->Swap();
+  NDK_TRACE_END();
+  if (timing) {
+    scheduler_.EndFrame(ndk_helper::FrameScheduler::GetCurrentTimeNs());
+    if (scheduler_.IsPaced()) {
+      monitor_.SetRefreshPeriod(scheduler_.GetPeriod());
+    }
+  }
+  if (EGL_SUCCESS != swapResult) {
+    // Resources are about to change under the simulation
+    StopSimulation();
+    // Cached textures may belong to a lost context
     UnloadResources();
+    renderer_.UnloadTextures();
     LoadResources();
-    double_tap = false;
     LogHeader(app_, renderer_.GetRenderInfo().c_str());
+    RequestRedraw();
+  }
+  // Results of a few frames ago, never waits for the GPU
+  gpu_timer_.Collect();
+  monitor_.EndFrame();
+}
 
+void Engine::Simulate(FRAME_SNAPSHOT *frame) {
+  NDK_TRACE_SCOPE("Engine::Simulate");
+  {
+    std::lock_guard<std::mutex> lock(camera_mutex_);
+    renderer_.UpdateView(frame);
+  }
+  renderer_.UpdateInstances(ndk_helper::PerfMonitor::GetCurrentTime(), frame);
+}
+
+void Engine::SimulationMain() {
+  uint64_t produced = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(simulation_mutex_);
+      simulation_cond_.wait(lock, [this, produced] {
+        return simulation_quit_ || frames_requested_ > produced;
+      });
+      if (simulation_quit_) break;
+      produced = frames_requested_;
+    }
+    Simulate(frames_.BeginWrite());
+    frames_.EndWrite();
   }
 }
 
+/**
+ * Start simulating on a thread of its own, unless it runs already or the
+ * debug.teapot.threaded property is 0.
+ */
+void Engine::StartSimulation() {
+  if (!threaded_ || simulation_thread_.joinable()) return;
+  // The first frame inline, so there is always one to draw
+  Simulate(frames_.BeginWrite());
+  frames_.EndWrite();
+  simulation_quit_ = false;
+  frames_requested_ = 1;
+  simulation_thread_ = std::thread(&Engine::SimulationMain, this);
+}
+
+// DrawFrame() simulates inline until the next StartSimulation()
+void Engine::StopSimulation() {
+  if (!simulation_thread_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(simulation_mutex_);
+    simulation_quit_ = true;
+  }
+  simulation_cond_.notify_one();
+  simulation_thread_.join();
+}
+
 /**
  * Tear down the EGL context currently associated with the display.
  */
@@ -195,14 +370,18 @@ void Engine::TermDisplay() { gl_context_->Suspend(); }
 
 void Engine::TrimMemory() {
   LOGI("Trimming memory");
-  gl_context_->Invalidate();
+  // Textures are the bulk of it; keep the context and what's on screen
+  renderer_.TrimMemory();
 }
 /**
  * Process the next input event.
  */
 int32_t Engine::HandleInput(android_app *app, AInputEvent *event) {
   Engine *eng = (Engine *) app->userData;
+  eng->RequestRedraw();
   if (AInputEvent_getType(event) == AINPUT_EVENT_TYPE_MOTION) {
+    eng->monitor_.RecordInput(AMotionEvent_getEventTime(event));
+    std::lock_guard<std::mutex> lock(eng->camera_mutex_);
     ndk_helper::GESTURE_STATE doubleTapState =
         eng->doubletap_detector_.Detect(event);
     ndk_helper::GESTURE_STATE tapState = eng->tap_detector_.Detect(event);
@@ -264,11 +443,14 @@ int32_t Engine::HandleInput(android_app *app, AInputEvent *event) {
  */
 void Engine::HandleCmd(struct android_app *app, int32_t cmd) {
   Engine *eng = (Engine *) app->userData;
+  // Window and focus changes may all need a new frame
+  eng->RequestRedraw();
   switch (cmd) {
     case APP_CMD_SAVE_STATE:break;
     case APP_CMD_INIT_WINDOW:
       // The window is being shown, get it ready.
       if (app->window != NULL) {
+        eng->StopSimulation();
         eng->InitDisplay(app);
         eng->has_focus_ = true;
         eng->DrawFrame();
@@ -276,6 +458,7 @@ void Engine::HandleCmd(struct android_app *app, int32_t cmd) {
       break;
     case APP_CMD_TERM_WINDOW:
       // The window is being hidden or closed, clean it up.
+      eng->StopSimulation();
       eng->TermDisplay();
       eng->has_focus_ = false;
       break;
@@ -287,7 +470,17 @@ void Engine::HandleCmd(struct android_app *app, int32_t cmd) {
     case APP_CMD_LOST_FOCUS:eng->SuspendSensors();
       // Also stop animating.
       eng->has_focus_ = false;
+      eng->StopSimulation();
       eng->DrawFrame();
+      // Frame statistics of the session so far
+      eng->monitor_.Dump();
+      eng->renderer_.DumpStats();
+      LOGI("Frame scheduler: %u frames, %u missed deadlines, %u moved to a "
+           "later vsync, %.2f ms predicted frame time, %d vsyncs apart",
+           eng->scheduler_.GetFrameCount(), eng->scheduler_.GetMissedCount(),
+           eng->scheduler_.GetLateCount(),
+           eng->scheduler_.GetPredictedWork() * 1e-6,
+           eng->scheduler_.GetSwapInterval());
       break;
     case APP_CMD_LOW_MEMORY:
       // Free up GL resources
@@ -341,6 +534,10 @@ void Engine::SuspendSensors() {
 //-------------------------------------------------------------------------
 void Engine::SetState(android_app *state) {
   app_ = state;
+  threaded_ = GetDebugProperty("debug.teapot.threaded", 1) != 0;
+  LOGI("Simulation %s", threaded_ ? "on its own thread" : "on the GL thread");
+  on_demand_ = GetDebugProperty("debug.teapot.on_demand", 1) != 0;
+  renderer_.SetWakeCallback(OnTextureDecoded, this);
   doubletap_detector_.SetConfiguration(app_->config);
   drag_detector_.SetConfiguration(app_->config);
   pinch_detector_.SetConfiguration(app_->config);
@@ -352,6 +549,86 @@ bool Engine::IsReady() {
   return false;
 }
 
+// On the looper thread, the vsync callbacks run on its looper
+void Engine::InitScheduler() {
+  bool paced = GetDebugProperty("debug.teapot.paced", 1) != 0;
+  if (paced && vsync_.Init()) {
+    scheduler_.Init(&vsync_);
+    LOGI("Frames paced by AChoreographer");
+  } else {
+    scheduler_.Init(NULL);
+    LOGI("Frames paced by eglSwapBuffers");
+  }
+}
+
+// Before the looper thread exits, a recreated activity gets a new one
+void Engine::ReleaseScheduler() {
+  scheduler_.Init(NULL);
+  vsync_.Release();
+}
+
+void Engine::RequestRedraw() {
+  redraw_.store(true);
+  // The looper may be blocked with nothing to draw
+  if (app_) ALooper_wake(app_->looper);
+}
+
+void Engine::OnTextureDecoded(void *data) {
+  static_cast<Engine *>(data)->RequestRedraw();
+}
+
+bool Engine::IsAnimating() {
+  if (!on_demand_ || redraw_.load() || frames_left_ > 0) return true;
+  if (renderer_.IsAnimating()) return true;
+  std::lock_guard<std::mutex> lock(camera_mutex_);
+  return tap_camera_.HasMomentum();
+}
+
+void Engine::SetIdle(bool idle) {
+  if (idle == idle_) return;
+  idle_ = idle;
+  NDK_TRACE_COUNTER("Idle", idle);
+  if (idle) {
+    // StartSimulation() simulates the first frame afresh
+    StopSimulation();
+    // Its events are not used, they would only wake the looper
+    SuspendSensors();
+  } else {
+    ResumeSensors();
+  }
+}
+
+/**
+ * Ask for the next frame while animating.
+ * return: ms the looper may block for, -1 until the next event
+ */
+int32_t Engine::ScheduleFrame() {
+  if (!IsReady()) return -1;
+  SetIdle(!IsAnimating());
+  if (idle_) return -1;
+  scheduler_.Schedule();
+  return scheduler_.GetPollTimeout(
+      ndk_helper::FrameScheduler::GetCurrentTimeNs());
+}
+
+bool Engine::BeginFrame(ndk_helper::FRAME_TIMING *timing) {
+  if (!IsReady() || !IsAnimating()) return false;
+  if (!scheduler_.BeginFrame(ndk_helper::FrameScheduler::GetCurrentTimeNs(),
+                             timing)) {
+    return false;
+  }
+  // The simulation thread runs a frame ahead, so the last change shows up
+  // on the frame after the one that simulated it
+  const int32_t kTrailingFrames = 2;
+  bool changed = redraw_.exchange(false) || renderer_.IsAnimating();
+  if (!changed) {
+    std::lock_guard<std::mutex> lock(camera_mutex_);
+    changed = tap_camera_.HasMomentum();
+  }
+  frames_left_ = changed ? kTrailingFrames - 1 : std::max(frames_left_ - 1, 0);
+  return true;
+}
+
 void Engine::TransformPosition(ndk_helper::Vec2 &vec) {
   vec = ndk_helper::Vec2(2.0f, 2.0f) * vec /
       ndk_helper::Vec2(gl_context_->GetScreenWidth(),
@@ -374,6 +651,30 @@ void Engine::ShowUI() {
 
 Engine g_engine;
 
+/**
+ * UI buttons are read by TexturedTeapotRender on the next frame; the
+ * activity calls this on a press so that frame gets drawn.
+ */
+static void JNICALL OnUiCommand(JNIEnv *, jobject) { g_engine.RequestRedraw(); }
+
+static void RegisterNatives(android_app *app) {
+  JNIEnv *jni;
+  app->activity->vm->AttachCurrentThread(&jni, NULL);
+
+  // NativeActivity loads the library itself, JNI can't look the native
+  // methods up by name
+  jclass clazz = jni->GetObjectClass(app->activity->clazz);
+  const JNINativeMethod methods[] = {
+      {"onUiCommand", "()V", reinterpret_cast<void *>(OnUiCommand)}};
+  if (jni->RegisterNatives(clazz, methods, 1) != JNI_OK) {
+    LOGW("Unable to register the UI callback");
+    jni->ExceptionClear();
+  }
+  jni->DeleteLocalRef(clazz);
+
+  app->activity->vm->DetachCurrentThread();
+}
+
 /**
  * This is the main entry point of a native application that is using
  * android_native_app_glue.  It runs in its own thread, with its own
@@ -382,6 +683,8 @@ Engine g_engine;
 void android_main(android_app *state) {
 
   g_engine.SetState(state);
+  g_engine.InitScheduler();
+  RegisterNatives(state);
 
   // Init helper functions
   ndk_helper::JNIHelper::Init(state->activity, HELPER_CLASS_NAME);
@@ -394,6 +697,13 @@ void android_main(android_app *state) {
   monstartup("libTeapotNativeActivity.so");
 #endif
 
+  // Worker threads for the simulation, one per fast core
+  ndk_helper::JobSystem* jobs = ndk_helper::JobSystem::GetInstance();
+  ndk_helper::CPU_TOPOLOGY topology = ndk_helper::JobSystem::GetCpuTopology();
+  jobs->Init();
+  LOGI("%d cores, %d fast: %d job workers", topology.cores,
+       topology.fast_cores, jobs->GetWorkerCount());
+
   // Prepare to monitor accelerometer
   g_engine.InitSensors();
 
@@ -407,28 +717,39 @@ void android_main(android_app *state) {
     int events;
     android_poll_source *source;
 
-    // If not animating, we will block forever waiting for events.
-    // If animating, we loop until all events are read, then continue
-    // to draw the next frame of animation.
-    while ((id = ALooper_pollAll(g_engine.IsReady() ? 0 : -1, NULL, &events,
-                                 (void **) &source)) >= 0) {
-      // Process this event.
-      if (source != NULL) source->process(state, source);
-
-      g_engine.ProcessSensors(id);
-
-      // Check if we are exiting.
-      if (state->destroyRequested != 0) {
-        DestroyAssetManager(state);
-        g_engine.TermDisplay();
-        return;
+    // If not animating, or nothing changes, we will block forever waiting
+    // for events. If animating, we sleep until the vsync callback, then
+    // until the frame should start; events are read meanwhile.
+    // ALooper_pollAll() would not return after the callback, so the timeout
+    // is recomputed after each ALooper_pollOnce().
+    int timeout = g_engine.ScheduleFrame();
+    while ((id = ALooper_pollOnce(timeout, NULL, &events,
+                                  (void **) &source)) != ALOOPER_POLL_TIMEOUT &&
+           id != ALOOPER_POLL_ERROR) {
+      // Callbacks (the vsync) and wakes have no source
+      if (id >= 0) {
+        // Process this event.
+        if (source != NULL) source->process(state, source);
+
+        g_engine.ProcessSensors(id);
+
+        // Check if we are exiting.
+        if (state->destroyRequested != 0) {
+          g_engine.StopSimulation();
+          ndk_helper::JobSystem::GetInstance()->Shutdown();
+          DestroyAssetManager(state);
+          g_engine.TermDisplay();
+          g_engine.ReleaseScheduler();
+          return;
+        }
       }
+      timeout = g_engine.ScheduleFrame();
     }
 
-    if (g_engine.IsReady()) {
-      // Drawing is throttled to the screen update rate, so there
-      // is no need to do timing here.
-      g_engine.DrawFrame();
+    ndk_helper::FRAME_TIMING timing;
+    if (g_engine.BeginFrame(&timing)) {
+      g_engine.StartSimulation();
+      g_engine.DrawFrame(&timing);
     }
   }
 }
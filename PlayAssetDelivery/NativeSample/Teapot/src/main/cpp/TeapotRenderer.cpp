@@ -22,16 +22,85 @@
 // Include files
 //--------------------------------------------------------------------------------
 #include "TeapotRenderer.h"
+#include "PlayAssetDeliveryUtil.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/system_properties.h>
+
+#include <algorithm>
+
+// Mesh files address attributes by semantic, which is also the location
+static_assert(static_cast<int>(ATTRIB_VERTEX) ==
+                      static_cast<int>(MESH_SEMANTIC_POSITION) &&
+                  static_cast<int>(ATTRIB_NORMAL) ==
+                      static_cast<int>(MESH_SEMANTIC_NORMAL) &&
+                  static_cast<int>(ATTRIB_UV) ==
+                      static_cast<int>(MESH_SEMANTIC_UV),
+              "Shader attribute locations must match mesh semantics");
+
+/**
+ * Shader sources and their #include files: "pack:file" names are read from
+ * that asset pack, anything else from the APK like JNIHelper::OpenFile()
+ */
+static bool LoadShaderSource(AAssetManager *assetManager,
+                             const std::string &fileName,
+                             std::string *source) {
+  std::string packName("install_time_pack");
+  std::string assetName(fileName);
+  size_t colon = fileName.find(':');
+  if (colon != std::string::npos) {
+    packName = fileName.substr(0, colon);
+    assetName = fileName.substr(colon + 1);
+  }
+  ndk_helper::AssetView view;
+  if (!OpenPackAsset(assetManager, assetName, packName,
+                     packName == "install_time_pack", &view)) {
+    return false;
+  }
+  source->assign(view.Data(), view.Data() + view.Size());
+  return true;
+}
 
-//--------------------------------------------------------------------------------
-// Teapot model data
-//--------------------------------------------------------------------------------
-#include "teapot.inl"
+/**
+ * Bind attribute locations
+ * this needs to be done prior to linking
+ */
+static std::map<std::string, GLint> AttributeLocations() {
+  std::map<std::string, GLint> attributes;
+  attributes["myVertex"] = ATTRIB_VERTEX;
+  attributes["myNormal"] = ATTRIB_NORMAL;
+  attributes["myUV"] = ATTRIB_UV;
+  attributes["myInstance"] = ATTRIB_INSTANCE;
+  return attributes;
+}
+
+int GetDebugProperty(const char *name, int defaultValue) {
+  char value[PROP_VALUE_MAX] = {};
+  if (__system_property_get(name, value) <= 0) return defaultValue;
+  return atoi(value);
+}
+
+static const int32_t kMaxInstances = 65536;
 
 //--------------------------------------------------------------------------------
 // Ctor
 //--------------------------------------------------------------------------------
-TeapotRenderer::TeapotRenderer() {}
+TeapotRenderer::TeapotRenderer()
+    : shader_param_(),
+      fallback_param_(),
+      shader_start_(0.0),
+      instance_count_(1),
+      instanced_(false),
+      instance_scale_(1.f),
+      instance_vbo_(0),
+      instance_start_(0.0),
+      cull_time_ns_(0),
+      cull_tested_(0),
+      cull_visible_(0),
+      camera_(nullptr),
+      app_(nullptr) {}
 
 //--------------------------------------------------------------------------------
 // Dtor
@@ -43,37 +112,36 @@ void TeapotRenderer::Init() {
   glFrontFace(GL_CCW);
 
   // Load shader
-  LoadShaders(&shader_param_, "Shaders/2DTexture.vsh",
-              "Shaders/2DTexture.fsh");
-  // Create Index buffer
-  num_indices_ = sizeof(teapotIndices) / sizeof(teapotIndices[0]);
-  glGenBuffers(1, &ibo_);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(teapotIndices), teapotIndices,
-               GL_STATIC_DRAW);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-  // Create VBO
-  num_vertices_ = sizeof(teapotPositions) / sizeof(teapotPositions[0]) / 3;
-  int32_t stride = sizeof(TEAPOT_VERTEX);
-  int32_t index = 0;
-  TEAPOT_VERTEX *p = new TEAPOT_VERTEX[num_vertices_];
-  for (int32_t i = 0; i < num_vertices_; ++i) {
-    p[i].pos[0] = teapotPositions[index];
-    p[i].pos[1] = teapotPositions[index + 1];
-    p[i].pos[2] = teapotPositions[index + 2];
-
-    p[i].normal[0] = teapotNormals[index];
-    p[i].normal[1] = teapotNormals[index + 1];
-    p[i].normal[2] = teapotNormals[index + 2];
-    index += 3;
+  AAssetManager *assetManager = app_->activity->assetManager;
+  ndk_helper::shader::Preprocessor::GetInstance()->SetLoader(
+      [assetManager](const std::string &fileName, std::string *source) {
+        return LoadShaderSource(assetManager, fileName, source);
+      });
+  // The fallback is tiny and built right away; the real program builds in
+  // the background and replaces it once linked, see PollShaders()
+  LoadShaders(&fallback_param_, "Shaders/Fallback.vsh", "Shaders/Fallback.fsh");
+  shader_start_ = ndk_helper::PerfMonitor::GetCurrentTime();
+  shader_future_ = ndk_helper::ProgramBuilder::GetInstance()->Build(
+      "Shaders/2DTexture.vsh", "Shaders/2DTexture.fsh",
+      std::map<std::string, std::string>(), AttributeLocations());
+  if (!shader_future_.IsValid()) {
+    LOGI("Can not read the 2DTexture shaders");
+    assert(false);
+  }
+  // Load the pre-interleaved teapot mesh, see tools/mesh_converter.
+  // The quantized layout halves the vertex size but needs GLES3 vertex types.
+  std::string meshFile(
+      ndk_helper::GLContext::GetInstance()->GetGLVersion() >= 3.0f
+          ? "Meshes/teapot_q.mesh" : "Meshes/teapot.mesh");
+  std::string meshPack("install_time_pack");
+  if (!mesh_.Load(meshFile, app_->activity->assetManager, meshPack, true)) {
+    LOGI("Failed to load %s", meshFile.c_str());
+    assert(false);
   }
-  glGenBuffers(1, &vbo_);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-  glBufferData(GL_ARRAY_BUFFER, stride * num_vertices_, p, GL_STATIC_DRAW);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-  delete[] p;
+  glGenBuffers(1, &instance_vbo_);
+  SetInstanceCount(GetDebugProperty("debug.teapot.instances", 1),
+                   GetDebugProperty("debug.teapot.instanced", 1) != 0);
 
   UpdateViewport();
   mat_model_ = ndk_helper::Mat4::Translation(0, 0, -15.f);
@@ -103,165 +171,363 @@ void TeapotRenderer::UpdateViewport() {
 }
 
 void TeapotRenderer::Unload() {
-  if (vbo_) {
-    glDeleteBuffers(1, &vbo_);
-    vbo_ = 0;
+  mesh_.Unload();
+
+  shader_future_.Reset();
+  instance_ring_.Release();
+  ndk_helper::GLStateCache *cache = ndk_helper::GLStateCache::GetInstance();
+  if (instance_vbo_) {
+    cache->DeleteBuffer(instance_vbo_);
+    instance_vbo_ = 0;
   }
-
-  if (ibo_) {
-    glDeleteBuffers(1, &ibo_);
-    ibo_ = 0;
-  }
-
   if (shader_param_.program_) {
-    glDeleteProgram(shader_param_.program_);
+    cache->DeleteProgram(shader_param_.program_);
     shader_param_.program_ = 0;
   }
+  if (fallback_param_.program_) {
+    cache->DeleteProgram(fallback_param_.program_);
+    fallback_param_.program_ = 0;
+  }
 }
 
-void TeapotRenderer::Update(float fTime) {
+void TeapotRenderer::UpdateView(FRAME_SNAPSHOT *frame) {
   const float CAM_X = 0.f;
   const float CAM_Y = 0.f;
   const float CAM_Z = 700.f;
 
-  mat_view_ = ndk_helper::Mat4::LookAt(ndk_helper::Vec3(CAM_X, CAM_Y, CAM_Z),
-                                       ndk_helper::Vec3(0.f, 0.f, 0.f),
-                                       ndk_helper::Vec3(0.f, 1.f, 0.f));
+  ndk_helper::Mat4 mat_view =
+      ndk_helper::Mat4::LookAt(ndk_helper::Vec3(CAM_X, CAM_Y, CAM_Z),
+                               ndk_helper::Vec3(0.f, 0.f, 0.f),
+                               ndk_helper::Vec3(0.f, 1.f, 0.f));
 
   if (camera_) {
     camera_->Update();
-    mat_view_ = camera_->GetTransformMatrix() * mat_view_ *
+    frame->view = camera_->GetTransformMatrix() * mat_view *
         camera_->GetRotationMatrix() * mat_model_;
   } else {
-    mat_view_ = mat_view_ * mat_model_;
+    frame->view = mat_view * mat_model_;
   }
 }
 
-void TeapotRenderer::Render() {
-  //
-  // Feed Projection and Model View matrices to the shaders
-  ndk_helper::Mat4 mat_vp = mat_projection_ * mat_view_;
+void TeapotRenderer::SetInstanceCount(int32_t count, bool instanced) {
+  count = std::max(1, std::min(count, kMaxInstances));
+  // glDrawElementsInstanced comes from gl3stub, null before OpenGL ES 3
+  instanced_ = instanced && glDrawElementsInstanced != nullptr &&
+               ndk_helper::GLContext::GetInstance()->GetGLVersion() >= 3.0f;
+  instance_count_ = count;
+  instance_offsets_.resize(count * 2);
+  visible_.resize(count);
+  visible_data_.resize(instanced_ ? count * 16 : 0);
+  if (instanced_) {
+    instance_ring_.Init(GL_ARRAY_BUFFER, count * 16 * sizeof(float));
+  } else {
+    instance_ring_.Release();
+  }
+  instance_start_ = ndk_helper::PerfMonitor::GetCurrentTime();
+
+  // A square grid filling the space of the single teapot
+  int32_t side = 1;
+  while (side * side < count) ++side;
+  const MESH_FILE_HEADER &header = mesh_.GetHeader();
+  float spacing = 1.25f * std::max(header.bounds_max[0] - header.bounds_min[0],
+                                   header.bounds_max[1] - header.bounds_min[1]);
+  instance_scale_ = 1.f / side;
+  for (int32_t i = 0; i < count; ++i) {
+    float column = (i % side) - (side - 1) * 0.5f;
+    float row = (i / side) - (side - 1) * 0.5f;
+    instance_offsets_[i * 2] = column * spacing * instance_scale_;
+    instance_offsets_[i * 2 + 1] = row * spacing * instance_scale_;
+  }
+  LOGI("Drawing %d teapots, %s", count,
+       instanced_ ? "instanced" : "one draw call each");
+}
 
-  // Bind the VBO
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+bool TeapotRenderer::IsAnimating() const {
+  return instance_count_ > 1 || shader_future_.IsValid();
+}
 
-  int32_t iStride = sizeof(TEAPOT_VERTEX);
-  // Pass the vertex data
-  glVertexAttribPointer(ATTRIB_VERTEX, 3, GL_FLOAT, GL_FALSE, iStride,
-                        BUFFER_OFFSET(0));
-  glEnableVertexAttribArray(ATTRIB_VERTEX);
+struct INSTANCE_ANIMATION {
+  float elapsed;
+  float scale;
+  const float *offsets;  // x, y of each grid cell
+  const float *sphere;   // of the mesh
+  FRAME_SNAPSHOT *frame;
+};
+
+// Instances [begin, end), on any thread of the job system
+static void AnimateInstances(uint32_t begin, uint32_t end, void *data) {
+  const INSTANCE_ANIMATION &animation =
+      *static_cast<const INSTANCE_ANIMATION *>(data);
+  const float k = animation.scale;
+  const float *sphere = animation.sphere;
+  SPHERES_SOA &spheres = animation.frame->spheres;
+  for (uint32_t i = begin; i < end; ++i) {
+    float angle = animation.elapsed * (0.5f + (i % 7) * 0.25f) + i;
+    float c = cosf(angle) * k;
+    float s = sinf(angle) * k;
+    float *m = &animation.frame->instances[i * 16];
+    m[0] = c;   m[1] = 0.f; m[2] = -s;  m[3] = 0.f;
+    m[4] = 0.f; m[5] = k;   m[6] = 0.f; m[7] = 0.f;
+    m[8] = s;   m[9] = 0.f; m[10] = c;  m[11] = 0.f;
+    m[12] = animation.offsets[i * 2];
+    m[13] = animation.offsets[i * 2 + 1];
+    m[14] = 0.f;
+    m[15] = 1.f;
+    // The transform scales uniformly, so the sphere only moves and shrinks
+    spheres.x[i] = m[0] * sphere[0] + m[8] * sphere[2] + m[12];
+    spheres.y[i] = k * sphere[1] + m[13];
+    spheres.z[i] = m[2] * sphere[0] + m[10] * sphere[2];
+    spheres.radius[i] = k * sphere[3];
+  }
+}
 
-  glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, iStride,
-                        BUFFER_OFFSET(3 * sizeof(GLfloat)));
-  glEnableVertexAttribArray(ATTRIB_NORMAL);
+/**
+ * Per instance transform: spin around Y, scale down and move to the grid
+ * cell. The single teapot stays still, as it always did. Large counts are
+ * spread over the job system's workers.
+ */
+void TeapotRenderer::UpdateInstances(double time, FRAME_SNAPSHOT *frame) {
+  NDK_TRACE_SCOPE("TeapotRenderer::UpdateInstances");
+  const float *sphere = mesh_.GetBoundingSphere();
+  SPHERES_SOA &spheres = frame->spheres;
+  frame->instance_count = instance_count_;
+  frame->instances.resize(instance_count_ * 16);
+  spheres.Resize(instance_count_);
+  if (instance_count_ == 1) {
+    static const float kIdentity[16] = {1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f,
+                                        0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f};
+    std::copy(kIdentity, kIdentity + 16, frame->instances.begin());
+    spheres.x[0] = sphere[0];
+    spheres.y[0] = sphere[1];
+    spheres.z[0] = sphere[2];
+    spheres.radius[0] = sphere[3];
+    return;
+  }
+  INSTANCE_ANIMATION animation = {
+      static_cast<float>(time - instance_start_), instance_scale_,
+      instance_offsets_.data(), sphere, frame};
+  // A batch is a few microseconds of work, well above the cost of a job
+  const uint32_t kBatch = 256;
+  ndk_helper::JobSystem::GetInstance()->ParallelFor(
+      instance_count_, kBatch, AnimateInstances, &animation);
+}
 
-  // Bind the IB
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+/**
+ * Instances are transformed in model space, before the view, so the planes
+ * of the view projection matrix cull the spheres of UpdateInstances().
+ */
+size_t TeapotRenderer::CullInstances(ndk_helper::Mat4 &viewProjection,
+                                     const SPHERES_SOA &spheres) {
+  NDK_TRACE_SCOPE("TeapotRenderer::CullInstances");
+  int64_t start = ndk_helper::PerfMonitor::GetCurrentTimeNs();
+  FRUSTUM frustum;
+  ExtractFrustum(viewProjection.Ptr(), &frustum);
+  size_t count = CullSpheres(frustum, spheres, visible_.data());
+  cull_time_ns_ += ndk_helper::PerfMonitor::GetCurrentTimeNs() - start;
+  cull_tested_ += spheres.Size();
+  cull_visible_ += count;
+  NDK_TRACE_COUNTER("Teapots visible", count);
+  return count;
+}
+
+void TeapotRenderer::DumpStats() {
+  if (instance_ring_.IsSupported()) {
+    LOGI("Instance upload ring: %u stalls, %.2f ms waiting for the GPU, "
+         "%u overflows",
+         instance_ring_.GetStallCount(),
+         instance_ring_.GetStallTimeNs() / 1e6,
+         instance_ring_.GetOverflowCount());
+  }
+  if (cull_tested_) {
+    double ms = cull_time_ns_ / 1e6;
+    LOGI("Frustum culling: %llu instances in %.2f ms, %.0f instances/ms, "
+         "%.1f%% visible",
+         static_cast<unsigned long long>(cull_tested_), ms,
+         ms > 0.0 ? cull_tested_ / ms : 0.0,
+         100.0 * cull_visible_ / cull_tested_);
+  }
+  cull_time_ns_ = 0;
+  cull_tested_ = 0;
+  cull_visible_ = 0;
+}
 
-  glUseProgram(shader_param_.program_);
+/**
+ * Instanced: the transforms are written to an upload ring, or streamed with
+ * glBufferSubData() if it can't take them, and read with a divisor of one.
+ * Otherwise each draw sets them as constant attribute values, the cheapest
+ * per draw state there is, so the comparison is about draw calls.
+ */
+void TeapotRenderer::DrawInstances(const FRAME_SNAPSHOT &frame,
+                                   const uint32_t *visible,
+                                   size_t visibleCount) {
+  const std::vector<float> &instances = frame.instances;
+  NDK_TRACE_SCOPE("TeapotRenderer::DrawInstances");
+  NDK_TRACE_COUNTER("Teapot draw calls", instanced_ ? 1 : visibleCount);
+  if (visibleCount == 0) return;
+  const GLsizei stride = 16 * sizeof(float);
+  if (!instanced_) {
+    for (size_t i = 0; i < visibleCount; ++i) {
+      const float *m = &instances[visible[i] * 16];
+      for (int32_t c = 0; c < 4; ++c) {
+        glVertexAttrib4fv(ATTRIB_INSTANCE + c, m + c * 4);
+      }
+      mesh_.Draw();
+    }
+    return;
+  }
 
-  TEAPOT_MATERIALS material = {
+  // Upload only the visible transforms, packed, straight into the ring
+  ndk_helper::GLStateCache *cache = ndk_helper::GLStateCache::GetInstance();
+  GLsizeiptr size = visibleCount * stride;
+  GLintptr offset = 0;
+  instance_ring_.BeginFrame();
+  ndk_helper::UPLOAD_ALLOCATION allocation =
+      instance_ring_.Allocate(size, sizeof(float) * 4);
+  if (allocation.data) {
+    float *dst = static_cast<float *>(allocation.data);
+    if (visibleCount == static_cast<size_t>(instance_count_)) {
+      memcpy(dst, instances.data(), size);
+    } else {
+      for (size_t i = 0; i < visibleCount; ++i) {
+        memcpy(dst + i * 16, &instances[visible[i] * 16], stride);
+      }
+    }
+    instance_ring_.Unmap();
+    cache->BindBuffer(GL_ARRAY_BUFFER, instance_ring_.GetBuffer());
+    offset = allocation.offset;
+  } else {
+    const float *data = instances.data();
+    if (visibleCount < static_cast<size_t>(instance_count_)) {
+      for (size_t i = 0; i < visibleCount; ++i) {
+        memcpy(&visible_data_[i * 16], &instances[visible[i] * 16],
+               stride);
+      }
+      data = visible_data_.data();
+    }
+    cache->BindBuffer(GL_ARRAY_BUFFER, instance_vbo_);
+    // Orphan last frame's storage rather than wait for the GPU to release it
+    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+  }
+  for (int32_t c = 0; c < 4; ++c) {
+    glVertexAttribPointer(ATTRIB_INSTANCE + c, 4, GL_FLOAT, GL_FALSE, stride,
+                          BUFFER_OFFSET(offset + c * 4 * sizeof(float)));
+    glEnableVertexAttribArray(ATTRIB_INSTANCE + c);
+    glVertexAttribDivisor(ATTRIB_INSTANCE + c, 1);
+  }
+  mesh_.DrawInstanced(static_cast<GLsizei>(visibleCount));
+  for (int32_t c = 0; c < 4; ++c) {
+    glVertexAttribDivisor(ATTRIB_INSTANCE + c, 0);
+    glDisableVertexAttribArray(ATTRIB_INSTANCE + c);
+  }
+  instance_ring_.EndFrame();
+}
+
+void TeapotRenderer::Render(const FRAME_SNAPSHOT &frame) {
+  NDK_TRACE_SCOPE("TeapotRenderer::Render");
+  // Left over from before SetInstanceCount(), sized for other buffers
+  if (frame.instance_count != instance_count_) return;
+  //
+  // Feed Projection and Model View matrices to the shaders
+  ndk_helper::Mat4 mat_view = frame.view;
+  ndk_helper::Mat4 mat_vp = mat_projection_ * mat_view;
+  size_t visibleCount = CullInstances(mat_vp, frame.spheres);
+
+  // Bind the vertex array object, or the VBO, IB and vertex attributes
+  mesh_.Bind();
+
+  if (shader_future_.IsValid()) PollShaders();
+  const SHADER_PARAMS &params =
+      shader_param_.program_ ? shader_param_ : fallback_param_;
+  // Unchanged state, like the constant material, doesn't reach the driver
+  ndk_helper::GLStateCache *cache = ndk_helper::GLStateCache::GetInstance();
+  cache->UseProgram(params.program_);
+
+  static const TEAPOT_MATERIALS kMaterial = {
       {1.0f, 0.5f, 0.5f}, {1.0f, 1.0f, 1.0f, 10.f}, {0.1f, 0.1f, 0.1f},};
 
   // Update uniforms
-  glUniform4f(shader_param_.material_diffuse_, material.diffuse_color[0],
-              material.diffuse_color[1], material.diffuse_color[2], 1.f);
+  cache->Uniform4f(params.material_diffuse_, kMaterial.diffuse_color[0],
+                   kMaterial.diffuse_color[1], kMaterial.diffuse_color[2],
+                   1.f);
 
-  glUniform4f(shader_param_.material_specular_, material.specular_color[0],
-              material.specular_color[1], material.specular_color[2],
-              material.specular_color[3]);
+  cache->Uniform4f(params.material_specular_, kMaterial.specular_color[0],
+                   kMaterial.specular_color[1], kMaterial.specular_color[2],
+                   kMaterial.specular_color[3]);
   //
   // using glUniform3fv here was troublesome
   //
-  glUniform3f(shader_param_.material_ambient_, material.ambient_color[0],
-              material.ambient_color[1], material.ambient_color[2]);
+  cache->Uniform3f(params.material_ambient_, kMaterial.ambient_color[0],
+                   kMaterial.ambient_color[1], kMaterial.ambient_color[2]);
+
+  cache->UniformMatrix4fv(params.matrix_projection_, mat_vp.Ptr());
+  cache->UniformMatrix4fv(params.matrix_view_, mat_view.Ptr());
+  cache->Uniform3f(params.light0_, 100.f, -200.f, -600.f);
 
-  glUniformMatrix4fv(shader_param_.matrix_projection_, 1, GL_FALSE,
-                     mat_vp.Ptr());
-  glUniformMatrix4fv(shader_param_.matrix_view_, 1, GL_FALSE, mat_view_.Ptr());
-  glUniform3f(shader_param_.light0_, 100.f, -200.f, -600.f);
+  const float *scale = mesh_.GetPositionScale();
+  const float *bias = mesh_.GetPositionBias();
+  cache->Uniform3f(params.position_scale_, scale[0], scale[1], scale[2]);
+  cache->Uniform3f(params.position_bias_, bias[0], bias[1], bias[2]);
 
-  glDrawElements(GL_TRIANGLES, num_indices_, GL_UNSIGNED_SHORT,
-                 BUFFER_OFFSET(0));
+  DrawInstances(frame, visible_.data(), visibleCount);
 
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  mesh_.Unbind();
 }
 
 bool TeapotRenderer::LoadShaders(SHADER_PARAMS *params, const char *strVsh,
                                  const char *strFsh) {
-  GLuint program;
-  GLuint vert_shader, frag_shader;
-
-  // Create shader program
-  program = glCreateProgram();
-  LOGI("Created Shader %d", program);
-
-  // Create and compile vertex shader
-  if (!ndk_helper::shader::CompileShader(&vert_shader, GL_VERTEX_SHADER,
-                                         strVsh)) {
-    LOGI("Failed to compile vertex shader");
-    glDeleteProgram(program);
+  // Warm starts load the linked binary and its locations from the cache
+  ndk_helper::PROGRAM_REFLECTION reflection;
+  GLuint program = ndk_helper::ProgramCache::GetInstance()->Load(
+      strVsh, strFsh, std::map<std::string, std::string>(),
+      AttributeLocations(), &reflection);
+  if (!program) {
+    LOGI("Failed to build program from %s and %s", strVsh, strFsh);
     assert(false);
     return false;
   }
+  LOGI("Created Shader %d", program);
+  SetShaderParams(params, program, reflection);
+  return true;
+}
 
-  // Create and compile fragment shader
-  if (!ndk_helper::shader::CompileShader(&frag_shader, GL_FRAGMENT_SHADER,
-                                         strFsh)) {
-    LOGI("Failed to compile fragment shader");
-    glDeleteProgram(program);
-    assert(false);
-    return false;
-  }
-
-  // Attach vertex shader to program
-  glAttachShader(program, vert_shader);
-
-  // Attach fragment shader to program
-  glAttachShader(program, frag_shader);
-
-  // Bind attribute locations
-  // this needs to be done prior to linking
-  glBindAttribLocation(program, ATTRIB_VERTEX, "myVertex");
-  glBindAttribLocation(program, ATTRIB_NORMAL, "myNormal");
-  glBindAttribLocation(program, ATTRIB_UV, "myUV");
-
-  // Link program
-  if (!ndk_helper::shader::LinkProgram(program)) {
-    LOGI("Failed to link program: %d", program);
-
-    if (vert_shader) {
-      glDeleteShader(vert_shader);
-      vert_shader = 0;
-    }
-    if (frag_shader) {
-      glDeleteShader(frag_shader);
-      frag_shader = 0;
-    }
-    if (program) {
-      glDeleteProgram(program);
-    }
-
-    return false;
-  }
-
+void TeapotRenderer::SetShaderParams(
+    SHADER_PARAMS *params, GLuint program,
+    const ndk_helper::PROGRAM_REFLECTION &reflection) {
   // Get uniform locations
-  params->matrix_projection_ = glGetUniformLocation(program, "uPMatrix");
-  params->matrix_view_ = glGetUniformLocation(program, "uMVMatrix");
+  params->matrix_projection_ = reflection.GetUniform("uPMatrix");
+  params->matrix_view_ = reflection.GetUniform("uMVMatrix");
 
-  params->light0_ = glGetUniformLocation(program, "vLight0");
-  params->material_diffuse_ = glGetUniformLocation(program, "vMaterialDiffuse");
-  params->material_ambient_ = glGetUniformLocation(program, "vMaterialAmbient");
-  params->material_specular_ =
-      glGetUniformLocation(program, "vMaterialSpecular");
-
-  // Release vertex and fragment shaders
-  if (vert_shader) glDeleteShader(vert_shader);
-  if (frag_shader) glDeleteShader(frag_shader);
+  params->light0_ = reflection.GetUniform("vLight0");
+  params->material_diffuse_ = reflection.GetUniform("vMaterialDiffuse");
+  params->material_ambient_ = reflection.GetUniform("vMaterialAmbient");
+  params->material_specular_ = reflection.GetUniform("vMaterialSpecular");
+  params->position_scale_ = reflection.GetUniform("uPositionScale");
+  params->position_bias_ = reflection.GetUniform("uPositionBias");
 
   params->program_ = program;
-  return true;
+}
+
+/**
+ * Check on the background build without waiting; the fallback keeps being
+ * drawn until it is done, and for good if it fails.
+ */
+void TeapotRenderer::PollShaders() {
+  ndk_helper::PROGRAM_STATUS status = shader_future_.Poll();
+  if (status == ndk_helper::PROGRAM_PENDING) return;
+
+  if (status == ndk_helper::PROGRAM_READY) {
+    ndk_helper::PROGRAM_REFLECTION reflection;
+    GLuint program = shader_future_.Get(&reflection);
+    SetShaderParams(&shader_param_, program, reflection);
+    LOGI("Shader %d ready after %.3f ms", program,
+         (ndk_helper::PerfMonitor::GetCurrentTime() - shader_start_) * 1000.0);
+    ndk_helper::GLStateCache::GetInstance()->UseProgram(program);
+    OnShaderReady(reflection);
+  } else {
+    LOGI("Failed to build the 2DTexture shaders, keeping the fallback");
+  }
+  shader_future_.Reset();
 }
 
 bool TeapotRenderer::Bind(ndk_helper::TapCamera *camera) {
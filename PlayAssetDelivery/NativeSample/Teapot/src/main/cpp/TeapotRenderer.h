@@ -41,18 +41,16 @@
 #define APPLICATION_CLASS_NAME "com/sample/teapot/TeapotApplication"
 
 #include "NDKHelper.h"
+#include "Mesh.h"
+#include "FrustumCull.h"
 
 #define BUFFER_OFFSET(i) ((char*)NULL + (i))
 
-struct TEAPOT_VERTEX {
-  float pos[3];
-  float normal[3];
-};
-
 enum SHADER_ATTRIBUTES {
   ATTRIB_VERTEX,
   ATTRIB_NORMAL,
   ATTRIB_UV,
+  ATTRIB_INSTANCE,  // mat4, takes this and the next three locations
 };
 
 struct SHADER_PARAMS {
@@ -64,6 +62,9 @@ struct SHADER_PARAMS {
 
   GLuint matrix_projection_;
   GLuint matrix_view_;
+
+  GLuint position_scale_;
+  GLuint position_bias_;
 };
 
 struct TEAPOT_MATERIALS {
@@ -72,21 +73,65 @@ struct TEAPOT_MATERIALS {
   float ambient_color[3];
 };
 
+/**
+ * What the simulation hands over to Render() each frame. Written by
+ * UpdateView() and UpdateInstances(), possibly on another thread, then
+ * only read; see ndk_helper::Mailbox.
+ */
+struct FRAME_SNAPSHOT {
+  ndk_helper::Mat4 view;
+  int32_t instance_count;
+  std::vector<float> instances;  // a column major mat4 per instance
+  SPHERES_SOA spheres;           // world space bounds of each instance
+
+  FRAME_SNAPSHOT() : instance_count(0) {}
+};
+
+// Integer system property, e.g. adb shell setprop debug.teapot.instances 64
+int GetDebugProperty(const char *name, int defaultValue);
+
 class TeapotRenderer {
  protected:
-  int32_t num_indices_;
-  int32_t num_vertices_;
-  GLuint ibo_;
-  GLuint vbo_;
+  Mesh mesh_;
 
   SHADER_PARAMS shader_param_;
+  // Flat shaded stand-in drawn until shader_param_ is built
+  SHADER_PARAMS fallback_param_;
+  ndk_helper::ProgramFuture shader_future_;
+  double shader_start_;
   bool LoadShaders(SHADER_PARAMS *params, const char *strVsh,
                    const char *strFsh);
+  void SetShaderParams(SHADER_PARAMS *params, GLuint program,
+                       const ndk_helper::PROGRAM_REFLECTION &reflection);
+  void PollShaders();
+  // The textured program is linked and in use, set up its other uniforms
+  // with the locations of reflection
+  virtual void OnShaderReady(
+      const ndk_helper::PROGRAM_REFLECTION &reflection) {}
 
   ndk_helper::Mat4 mat_projection_;
-  ndk_helper::Mat4 mat_view_;
   ndk_helper::Mat4 mat_model_;
 
+  // Copies of the teapot in a grid, each spinning on its own
+  int32_t instance_count_;
+  bool instanced_;  // one glDrawElementsInstanced, else one draw each
+  std::vector<float> instance_offsets_;  // x, y of each grid cell
+  float instance_scale_;
+  GLuint instance_vbo_;  // when instance_ring_ is unavailable or full
+  ndk_helper::UploadRing instance_ring_;
+  double instance_start_;
+  void DrawInstances(const FRAME_SNAPSHOT &frame, const uint32_t *visible,
+                     size_t visibleCount);
+
+  // Instances whose bounding sphere is in the view frustum are drawn
+  std::vector<uint32_t> visible_;
+  std::vector<float> visible_data_;  // matrices of visible_, when instanced
+  size_t CullInstances(ndk_helper::Mat4 &viewProjection,
+                       const SPHERES_SOA &spheres);
+  int64_t cull_time_ns_;
+  uint64_t cull_tested_;
+  uint64_t cull_visible_;
+
   ndk_helper::TapCamera *camera_;
   android_app *app_;
   void Init();
@@ -94,11 +139,35 @@ class TeapotRenderer {
   TeapotRenderer();
   virtual ~TeapotRenderer();
   virtual void Init(android_app *app) = 0;
-  virtual void Render();
-  void Update(float dTime);
+  virtual void Render(const FRAME_SNAPSHOT &frame);
+  /**
+   * Simulation, the camera and then the teapots. Both only read what
+   * Init() and SetInstanceCount() set up, so they can run on another
+   * thread than Render() as long as those two don't run meanwhile.
+   * UpdateView() also updates the camera, which the caller must guard
+   * against input handling.
+   */
+  void UpdateView(FRAME_SNAPSHOT *frame);
+  void UpdateInstances(double time, FRAME_SNAPSHOT *frame);
   bool Bind(ndk_helper::TapCamera *camera);
   virtual void Unload();
   void UpdateViewport();
+  /**
+   * Number of teapots for stress tests, and whether to draw them with
+   * instancing (OpenGL ES 3) or with one draw call each. Init() takes them
+   * from the debug.teapot.instances and debug.teapot.instanced properties.
+   */
+  void SetInstanceCount(int32_t count, bool instanced);
+  /**
+   * True while frames change without input: the teapots spin when there
+   * are several, and shaders still being built get polled every frame.
+   */
+  virtual bool IsAnimating() const;
+  /**
+   * Log frustum culling throughput since the last call and the upload
+   * ring stalls.
+   */
+  void DumpStats();
 };
 
 #endif
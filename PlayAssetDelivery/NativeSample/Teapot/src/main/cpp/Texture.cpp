@@ -14,29 +14,51 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
 #include "Texture.h"
+#include "KtxFormat.h"
+#include "MipChain.h"
 #include "PlayAssetDeliveryUtil.h"
+#include "GLContext.h"
+#include "trace.h"
 #include <GLES3/gl32.h>
 #define STB_IMAGE_IMPLEMENTATION
 #include <third_party/stb/stb_image.h>
 #define MODULE_NAME "Teapot::Texture"
+// Log under MODULE_NAME rather than the JNIHelper tag GLContext.h brings
+#undef LOGI
+#undef LOGW
+#undef LOGE
 #include "android_debug.h"
 
 class Texture2d : public Texture {
  protected:
   GLuint texId_ = GL_INVALID_VALUE;
   bool activated_ = false;
+  TextureLoader *loader_ = nullptr;
+  uint32_t requestId_ = 0;
+  size_t bytes_ = 0;
+
+  bool LoadKtx(std::string &texFile,
+               AAssetManager *assetManager,
+               std::string &packName,
+               bool isUnderApk);
  public:
   virtual ~Texture2d();
   // Implement just one texture
   Texture2d(std::string &texFile,
             AAssetManager *assetManager,
             std::string &packName,
-            bool isUnderApk);
+            bool isUnderApk,
+            TextureLoader *loader,
+            const std::string &fallbackFile);
 
   virtual bool GetActiveSamplerInfo(std::vector<std::string> &names,
                                     std::vector<GLint> &units);
   virtual bool Activate(void);
+  virtual bool IsLoading();
+  virtual size_t GetSizeInBytes();
   virtual GLuint GetTexType();
   virtual GLuint GetTexId();
 };
@@ -61,8 +83,31 @@ Texture::~Texture() {}
 Texture *Texture::Create(std::string &texFile,
                          AAssetManager *assetManager,
                          std::string &packName,
-                         bool isUnderApk) {
-  return dynamic_cast<Texture *>(new Texture2d(texFile, assetManager, packName, isUnderApk));
+                         bool isUnderApk,
+                         TextureLoader *loader,
+                         const std::string &fallbackFile) {
+  return dynamic_cast<Texture *>(new Texture2d(
+      texFile, assetManager, packName, isUnderApk, loader, fallbackFile));
+}
+
+bool Texture::IsFormatSupported(uint32_t internalFormat) {
+  ndk_helper::GLContext *context = ndk_helper::GLContext::GetInstance();
+  bool es3 = context->GetGLVersion() >= 3.0f;
+  if (internalFormat == KTX_FORMAT_ETC1_RGB8) {
+    return es3 || context->CheckExtension("GL_OES_compressed_ETC1_RGB8_texture");
+  }
+  if (KtxIsAstc(internalFormat)) {
+    return context->CheckExtension("GL_KHR_texture_compression_astc_ldr");
+  }
+  switch (internalFormat) {
+    case KTX_FORMAT_ETC2_RGB8:
+    case KTX_FORMAT_ETC2_SRGB8:
+    case KTX_FORMAT_ETC2_RGBA8:
+    case KTX_FORMAT_ETC2_SRGB8_ALPHA8:
+      return es3;
+    default:
+      return false;
+  }
 }
 
 void Texture::Delete(Texture *obj) {
@@ -85,7 +130,10 @@ void Texture::Delete(Texture *obj) {
 Texture2d::Texture2d(std::string &texFile,
                      AAssetManager *assetManager,
                      std::string &packName,
-                     bool isUnderApk) {
+                     bool isUnderApk,
+                     TextureLoader *loader,
+                     const std::string &fallbackFile) {
+  NDK_TRACE_SCOPE("Texture2d::Texture2d");
   if (!assetManager) {
     LOGE("AssetManager to Texture2D() could not be null!!!");
     assert(false);
@@ -103,6 +151,38 @@ Texture2d::Texture2d(std::string &texFile,
     return;
   }
 
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+  if (loader) {
+    // Decode on the loader's workers, the image shows up in a later frame.
+    // KTX levels are streamed from the mapped file the same way.
+    loader_ = loader;
+    requestId_ = loader_->Request(texId_, texName, assetManager, packName,
+                                  isUnderApk, &bytes_, fallbackFile);
+    return;
+  }
+
+  if (KtxIsFileName(texName)) {
+    // Nothing to decode, the payload goes to the GPU as is
+    if (LoadKtx(texName, assetManager, packName, isUnderApk)) {
+      glActiveTexture(GL_TEXTURE0);
+      return;
+    }
+    if (fallbackFile.empty()) {
+      const uint8_t gray[4] = {128, 128, 128, 255};
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, gray);
+      bytes_ = sizeof(gray);
+      glActiveTexture(GL_TEXTURE0);
+      return;
+    }
+    LOGW("Decoding %s instead", fallbackFile.c_str());
+    texName = fallbackFile;
+  }
+
   // tga/bmp files are saved as vertical mirror images ( at least more than half ).
   stbi_set_flip_vertically_on_load(1);
   uint8_t *imageBits;
@@ -121,18 +201,77 @@ Texture2d::Texture2d(std::string &texFile,
                imgWidth, imgHeight,
                0,                // border color
                GL_RGBA, GL_UNSIGNED_BYTE, imageBits);
+  bytes_ = static_cast<size_t>(imgWidth) * imgHeight * 4;
 
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  // ES 2 can't mipmap NPOT textures without GL_OES_texture_npot
+  ndk_helper::GLContext *context = ndk_helper::GLContext::GetInstance();
+  if (imageBits && (context->GetGLVersion() >= 3.0f ||
+                    context->CheckExtension("GL_OES_texture_npot"))) {
+    MIP_CHAIN mips;
+    BuildMipChain(imageBits, imgWidth, imgHeight, &mips);
+    for (size_t i = 0; i < mips.offsets.size(); ++i) {
+      int32_t level = i + 1;
+      glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA,
+                   MipLevelSize(imgWidth, level),
+                   MipLevelSize(imgHeight, level), 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, &mips.pixels[mips.offsets[i]]);
+    }
+    bytes_ += mips.pixels.size();
+    if (!mips.offsets.empty()) {
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                      GL_LINEAR_MIPMAP_LINEAR);
+    }
+  }
 
   glActiveTexture(GL_TEXTURE0);
 
   stbi_image_free(imageBits);
 }
 
+/**
+ * Upload every mip level of a KTX/KTX2 file straight from the mapped file,
+ * for textures created without a loader
+ */
+bool Texture2d::LoadKtx(std::string &texFile,
+                        AAssetManager *assetManager,
+                        std::string &packName,
+                        bool isUnderApk) {
+  ndk_helper::AssetView view;
+  if (!OpenPackAsset(assetManager, texFile, packName, isUnderApk, &view)) {
+    LOGE("%s does not exist in %s", texFile.c_str(), packName.c_str());
+    return false;
+  }
+
+  KTX_TEXTURE ktx;
+  if (!ParseKtx(view.Data(), view.Size(), &ktx)) {
+    LOGE("%s is not a supported KTX texture", texFile.c_str());
+    return false;
+  }
+  if (!IsFormatSupported(ktx.internal_format)) {
+    LOGE("%s: format 0x%x is not supported by the GPU", texFile.c_str(),
+         ktx.internal_format);
+    return false;
+  }
+
+  for (size_t level = 0; level < ktx.levels.size(); ++level) {
+    GLsizei width = std::max(ktx.width >> level, 1u);
+    GLsizei height = std::max(ktx.height >> level, 1u);
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, ktx.internal_format,
+                           width, height, 0,
+                           ktx.levels[level].size, ktx.levels[level].data);
+    bytes_ += ktx.levels[level].size;
+  }
+  if (ktx.levels.size() > 1) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+  }
+  return true;
+}
+
 Texture2d::~Texture2d() {
+  if (loader_ && requestId_) {
+    loader_->Cancel(requestId_);
+  }
   if (texId_ != GL_INVALID_VALUE) {
     glDeleteTextures(1, &texId_);
     texId_ = GL_INVALID_VALUE;
@@ -157,12 +296,21 @@ bool Texture2d::GetActiveSamplerInfo(std::vector<std::string> &names,
 }
 
 bool Texture2d::Activate(void) {
-  glBindTexture(texId_, GL_TEXTURE0);
   glActiveTexture(GL_TEXTURE0 + 0);
+  glBindTexture(GL_TEXTURE_2D,
+                IsLoading() ? loader_->GetPlaceholder() : texId_);
   activated_ = true;
   return true;
 }
 
+bool Texture2d::IsLoading() {
+  return loader_ && requestId_ && loader_->IsPending(requestId_);
+}
+
+size_t Texture2d::GetSizeInBytes() {
+  return bytes_;
+}
+
 GLuint Texture2d::GetTexType() {
   return GL_TEXTURE_2D;
 }
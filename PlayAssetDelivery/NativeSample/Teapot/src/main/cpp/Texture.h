@@ -23,10 +23,16 @@
 #include <string>
 #include <vector>
 
+#include "TextureLoader.h"
+
 /**
  *  class Texture
  *    adding texture into teapot
  *     - oad image in assets/Textures
+ *     - .ktx/.ktx2 files with ETC/ASTC payloads are uploaded compressed with
+ *       glCompressedTexImage2D(), anything else is decoded by stb_image
+ *     - mipmapped with trilinear filtering when the file has a mip chain,
+ *       decoded images get one built on the CPU
  *     - enable texture units
  *     - report samplers needed inside shader
  *  Functionality wise:
@@ -45,16 +51,34 @@ class Texture {
  * @param texFiles holds the texture file name under APK's assets
  * @param assetManager is used to open texture files inside assets
  * @param isUnderApk is used to determine the method for open texture file
+ * @param loader decodes the texture in the background when given; a
+ *        placeholder is bound by Activate() until the image is uploaded.
+ *        Without a loader the texture is decoded and uploaded right away.
+ * @param fallbackFile image in the same pack to decode instead when
+ *        texFile is a KTX file that can't be loaded, e.g. the JPEG it was
+ *        made from; may be empty
  */
   static Texture *Create(std::string &texFile,
                          AAssetManager *assetManager,
                          std::string &packName,
-                         bool isUnderApk);
+                         bool isUnderApk,
+                         TextureLoader *loader = nullptr,
+                         const std::string &fallbackFile = std::string());
   static void Delete(Texture *obj);
 
+  /**
+   * True when the GPU can sample the compressed format (KTX_FORMAT) directly.
+   * ETC2 is core in OpenGL ES 3.0, ETC1 and ASTC need extensions.
+   */
+  static bool IsFormatSupported(uint32_t internalFormat);
+
   virtual bool GetActiveSamplerInfo(std::vector<std::string> &names,
                                     std::vector<GLint> &units) = 0;
   virtual bool Activate(void) = 0;
+  // True while no level of the image has been uploaded yet
+  virtual bool IsLoading() = 0;
+  // GPU memory held by the texture, 0 until its storage is allocated
+  virtual size_t GetSizeInBytes() = 0;
   virtual GLuint GetTexType() = 0;
   virtual GLuint GetTexId() = 0;
 
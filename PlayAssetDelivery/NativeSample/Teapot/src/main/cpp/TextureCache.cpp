@@ -0,0 +1,143 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TextureCache.h"
+
+#define MODULE_NAME "Teapot::TextureCache"
+#include "android_debug.h"
+
+namespace {
+// A handful of mipmapped RGBA8 textures of the sample's size
+const size_t kDefaultBudget = 32 * 1024 * 1024;
+}  // namespace
+
+TextureCache::TextureCache() : budget_(kDefaultBudget) {
+  stats_.hits = 0;
+  stats_.misses = 0;
+  stats_.evictions = 0;
+  stats_.bytes = 0;
+}
+
+TextureCache::~TextureCache() { Clear(); }
+
+void TextureCache::Touch(ENTRY *entry) {
+  lru_.splice(lru_.begin(), lru_, entry->lru);
+}
+
+Texture *TextureCache::Acquire(std::string &texFile,
+                               AAssetManager *assetManager,
+                               std::string &packName, bool isUnderApk,
+                               TextureLoader *loader,
+                               const std::string &fallbackFile) {
+  KEY key(packName, texFile);
+  std::map<KEY, ENTRY>::iterator it = entries_.find(key);
+  if (it != entries_.end()) {
+    ++stats_.hits;
+    ++it->second.refs;
+    Touch(&it->second);
+    return it->second.texture;
+  }
+
+  ++stats_.misses;
+  Texture *texture =
+      Texture::Create(texFile, assetManager, packName, isUnderApk, loader,
+                      fallbackFile);
+  if (!texture) return nullptr;
+  lru_.push_front(key);
+  ENTRY entry = {texture, 1, lru_.begin()};
+  entries_[key] = entry;
+  // Make room for the newcomer; its size is known once it is uploaded
+  Evict(budget_);
+  return texture;
+}
+
+void TextureCache::Release(Texture *texture) {
+  for (std::map<KEY, ENTRY>::iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    if (it->second.texture != texture) continue;
+    ASSERT(it->second.refs > 0, "Texture released too often");
+    --it->second.refs;
+    Touch(&it->second);
+    Evict(budget_);
+    return;
+  }
+  ASSERT(false, "Texture %p is not in the cache", texture);
+}
+
+/**
+ * Drop textures nobody holds, least recently used first, until the total
+ * size fits. Textures still loading report their size once allocated, so
+ * the total is summed up each time rather than tracked.
+ */
+void TextureCache::Evict(size_t budget) {
+  size_t bytes = 0;
+  for (std::map<KEY, ENTRY>::iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    bytes += it->second.texture->GetSizeInBytes();
+  }
+
+  std::list<KEY>::iterator key = lru_.end();
+  while (bytes > budget && key != lru_.begin()) {
+    --key;
+    std::map<KEY, ENTRY>::iterator it = entries_.find(*key);
+    if (it->second.refs) continue;
+
+    bytes -= it->second.texture->GetSizeInBytes();
+    LOGI("Evicting %s/%s", key->first.c_str(), key->second.c_str());
+    Texture::Delete(it->second.texture);
+    entries_.erase(it);
+    key = lru_.erase(key);
+    ++stats_.evictions;
+  }
+  stats_.bytes = bytes;
+}
+
+void TextureCache::Trim(size_t bytes) {
+  Evict(bytes);
+  LOGI("Trimmed to %zu bytes, %zu textures", stats_.bytes, entries_.size());
+}
+
+void TextureCache::Clear() {
+  for (std::map<KEY, ENTRY>::iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    ASSERT(it->second.refs == 0, "Clearing %s/%s while in use",
+           it->first.first.c_str(), it->first.second.c_str());
+    Texture::Delete(it->second.texture);
+  }
+  entries_.clear();
+  lru_.clear();
+  stats_.bytes = 0;
+}
+
+void TextureCache::SetBudget(size_t bytes) {
+  budget_ = bytes;
+  Evict(budget_);
+}
+
+const TEXTURE_CACHE_STATS &TextureCache::GetStats() {
+  // Refresh the size, textures may have finished loading since
+  stats_.bytes = 0;
+  for (std::map<KEY, ENTRY>::iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    stats_.bytes += it->second.texture->GetSizeInBytes();
+  }
+  return stats_;
+}
+
+float TextureCache::GetHitRate() const {
+  uint32_t total = stats_.hits + stats_.misses;
+  return total ? static_cast<float>(stats_.hits) / total : 0.f;
+}
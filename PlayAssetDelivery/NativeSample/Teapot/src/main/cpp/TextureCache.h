@@ -0,0 +1,93 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TEAPOTS_TEXTURECACHE_H
+#define TEAPOTS_TEXTURECACHE_H
+
+#include <android/asset_manager.h>
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "Texture.h"
+
+struct TEXTURE_CACHE_STATS {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t evictions;
+  size_t bytes;  // GPU memory held by cached textures, in use or not
+};
+
+/**
+ *  class TextureCache
+ *    Keeps textures alive after their last user lets go of them
+ *     - Acquire() returns the cached texture for (pack, asset) or creates it
+ *     - Release() hands it back; it stays resident until evicted
+ *     - textures nobody holds are evicted least recently used first once
+ *       the GPU memory of the cache goes over the budget
+ *     - Trim() evicts on memory pressure, Clear() before the GL context goes
+ *       away
+ *  GL thread only.
+ */
+class TextureCache {
+  typedef std::pair<std::string, std::string> KEY;  // pack, asset
+
+  struct ENTRY {
+    Texture *texture;
+    uint32_t refs;
+    std::list<KEY>::iterator lru;
+  };
+
+  std::map<KEY, ENTRY> entries_;
+  std::list<KEY> lru_;  // most recently used first
+  size_t budget_;
+  TEXTURE_CACHE_STATS stats_;
+
+  void Touch(ENTRY *entry);
+  void Evict(size_t budget);
+
+  TextureCache(const TextureCache &);
+  void operator=(const TextureCache &);
+
+ public:
+  TextureCache();
+  ~TextureCache();
+
+  /**
+   * Get a texture, see Texture::Create() for the parameters. Every call
+   * must be paired with a Release().
+   */
+  Texture *Acquire(std::string &texFile, AAssetManager *assetManager,
+                   std::string &packName, bool isUnderApk,
+                   TextureLoader *loader,
+                   const std::string &fallbackFile = std::string());
+  void Release(Texture *texture);
+
+  // Evict unused textures until the cache holds at most `bytes`
+  void Trim(size_t bytes);
+  // Delete every texture; none may be acquired
+  void Clear();
+
+  void SetBudget(size_t bytes);
+  size_t GetBudget() const { return budget_; }
+  const TEXTURE_CACHE_STATS &GetStats();
+  // Share of Acquire() calls served from the cache, 0 to 1
+  float GetHitRate() const;
+};
+
+#endif //TEAPOTS_TEXTURECACHE_H
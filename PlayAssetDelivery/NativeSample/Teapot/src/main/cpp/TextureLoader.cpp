@@ -0,0 +1,465 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TextureLoader.h"
+
+#include <GLES3/gl3.h>
+#include <third_party/stb/stb_image.h>
+
+#include "GLContext.h"
+#include "PlayAssetDeliveryUtil.h"
+#include "Texture.h"
+#include "trace.h"
+#define MODULE_NAME "Teapot::TextureLoader"
+// Replaces the LOG macros of JNIHelper.h
+#undef LOGI
+#undef LOGW
+#undef LOGE
+#include "android_debug.h"
+
+namespace {
+// Enough for a 512x512 RGBA texture per frame
+const size_t kDefaultUploadBudget = 1024 * 1024;
+const uint32_t kMaxWorkers = 2;
+const uint8_t kPlaceholderColor[4] = {128, 128, 128, 255};
+}  // namespace
+
+//--------------------------------------------------------------------------------
+// ResultQueue
+//--------------------------------------------------------------------------------
+TextureLoader::ResultQueue::ResultQueue() : head_(&stub_), tail_(&stub_) {
+  stub_.next.store(nullptr, std::memory_order_relaxed);
+}
+
+void TextureLoader::ResultQueue::Push(DECODE_RESULT *result) {
+  result->next.store(nullptr, std::memory_order_relaxed);
+  DECODE_RESULT *prev = head_.exchange(result, std::memory_order_acq_rel);
+  prev->next.store(result, std::memory_order_release);
+}
+
+TextureLoader::DECODE_RESULT *TextureLoader::ResultQueue::Pop() {
+  DECODE_RESULT *tail = tail_;
+  DECODE_RESULT *next = tail->next.load(std::memory_order_acquire);
+  if (tail == &stub_) {
+    if (next == nullptr) return nullptr;
+    tail_ = next;
+    tail = next;
+    next = next->next.load(std::memory_order_acquire);
+  }
+  if (next) {
+    tail_ = next;
+    return tail;
+  }
+  if (tail != head_.load(std::memory_order_acquire)) {
+    // A producer swapped head_ but hasn't linked its node yet
+    return nullptr;
+  }
+  // tail is the last element; park the stub behind it so it can be taken
+  Push(&stub_);
+  next = tail->next.load(std::memory_order_acquire);
+  if (next) {
+    tail_ = next;
+    return tail;
+  }
+  return nullptr;
+}
+
+//--------------------------------------------------------------------------------
+// TextureLoader
+//--------------------------------------------------------------------------------
+TextureLoader::TextureLoader()
+    : wake_callback_(nullptr),
+      wake_data_(nullptr),
+      quit_(false),
+      next_id_(1),
+      upload_budget_(kDefaultUploadBudget),
+      placeholder_(0),
+      mipmap_support_(MIPMAP_UNKNOWN) {
+  // Images are stored top row first, GL wants the bottom row first
+  stbi_set_flip_vertically_on_load(1);
+}
+
+TextureLoader::~TextureLoader() {
+  {
+    std::lock_guard<std::mutex> lock(request_mutex_);
+    quit_ = true;
+    requests_.clear();
+  }
+  request_cond_.notify_all();
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    workers_[i].join();
+  }
+
+  while (DECODE_RESULT *result = results_.Pop()) {
+    FreeResult(result);
+  }
+  for (std::map<uint32_t, PENDING_TEXTURE>::iterator it = pending_.begin();
+       it != pending_.end(); ++it) {
+    FreeResult(it->second.result);
+  }
+}
+
+void TextureLoader::WorkerMain() {
+  while (true) {
+    DECODE_REQUEST request;
+    {
+      std::unique_lock<std::mutex> lock(request_mutex_);
+      request_cond_.wait(lock,
+                         [this] { return quit_ || !requests_.empty(); });
+      if (quit_) return;
+      request = requests_.front();
+      requests_.pop_front();
+    }
+
+    NDK_TRACE_SCOPE("TextureLoader::Decode");
+    DECODE_RESULT *result = new DECODE_RESULT;
+    result->id = request.id;
+    result->width = 0;
+    result->height = 0;
+    result->pixels = nullptr;
+
+    ndk_helper::AssetView &view = result->view;
+    bool opened = request.is_under_apk
+                      ? view.OpenAsset(request.asset_manager,
+                                       request.file.c_str())
+                      : !request.file.empty() &&
+                            view.OpenFile(request.file.c_str());
+    if (opened && KtxIsFileName(request.file)) {
+      // Compressed levels are uploaded from the mapping, keep it open
+      if (!ParseKtx(view.Data(), view.Size(), &result->ktx)) {
+        LOGE("%s is not a supported KTX texture", request.file.c_str());
+        result->ktx.levels.clear();
+      }
+    } else if (opened) {
+      int32_t channels;
+      result->pixels =
+          stbi_load_from_memory(view.Data(), view.Size(), &result->width,
+                                &result->height, &channels, 4);
+      view.Close();
+      if (!result->pixels) {
+        LOGE("Unable to decode %s", request.file.c_str());
+      } else if (request.mipmaps) {
+        BuildMipChain(result->pixels, result->width, result->height,
+                      &result->mips);
+      }
+    } else {
+      LOGE("Unable to open %s", request.file.c_str());
+    }
+    results_.Push(result);
+    if (wake_callback_) wake_callback_(wake_data_);
+  }
+}
+
+void TextureLoader::FreeResult(DECODE_RESULT *result) {
+  if (!result) return;
+  if (result->pixels) stbi_image_free(result->pixels);
+  delete result;
+}
+
+const uint8_t *TextureLoader::LevelPixels(const DECODE_RESULT *result,
+                                          int32_t level) {
+  return level == 0 ? result->pixels
+                    : &result->mips.pixels[result->mips.offsets[level - 1]];
+}
+
+void TextureLoader::StartWorkers() {
+  // Leave a core to the render thread
+  uint32_t cores = std::thread::hardware_concurrency();
+  uint32_t count = cores > 1 ? cores - 1 : 1;
+  if (count > kMaxWorkers) count = kMaxWorkers;
+  for (uint32_t i = 0; i < count; ++i) {
+    workers_.push_back(std::thread(&TextureLoader::WorkerMain, this));
+  }
+}
+
+uint32_t TextureLoader::Request(GLuint texId, std::string &texFile,
+                                AAssetManager *assetManager,
+                                std::string &packName, bool isUnderApk,
+                                size_t *bytes,
+                                const std::string &fallbackFile) {
+  // Threads are started on first use, not while static objects are built
+  if (workers_.empty()) StartWorkers();
+  if (mipmap_support_ == MIPMAP_UNKNOWN) {
+    ndk_helper::GLContext *context = ndk_helper::GLContext::GetInstance();
+    if (context->GetGLVersion() >= 3.0f) {
+      mipmap_support_ = MIPMAP_STREAMING;
+    } else if (context->CheckExtension("GL_OES_texture_npot")) {
+      mipmap_support_ = MIPMAP_FULL;
+    } else {
+      mipmap_support_ = MIPMAP_NONE;
+    }
+  }
+
+  DECODE_REQUEST request;
+  request.id = next_id_++;
+  if (next_id_ == 0) next_id_ = 1;
+  request.asset_manager = assetManager;
+  request.is_under_apk = isUnderApk;
+  request.mipmaps = mipmap_support_ != MIPMAP_NONE;
+  // The pack location is looked up here, workers only touch the file system
+  request.file =
+      isUnderApk ? texFile : GetAssetPackFilePath(packName, texFile);
+
+  // The fallback takes over the request, id included
+  PENDING_TEXTURE pending = {texId, nullptr, 0, 0, false, bytes, request};
+  std::string fallback(fallbackFile);
+  pending.fallback.file = fallback.empty() || isUnderApk
+                              ? fallback
+                              : GetAssetPackFilePath(packName, fallback);
+  pending_[request.id] = pending;
+  Queue(request);
+  return request.id;
+}
+
+void TextureLoader::Queue(const DECODE_REQUEST &request) {
+  {
+    std::lock_guard<std::mutex> lock(request_mutex_);
+    requests_.push_back(request);
+  }
+  request_cond_.notify_one();
+}
+
+void TextureLoader::Cancel(uint32_t requestId) {
+  std::map<uint32_t, PENDING_TEXTURE>::iterator it = pending_.find(requestId);
+  if (it == pending_.end()) return;
+  // A decode still in flight is dropped by Update() when it comes back
+  FreeResult(it->second.result);
+  pending_.erase(it);
+}
+
+bool TextureLoader::IsPending(uint32_t requestId) const {
+  std::map<uint32_t, PENDING_TEXTURE>::const_iterator it =
+      pending_.find(requestId);
+  return it != pending_.end() && !it->second.visible;
+}
+
+bool TextureLoader::IsUploading() const {
+  for (std::map<uint32_t, PENDING_TEXTURE>::const_iterator it =
+           pending_.begin();
+       it != pending_.end(); ++it) {
+    if (it->second.result) return true;
+  }
+  return false;
+}
+
+void TextureLoader::Update() {
+  NDK_TRACE_SCOPE("TextureLoader::Update");
+  while (DECODE_RESULT *result = results_.Pop()) {
+    std::map<uint32_t, PENDING_TEXTURE>::iterator it =
+        pending_.find(result->id);
+    if (it == pending_.end()) {
+      // Cancelled while decoding
+      FreeResult(result);
+      continue;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, it->second.tex_id);
+    const uint32_t format = result->ktx.internal_format;
+    bool compressed = !result->ktx.levels.empty();
+    if (compressed && !Texture::IsFormatSupported(format)) {
+      LOGE("Texture format 0x%x is not supported by the GPU", format);
+      compressed = false;
+    }
+    if (!result->pixels && !compressed &&
+        !it->second.fallback.file.empty()) {
+      // A pack built before its .ktx files, say; the image is still there
+      LOGW("Decoding %s instead", it->second.fallback.file.c_str());
+      Queue(it->second.fallback);
+      it->second.fallback.file.clear();
+      FreeResult(result);
+      continue;
+    }
+    if (!result->pixels && !compressed) {
+      // Keep showing something sensible for a broken file
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, kPlaceholderColor);
+      if (it->second.bytes) *it->second.bytes = sizeof(kPlaceholderColor);
+      FreeResult(result);
+      pending_.erase(it);
+      continue;
+    }
+    it->second.result = result;
+    AllocateLevels(&it->second);
+  }
+
+  // Requests are numbered in order, so the map iterates first come first
+  // served
+  size_t budget = upload_budget_;
+  std::map<uint32_t, PENDING_TEXTURE>::iterator it = pending_.begin();
+  while (it != pending_.end()) {
+    if (!it->second.result) {
+      ++it;
+      continue;
+    }
+    bool complete = it->second.result->pixels
+                        ? UploadRows(&it->second, &budget)
+                        : UploadCompressedLevels(&it->second, &budget);
+    if (!complete) break;
+    FreeResult(it->second.result);
+    it = pending_.erase(it);
+  }
+}
+
+/**
+ * Allocate storage for every level now, they are filled band by band by
+ * UploadRows(), starting with the smallest level. Compressed levels can't
+ * be allocated empty on OpenGL ES 2, UploadCompressedLevels() defines each
+ * one whole instead.
+ */
+void TextureLoader::AllocateLevels(PENDING_TEXTURE *texture) {
+  const DECODE_RESULT *result = texture->result;
+  if (!result->pixels) {
+    const KTX_TEXTURE &ktx = result->ktx;
+    int32_t levels = static_cast<int32_t>(ktx.levels.size());
+    // ES 2 can't mipmap NPOT textures, nor stop the chain short of 1x1
+    if (mipmap_support_ == MIPMAP_NONE ||
+        (mipmap_support_ == MIPMAP_FULL &&
+         levels != MipLevelCount(ktx.width, ktx.height))) {
+      levels = 1;
+    }
+    if (levels > 1) {
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                      GL_LINEAR_MIPMAP_LINEAR);
+      if (mipmap_support_ == MIPMAP_STREAMING) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+      }
+    }
+    texture->level = levels - 1;
+    texture->next_row = 0;
+    if (texture->bytes) {
+      *texture->bytes = 0;
+      for (int32_t level = 0; level < levels; ++level) {
+        *texture->bytes += ktx.levels[level].size;
+      }
+    }
+    return;
+  }
+
+  const int32_t levels = 1 + result->mips.offsets.size();
+  for (int32_t level = 0; level < levels; ++level) {
+    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA,
+                 MipLevelSize(result->width, level),
+                 MipLevelSize(result->height, level), 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, nullptr);
+  }
+  if (levels > 1) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+  }
+  texture->level = levels - 1;
+  texture->next_row = 0;
+  if (texture->bytes) {
+    *texture->bytes =
+        static_cast<size_t>(result->width) * result->height * 4 +
+        result->mips.pixels.size();
+  }
+}
+
+/**
+ * Upload as many rows as the budget allows, level after level. The first
+ * upload of a frame always sends at least one row so wide images can't
+ * stall forever. Returns true when the texture is complete.
+ */
+bool TextureLoader::UploadRows(PENDING_TEXTURE *texture, size_t *budget) {
+  const DECODE_RESULT *result = texture->result;
+  glBindTexture(GL_TEXTURE_2D, texture->tex_id);
+  while (texture->level >= 0) {
+    const int32_t level = texture->level;
+    const int32_t width = MipLevelSize(result->width, level);
+    const int32_t height = MipLevelSize(result->height, level);
+    const size_t row_bytes = width * 4;
+    size_t rows = *budget / row_bytes;
+    if (rows == 0 && *budget == upload_budget_) rows = 1;
+    if (rows == 0) return false;
+
+    int32_t remaining = height - texture->next_row;
+    if (rows > static_cast<size_t>(remaining)) rows = remaining;
+
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, texture->next_row, width, rows,
+                    GL_RGBA, GL_UNSIGNED_BYTE,
+                    LevelPixels(result, level) + texture->next_row * row_bytes);
+    texture->next_row += rows;
+    *budget = rows * row_bytes < *budget ? *budget - rows * row_bytes : 0;
+    if (texture->next_row < height) continue;
+
+    LevelComplete(texture);
+  }
+  texture->visible = true;
+  return true;
+}
+
+/**
+ * Define whole compressed levels, smallest first, as long as the budget
+ * allows. Like UploadRows(), the first upload of a frame always goes out.
+ * Returns true when the texture is complete.
+ */
+bool TextureLoader::UploadCompressedLevels(PENDING_TEXTURE *texture,
+                                           size_t *budget) {
+  const KTX_TEXTURE &ktx = texture->result->ktx;
+  glBindTexture(GL_TEXTURE_2D, texture->tex_id);
+  while (texture->level >= 0) {
+    const int32_t level = texture->level;
+    const KTX_TEXTURE::LEVEL &data = ktx.levels[level];
+    if (data.size > *budget && *budget != upload_budget_) return false;
+
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, ktx.internal_format,
+                           MipLevelSize(ktx.width, level),
+                           MipLevelSize(ktx.height, level), 0, data.size,
+                           data.data);
+    *budget = data.size < *budget ? *budget - data.size : 0;
+    LevelComplete(texture);
+  }
+  texture->visible = true;
+  return true;
+}
+
+/**
+ * The level being uploaded is in, move on to the next larger one
+ */
+void TextureLoader::LevelComplete(PENDING_TEXTURE *texture) {
+  // Let the GPU sample it and the smaller ones
+  if (mipmap_support_ == MIPMAP_STREAMING) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture->level);
+    texture->visible = true;
+  }
+  --texture->level;
+  texture->next_row = 0;
+}
+
+void TextureLoader::Unload() {
+  for (std::map<uint32_t, PENDING_TEXTURE>::iterator it = pending_.begin();
+       it != pending_.end(); ++it) {
+    FreeResult(it->second.result);
+  }
+  pending_.clear();
+
+  if (placeholder_) {
+    glDeleteTextures(1, &placeholder_);
+    placeholder_ = 0;
+  }
+}
+
+GLuint TextureLoader::GetPlaceholder() {
+  if (!placeholder_) {
+    glGenTextures(1, &placeholder_);
+    glBindTexture(GL_TEXTURE_2D, placeholder_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, kPlaceholderColor);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  }
+  return placeholder_;
+}
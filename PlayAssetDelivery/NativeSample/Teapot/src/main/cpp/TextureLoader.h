@@ -0,0 +1,196 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TEAPOTS_TEXTURELOADER_H
+#define TEAPOTS_TEXTURELOADER_H
+
+#include <GLES2/gl2.h>
+#include <android/asset_manager.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "KtxFormat.h"
+#include "MipChain.h"
+#include "assetView.h"
+
+/**
+ *  class TextureLoader
+ *    Decodes textures off the render thread
+ *     - Request() queues a decode for a GL texture name and returns at once
+ *     - worker threads decode the image, build its mip chain and hand the
+ *       pixels back through a lock-free queue. .ktx/.ktx2 files are only
+ *       parsed, their levels stay in the mapped file
+ *     - Update(), called once per frame on the GL thread, uploads finished
+ *       images with glTexSubImage2D() in row bands and compressed ones with
+ *       glCompressedTexImage2D() a level at a time, at most the upload
+ *       budget worth of bytes per frame
+ *     - mip levels go up smallest first. On OpenGL ES 3 GL_TEXTURE_BASE_LEVEL
+ *       follows the finest complete level, so a blurry texture shows up
+ *       within a frame and sharpens as the larger levels arrive
+ *     - until a texture can be shown, GetPlaceholder() is bound in its place
+ *  All methods except the workers themselves are for the GL thread only.
+ */
+class TextureLoader {
+ public:
+  typedef void (*WakeCallback)(void *data);
+
+ private:
+  struct DECODE_REQUEST {
+    uint32_t id;
+    std::string file;  // asset name inside the APK, or a file path for packs
+    AAssetManager *asset_manager;
+    bool is_under_apk;
+    bool mipmaps;
+  };
+
+  // Decoded image, travels from a worker to the GL thread
+  struct DECODE_RESULT {
+    std::atomic<DECODE_RESULT *> next;
+    uint32_t id;
+    int32_t width;
+    int32_t height;
+    uint8_t *pixels;  // RGBA8, stbi allocated, nullptr on failure
+    MIP_CHAIN mips;   // empty without mipmaps
+    // Compressed levels pointing into view, empty unless a KTX file parsed
+    KTX_TEXTURE ktx;
+    ndk_helper::AssetView view;
+  };
+
+  // Upload in progress on the GL thread
+  struct PENDING_TEXTURE {
+    GLuint tex_id;
+    DECODE_RESULT *result;
+    int32_t level;  // level being uploaded, counts down to 0
+    int32_t next_row;  // decoded images only, compressed levels go whole
+    bool visible;   // a complete level can be sampled
+    size_t *bytes;  // receives the size of the storage, may be nullptr
+    // Decoded instead if a KTX file fails, file is empty if there is none
+    DECODE_REQUEST fallback;
+  };
+
+  enum MIPMAP_SUPPORT {
+    MIPMAP_UNKNOWN,
+    MIPMAP_NONE,       // level 0 only, ES 2 can't mipmap NPOT textures
+    MIPMAP_FULL,       // shown once every level is uploaded
+    MIPMAP_STREAMING,  // shown from the smallest level on, ES 3
+  };
+
+  /**
+   * Multiple producer, single consumer intrusive queue (D. Vyukov).
+   * Push() is wait-free, Pop() is lock-free and may only be called by the
+   * consumer. Pop() returns nullptr while a push is half way through; the
+   * element shows up on a later call.
+   */
+  class ResultQueue {
+    std::atomic<DECODE_RESULT *> head_;
+    DECODE_RESULT *tail_;
+    DECODE_RESULT stub_;
+
+   public:
+    ResultQueue();
+    void Push(DECODE_RESULT *result);
+    DECODE_RESULT *Pop();
+  };
+
+  WakeCallback wake_callback_;
+  void *wake_data_;
+
+  std::vector<std::thread> workers_;
+  std::mutex request_mutex_;
+  std::condition_variable request_cond_;
+  std::deque<DECODE_REQUEST> requests_;
+  bool quit_;
+
+  ResultQueue results_;
+
+  // GL thread state
+  std::map<uint32_t, PENDING_TEXTURE> pending_;
+  uint32_t next_id_;
+  size_t upload_budget_;
+  GLuint placeholder_;
+  MIPMAP_SUPPORT mipmap_support_;
+
+  void StartWorkers();
+  void Queue(const DECODE_REQUEST &request);
+  void WorkerMain();
+  static void FreeResult(DECODE_RESULT *result);
+  static const uint8_t *LevelPixels(const DECODE_RESULT *result,
+                                    int32_t level);
+  void AllocateLevels(PENDING_TEXTURE *texture);
+  bool UploadRows(PENDING_TEXTURE *texture, size_t *budget);
+  bool UploadCompressedLevels(PENDING_TEXTURE *texture, size_t *budget);
+  void LevelComplete(PENDING_TEXTURE *texture);
+
+  TextureLoader(const TextureLoader &);
+  void operator=(const TextureLoader &);
+
+ public:
+  TextureLoader();
+  ~TextureLoader();
+
+  /**
+   * Queue a texture decode
+   * @param texId GL texture name that receives the image, owned by the caller
+   * @param texFile holds the texture file name under the pack's assets folder
+   * @param assetManager is used to open texture files inside the APK
+   * @param packName holds the asset pack name
+   * @param isUnderApk is used to determine the method for open the file
+   * @param bytes receives the GPU memory used by the texture once the image
+   *        is decoded and its storage allocated; must outlive the request
+   * @param fallbackFile image in the same pack decoded instead when texFile
+   *        is a KTX file that can't be opened, parsed or sampled; may be
+   *        empty
+   * @return request id for IsPending() and Cancel(), never 0
+   */
+  uint32_t Request(GLuint texId, std::string &texFile,
+                   AAssetManager *assetManager, std::string &packName,
+                   bool isUnderApk, size_t *bytes = nullptr,
+                   const std::string &fallbackFile = std::string());
+  // Forget a request, e.g. because its texture is being deleted
+  void Cancel(uint32_t requestId);
+  // True until some level of the texture can be sampled
+  bool IsPending(uint32_t requestId) const;
+
+  // Upload decoded textures, once per frame
+  void Update();
+  // True while Update() has rows left to upload
+  bool IsUploading() const;
+  /**
+   * Called on a worker thread each time a decode is ready for Update(), so
+   * a GL thread that stopped drawing can start again. Set it before the
+   * first Request(), the workers read it without a lock.
+   */
+  void SetWakeCallback(WakeCallback callback, void *data) {
+    wake_callback_ = callback;
+    wake_data_ = data;
+  }
+  // Release GL objects and drop pending uploads before the context goes away
+  void Unload();
+
+  // Bytes uploaded per Update(), at least one row or compressed level
+  void SetUploadBudget(size_t bytesPerFrame) { upload_budget_ = bytesPerFrame; }
+  // 1x1 mid gray texture shown while the real one loads
+  GLuint GetPlaceholder();
+};
+
+#endif //TEAPOTS_TEXTURELOADER_H
@@ -15,21 +15,7 @@
  */
 
 #include "TexturedTeapotRender.h"
-
-/**
- * Texture Coordinators for 2D texture:
- *    they are declared in file model file teapot.inl with tiles
- *    for front and back teapot faces. If you do not want see
- *    the tiles but would like to see the stretched version, simply
- *    divide the texCoord by 2. Macro TILED_TEXTURE is for this purpose.
- *
- * teapot.inl file already included in TeapotRenderer.cpp, we directly
- * use! -- nice
- */
-#define TILED_TEXTURE 0
-
-extern float teapotTexCoords[];
-constexpr int32_t kCoordElementCount = (TILED_TEXTURE ? 3 : 2);
+#include "KtxFormat.h"
 
 /**
  * Constructor: all work is done inside Init() function.
@@ -58,6 +44,7 @@ TexturedTeapotRender::TexturedTeapotRender()
  */
 TexturedTeapotRender::~TexturedTeapotRender() {
   Unload();
+  UnloadTextures();
 };
 
 /**
@@ -69,42 +56,38 @@ TexturedTeapotRender::~TexturedTeapotRender() {
  */
 
 void TexturedTeapotRender::Init(android_app *app) {
-  // initialize the basic things from TeapotRenderer, no change
-  TeapotRenderer::Init();
+  // initialize the basic things from TeapotRenderer, no change.
+  // Texture coordinates are part of the teapot mesh, so there is no
+  // separate buffer to set up here.
   app_ = app;
+  TeapotRenderer::Init();
 
-  // do Texture related initializations...
-  glGenBuffers(1, &texVbo_);
-  assert(texVbo_ != GL_INVALID_VALUE);
-
-  /*
-   * Loading Texture coord directly from data declared in model file
-   *   teapot.inl
-   * which is 3 floats/vertex.
-   */
-  glBindBuffer(GL_ARRAY_BUFFER, texVbo_);
-
-#if (TILED_TEXTURE)
-  glBufferData(GL_ARRAY_BUFFER,
-           kCoordElementCount * sizeof(float) * num_vertices_,
-           teapotTexCoords, GL_STATIC_DRAW);
-#else
-  std::vector<float> coords;
-  for (int32_t idx = 0; idx < num_vertices_; idx++) {
-    coords.push_back(teapotTexCoords[3 * idx] / 2);
-    coords.push_back(teapotTexCoords[3 * idx + 1] / 2);
-  }
-  glBufferData(GL_ARRAY_BUFFER,
-               kCoordElementCount * sizeof(float) * num_vertices_,
-               coords.data(), GL_STATIC_DRAW);
-#endif
-  glVertexAttribPointer(ATTRIB_UV, 2, GL_FLOAT, GL_FALSE,
-                        kCoordElementCount * sizeof(float),
-                        BUFFER_OFFSET(0));
-  glEnableVertexAttribArray(ATTRIB_UV);
+  LoadTexture();
+  texObj_->Activate();
+}
 
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+/**
+ * OnShaderReady: the textured program replaced the fallback, point its
+ * samplers at the texture units. Their locations come with the cached
+ * program like the other uniforms.
+ */
+void TexturedTeapotRender::OnShaderReady(
+    const ndk_helper::PROGRAM_REFLECTION &reflection) {
+  std::vector<std::string> samplers;
+  std::vector<GLint> units;
+  texObj_->GetActiveSamplerInfo(samplers, units);
+  ndk_helper::GLStateCache *cache = ndk_helper::GLStateCache::GetInstance();
+  for (size_t idx = 0; idx < samplers.size(); idx++) {
+    GLint sampler = reflection.GetUniform(samplers[idx].c_str());
+    cache->Uniform1i(sampler, units[idx]);
+  }
+}
 
+/**
+ * LoadTexture: pick the next texture of the current pack and get it from
+ * the cache. Returns false when it is the texture already in use.
+ */
+bool TexturedTeapotRender::LoadTexture() {
   int index = textureIndex;
   bool isUnderApk = true;
   if (renderPack.compare("on_demand_pack") == 0) {
@@ -115,53 +98,110 @@ void TexturedTeapotRender::Init(android_app *app) {
     isUnderApk = false;
   }
   renderTextures[0] = renderTextures[index];
+  // Every pack also carries an ETC2 copy of its textures made by
+  // tools/texture_converter; use it when the GPU can sample it directly,
+  // and the image if the copy turns out to be missing or broken.
+  std::string fallback;
+  if (Texture::IsFormatSupported(KTX_FORMAT_ETC2_RGB8)) {
+    fallback = renderTextures[0];
+    size_t dot = renderTextures[0].rfind('.');
+    renderTextures[0] = renderTextures[0].substr(0, dot) + ".ktx";
+  }
   textureIndex++;
   if (textureIndex > maxIndex) {
     textureIndex = 1;
   }
-  renderInfo = "Texture::" + renderPack + "/" + renderTextures[0];
-  texObj_ =
-      Texture::Create(renderTextures[0], app_->activity->assetManager, renderPack, isUnderApk);
+  std::string info = "Texture::" + renderPack + "/" + renderTextures[0];
+  if (texObj_ && info == renderInfo) return false;
+
+  renderInfo = info;
+  Texture *previous = texObj_;
+  texObj_ = textureCache_.Acquire(renderTextures[0],
+                                  app_->activity->assetManager, renderPack,
+                                  isUnderApk, &textureLoader_, fallback);
   assert(texObj_);
+  // Released after the new one is in, a shared texture is never evicted
+  if (previous) textureCache_.Release(previous);
+  const TEXTURE_CACHE_STATS &stats = textureCache_.GetStats();
+  LOGI("Texture cache: %u hits, %u misses (%.0f%%), %u evictions, %zu bytes",
+       stats.hits, stats.misses, textureCache_.GetHitRate() * 100.f,
+       stats.evictions, stats.bytes);
+  NDK_TRACE_COUNTER("TextureCache bytes", stats.bytes);
+  return true;
+}
 
-  std::vector<std::string> samplers;
-  std::vector<GLint> units;
-  texObj_->GetActiveSamplerInfo(samplers, units);
-  for (size_t idx = 0; idx < samplers.size(); idx++) {
-    GLint sampler = glGetUniformLocation(shader_param_.program_,
-                                         samplers[idx].c_str());
-    glUniform1i(sampler, units[idx]);
-  }
+void TexturedTeapotRender::SetPerfMonitor(ndk_helper::PerfMonitor *monitor) {
+  monitor_ = monitor;
+  swapMetric_ = -1;
+  swapShownMetric_ = -1;
+  if (!monitor) return;
+  swapMetric_ = monitor->AddMetric("Texture swap");
+  swapShownMetric_ = monitor->AddMetric("Texture swap to screen");
+}
 
+/**
+ * SwapTexture: the shader, the mesh buffers and the sampler setup stay, only
+ * the texture binding changes
+ */
+void TexturedTeapotRender::SwapTexture() {
+  int64_t start = ndk_helper::PerfMonitor::GetCurrentTimeNs();
+  if (!LoadTexture()) return;
   texObj_->Activate();
+  if (swapMetric_ >= 0) {
+    monitor_->RecordMetric(
+        swapMetric_, ndk_helper::PerfMonitor::GetCurrentTimeNs() - start);
+  }
+  swapStartNs_ = start;
 }
 
 /**
  * Render() function:
  *   enable states for rendering and reader a frame.
- *   For Texture, simply inform GL to stream texture coord from _texVbo
+ *   Texture coord are streamed from the mesh VBO with the other attributes
+ *   Decoded textures are uploaded within the loader's per frame budget first;
+ *   until ours is complete the placeholder gets bound.
  */
-void TexturedTeapotRender::Render() {
-  TeapotRenderer::Render();
+void TexturedTeapotRender::Render(const FRAME_SNAPSHOT &frame) {
+  textureLoader_.Update();
+  texObj_->Activate();
+  if (swapStartNs_ != 0 && !texObj_->IsLoading()) {
+    if (swapShownMetric_ >= 0) {
+      monitor_->RecordMetric(
+          swapShownMetric_,
+          ndk_helper::PerfMonitor::GetCurrentTimeNs() - swapStartNs_);
+    }
+    swapStartNs_ = 0;
+  }
+  TeapotRenderer::Render(frame);
   UpdateButton();
 }
 
 /**
  * Unload()
  *    clean-up function. May get called from destructor too
+ *    The texture goes back to the cache, UnloadTextures() deletes it
  */
 void TexturedTeapotRender::Unload() {
   TeapotRenderer::Unload();
-  if (texVbo_ != GL_INVALID_VALUE) {
-    glDeleteBuffers(1, &texVbo_);
-    texVbo_ = GL_INVALID_VALUE;
-  }
   if (texObj_) {
-    Texture::Delete(texObj_);
+    textureCache_.Release(texObj_);
     texObj_ = nullptr;
   }
 }
 
+bool TexturedTeapotRender::IsAnimating() const {
+  return TeapotRenderer::IsAnimating() || textureLoader_.IsUploading();
+}
+
+void TexturedTeapotRender::UnloadTextures() {
+  textureCache_.Clear();
+  textureLoader_.Unload();
+}
+
+void TexturedTeapotRender::TrimMemory() {
+  textureCache_.Trim(0);
+}
+
 std::string TexturedTeapotRender::GetRenderInfo() {
   return renderInfo;
 }
@@ -18,34 +18,76 @@
 #define TEAPOTS_TEXTUREDTEAPOTRENDER_H
 #include "TeapotRenderer.h"
 #include "Texture.h"
+#include "TextureCache.h"
 #include "PlayAssetDeliveryUtil.h"
 
 /**
  *  class TextureTeapotRender
  *    adding texture into teapot
- *     - create texture buffer and load image in assets/Textures
+ *     - texture coordinates come interleaved in the teapot mesh
+ *     - load image in assets/Textures, decoded in the background by
+ *       TextureLoader while a placeholder is shown
+ *     - textures stay in a TextureCache across Unload()/Init(), so cycling
+ *       back to a recent one skips the decode and upload
+ *     - SwapTexture() moves on to the next texture without touching the
+ *       shaders and buffers
  *     - enable texture units
  *     - enable texturing inside shaders
  */
 class TexturedTeapotRender : public TeapotRenderer {
-  GLuint texVbo_ = GL_INVALID_VALUE;
   Texture *texObj_ = nullptr;
+  TextureLoader textureLoader_;
+  // Declared after the loader, cached textures cancel their requests on it
+  TextureCache textureCache_;
   int textureIndex;
   int maxIndex;
   std::string renderPack;
   std::string renderInfo;
   std::vector<std::string> renderTextures;
+  // Metrics of SetPerfMonitor(), -1 without a monitor
+  ndk_helper::PerfMonitor *monitor_ = nullptr;
+  int32_t swapMetric_ = -1;
+  int32_t swapShownMetric_ = -1;
+  // SwapTexture() start time until the new texture can be shown, 0 if none
+  int64_t swapStartNs_ = 0;
  public:
   TexturedTeapotRender();
   virtual ~TexturedTeapotRender();
 
   virtual void Init(android_app *app);
-  virtual void Render();
+  virtual void Render(const FRAME_SNAPSHOT &frame);
   virtual void Unload();
   virtual std::string GetRenderInfo();
+  // Also while decoded textures are uploaded over several frames
+  virtual bool IsAnimating() const;
+  // See TextureLoader::SetWakeCallback(), before Init()
+  void SetWakeCallback(TextureLoader::WakeCallback callback, void *data) {
+    textureLoader_.SetWakeCallback(callback, data);
+  }
+
+  /**
+   * Record the SwapTexture() times as metrics of monitor, so that they are
+   * dumped with the frame statistics over every swap. After Init().
+   */
+  void SetPerfMonitor(ndk_helper::PerfMonitor *monitor);
+  /**
+   * Replace the texture with the next one of the current pack, keeping
+   * everything else. Records the time of the swap and, on a later frame,
+   * the time until the new texture is on screen.
+   */
+  void SwapTexture();
+  // Delete cached textures, before the GL context is destroyed
+  void UnloadTextures();
+  // Evict every texture not on screen, on memory pressure
+  void TrimMemory();
+
+ protected:
+  virtual void OnShaderReady(
+      const ndk_helper::PROGRAM_REFLECTION &reflection);
 
  private:
   void UpdateButton();
+  bool LoadTexture();
 };
 
 #endif //TEAPOTS_TEXTUREDTEAPOTRENDER_H
@@ -157,42 +157,51 @@ public class TeapotNativeActivity extends NativeActivity {
         return returnCode;
     }
 
-    int buttonCode = 0;
+    // Read by the native loop, which may be blocked until onUiCommand()
+    volatile int buttonCode = 0;
+
+    // Wakes the native loop, it draws nothing while the scene is static
+    private native void onUiCommand();
+
+    private void setButtonCode(int code) {
+        buttonCode = code;
+        onUiCommand();
+    }
 
     public void onClickPack1Btn(View v) {
-        buttonCode = 1;
+        setButtonCode(1);
     }
 
     public void onClickPack2Btn(View v) {
-        buttonCode = 2;
+        setButtonCode(2);
     }
 
     public void onClickPack3Btn(View v) {
-        buttonCode = 3;
+        setButtonCode(3);
     }
 
     public void onClickRequestInfoBtn(View v) {
-        buttonCode = 4;
+        setButtonCode(4);
     }
 
     public void onClickRequestBtn(View v) {
-        buttonCode = 5;
+        setButtonCode(5);
     }
 
     public void onClickPauseBtn(View v) {
-        buttonCode = 6;
+        setButtonCode(6);
     }
 
     public void onClickResumeBtn(View v) {
-        buttonCode = 7;
+        setButtonCode(7);
     }
 
     public void onClickPrintLocationBtn(View v) {
-        buttonCode = 8;
+        setButtonCode(8);
     }
 
     public void onClickShowCellularBtn(View v) {
-        buttonCode = 9;
+        setButtonCode(9);
     }
 }
 
@@ -45,7 +45,8 @@ GLContext::GLContext()
       screen_height_(0),
       gles_initialized_(false),
       egl_context_initialized_(false),
-      es3_supported_(false) {}
+      es3_supported_(false),
+      presentation_time_(NULL) {}
 
 void GLContext::InitGLES() {
   if (gles_initialized_) return;
@@ -88,6 +89,13 @@ bool GLContext::InitEGLSurface() {
   display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
   eglInitialize(display_, 0, 0);
 
+  const char* extensions = eglQueryString(display_, EGL_EXTENSIONS);
+  presentation_time_ = NULL;
+  if (extensions && strstr(extensions, "EGL_ANDROID_presentation_time")) {
+    presentation_time_ = reinterpret_cast<PresentationTimeProc>(
+        eglGetProcAddress("eglPresentationTimeANDROID"));
+  }
+
   /*
    * Here specify the attributes of the desired configuration.
    * Below, we select an EGLConfig with at least 8 bits per color
@@ -158,6 +166,51 @@ bool GLContext::InitEGLContext() {
   return true;
 }
 
+bool GLContext::CreateSharedContext(EGLContext* context, EGLSurface* surface) {
+  *context = EGL_NO_CONTEXT;
+  *surface = EGL_NO_SURFACE;
+  if (display_ == EGL_NO_DISPLAY || context_ == EGL_NO_CONTEXT) return false;
+
+  const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+  *context = eglCreateContext(display_, config_, context_, context_attribs);
+  if (*context == EGL_NO_CONTEXT) {
+    LOGW("Unable to create a shared context %d", eglGetError());
+    return false;
+  }
+
+  const char* extensions = eglQueryString(display_, EGL_EXTENSIONS);
+  if (extensions && strstr(extensions, "EGL_KHR_surfaceless_context")) {
+    return true;
+  }
+
+  const EGLint pbuffer_config_attribs[] = {EGL_RENDERABLE_TYPE,
+                                           EGL_OPENGL_ES2_BIT,
+                                           EGL_SURFACE_TYPE,
+                                           EGL_PBUFFER_BIT,
+                                           EGL_NONE};
+  const EGLint pbuffer_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+  EGLConfig config;
+  EGLint num_configs = 0;
+  if (eglChooseConfig(display_, pbuffer_config_attribs, &config, 1,
+                      &num_configs) &&
+      num_configs) {
+    *surface = eglCreatePbufferSurface(display_, config, pbuffer_attribs);
+  }
+  if (*surface == EGL_NO_SURFACE) {
+    LOGW("Unable to create a pbuffer for the shared context");
+    eglDestroyContext(display_, *context);
+    *context = EGL_NO_CONTEXT;
+    return false;
+  }
+  return true;
+}
+
+void GLContext::DestroySharedContext(EGLContext context, EGLSurface surface) {
+  if (display_ == EGL_NO_DISPLAY) return;
+  if (surface != EGL_NO_SURFACE) eglDestroySurface(display_, surface);
+  if (context != EGL_NO_CONTEXT) eglDestroyContext(display_, context);
+}
+
 EGLint GLContext::Swap() {
   bool b = eglSwapBuffers(display_, surface_);
   if (!b) {
@@ -177,6 +230,11 @@ EGLint GLContext::Swap() {
   return EGL_SUCCESS;
 }
 
+bool GLContext::SetPresentationTime(int64_t present_ns) {
+  if (!presentation_time_ || surface_ == EGL_NO_SURFACE) return false;
+  return presentation_time_(display_, surface_, present_ns) == EGL_TRUE;
+}
+
 void GLContext::Terminate() {
   if (display_ != EGL_NO_DISPLAY) {
     eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
@@ -72,6 +72,10 @@ class GLContext {
   float gl_version_;
   bool context_valid_;
 
+  // EGL_ANDROID_presentation_time, NULL without it
+  typedef EGLBoolean (*PresentationTimeProc)(EGLDisplay, EGLSurface, int64_t);
+  PresentationTimeProc presentation_time_;
+
   void InitGLES();
   void Terminate();
   bool InitEGLSurface();
@@ -92,6 +96,12 @@ class GLContext {
 
   bool Init(ANativeWindow* window);
   EGLint Swap();
+  /*
+   * Desired present time of the next Swap(), CLOCK_MONOTONIC ns. The
+   * compositor holds the frame until then. Returns false without
+   * EGL_ANDROID_presentation_time.
+   */
+  bool SetPresentationTime(int64_t present_ns);
   bool Invalidate();
 
   void Suspend();
@@ -108,6 +118,16 @@ class GLContext {
 
   EGLDisplay GetDisplay() const { return display_; }
   EGLSurface GetSurface() const { return surface_; }
+  EGLContext GetContext() const { return context_; }
+
+  /*
+   * Context sharing objects with the main one, for worker threads. The
+   * surface is EGL_NO_SURFACE with EGL_KHR_surfaceless_context, a 1x1
+   * pbuffer otherwise. The worker makes them current itself; both must be
+   * destroyed before the main context is torn down.
+   */
+  bool CreateSharedContext(EGLContext* context, EGLSurface* surface);
+  void DestroySharedContext(EGLContext context, EGLSurface surface);
 };
 
 }  // namespace ndkHelper
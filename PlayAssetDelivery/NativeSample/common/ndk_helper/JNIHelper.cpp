@@ -130,8 +130,7 @@ void JNIHelper::Init(ANativeActivity* activity, const char* helper_class_name,
 //---------------------------------------------------------------------------
 // readFile
 //---------------------------------------------------------------------------
-bool JNIHelper::ReadFile(const char* fileName,
-                         std::vector<uint8_t>* buffer_ref) {
+bool JNIHelper::OpenFile(const char* fileName, AssetView* view) {
   if (activity_ == NULL) {
     LOGI(
         "JNIHelper has not been initialized.Call init() to initialize the "
@@ -139,59 +138,49 @@ bool JNIHelper::ReadFile(const char* fileName,
     return false;
   }
 
-  // Lock mutex
-  std::lock_guard<std::mutex> lock(mutex_);
-
-  // First, try reading from externalFileDir;
-  JNIEnv* env = AttachCurrentThread();
-  jstring str_path = GetExternalFilesDirJString(env);
-
+  // First, try mapping from externalFileDir;
   std::string s;
-  if(str_path) {
-    const char* path = env->GetStringUTFChars(str_path, NULL);
-    s = std::string(path);
-    if (fileName[0] != '/') {
-      s.append("/");
+  {
+    // Lock mutex
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    JNIEnv* env = AttachCurrentThread();
+    jstring str_path = GetExternalFilesDirJString(env);
+    if (str_path) {
+      const char* path = env->GetStringUTFChars(str_path, NULL);
+      s = std::string(path);
+      if (fileName[0] != '/') {
+        s.append("/");
+      }
+      s.append(fileName);
+      env->ReleaseStringUTFChars(str_path, path);
+      env->DeleteLocalRef(str_path);
     }
-    s.append(fileName);
-    env->ReleaseStringUTFChars(str_path, path);
-    env->DeleteLocalRef(str_path);
+    activity_->vm->DetachCurrentThread();
   }
-  std::ifstream f(s.c_str(), std::ios::binary);
-  activity_->vm->DetachCurrentThread();
-  if (f) {
+  if (!s.empty() && view->OpenFile(s.c_str())) {
     LOGI("reading:%s", s.c_str());
-    f.seekg(0, std::ifstream::end);
-    int32_t fileSize = f.tellg();
-    f.seekg(0, std::ifstream::beg);
-    buffer_ref->reserve(fileSize);
-    buffer_ref->assign(std::istreambuf_iterator<char>(f),
-                       std::istreambuf_iterator<char>());
-    f.close();
     return true;
-  } else {
-    // Fallback to assetManager
-    AAssetManager* assetManager = activity_->assetManager;
-    AAsset* assetFile =
-        AAssetManager_open(assetManager, fileName, AASSET_MODE_BUFFER);
-    if (!assetFile) {
-      return false;
-    }
-    uint8_t* data = (uint8_t*)AAsset_getBuffer(assetFile);
-    int32_t size = AAsset_getLength(assetFile);
-    if (data == NULL) {
-      AAsset_close(assetFile);
-
-      LOGI("Failed to load:%s", fileName);
-      return false;
-    }
+  }
 
-    buffer_ref->reserve(size);
-    buffer_ref->assign(data, data + size);
+  // Fallback to assetManager
+  if (!view->OpenAsset(activity_->assetManager, fileName)) {
+    LOGI("Failed to load:%s", fileName);
+    return false;
+  }
+  return true;
+}
 
-    AAsset_close(assetFile);
-    return true;
+bool JNIHelper::ReadFile(const char* fileName,
+                         std::vector<uint8_t>* buffer_ref) {
+  AssetView view;
+  if (!OpenFile(fileName, &view)) {
+    return false;
   }
+
+  buffer_ref->reserve(view.Size());
+  buffer_ref->assign(view.Data(), view.Data() + view.Size());
+  return true;
 }
 
 std::string JNIHelper::GetExternalFilesDir() {
@@ -27,6 +27,8 @@
 #include <android/log.h>
 #include <android_native_app_glue.h>
 
+#include "assetView.h"
+
 #define LOGI(...)                                                           \
   ((void)__android_log_print(                                               \
       ANDROID_LOG_INFO, ndk_helper::JNIHelper::GetInstance()->GetAppName(), \
@@ -154,6 +156,19 @@ class JNIHelper {
    */
   bool ReadFile(const char* file_name, std::vector<uint8_t>* buffer_ref);
 
+  /*
+   * Same lookup as ReadFile(), but maps the file instead of copying it.
+   * Prefer this for anything that is parsed or uploaded straight away.
+   *
+   * arguments:
+   * in: file_name, file name to read
+   * out: view, maps the contents of the file when the call succeeded
+   * return:
+   * true when the file was opened
+   * false when it failed to open the file
+   */
+  bool OpenFile(const char* file_name, AssetView* view);
+
   /*
    * Load and create OpenGL texture from given file name.
    * The method invokes BitmapFactory in Java so it can read jpeg/png formatted
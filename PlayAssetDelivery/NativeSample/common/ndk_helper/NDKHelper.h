@@ -32,12 +32,23 @@
  */
 #include "third_party/gl3stub.h"    // GLES3 stubs
 #include "GLContext.h"  // EGL & OpenGL manager
+#include "glStateCache.h"  // Redundant GL call elision
 #include "shader.h"     // Shader compiler support
+#include "shaderPreprocessor.h"  // Shader #include and parameters
+#include "programCache.h"  // Persistent program binaries
+#include "programBuilder.h"  // Non-blocking program builds
 #include "vecmath.h"  // Vector math support, C++ implementation n current version
 #include "tapCamera.h"        // Tap/Pinch camera control
 #include "JNIHelper.h"        // JNI support
+#include "assetView.h"        // Zero-copy asset and file access
 #include "gestureDetector.h"  // Tap/Doubletap/Pinch detector
-#include "perfMonitor.h"      // FPS counter
+#include "perfMonitor.h"      // FPS counter, frame time statistics
+#include "gpuTimer.h"         // GPU time per render pass
+#include "frameScheduler.h"   // Vsync-driven frame pacing
+#include "trace.h"            // Scoped trace markers
+#include "uploadRing.h"       // Per-frame GPU upload ring buffer
+#include "mailbox.h"          // Latest value handoff between two threads
+#include "jobSystem.h"        // Work-stealing job scheduler
 #include "sensorManager.h"    // SensorManager
 #include "interpolator.h"     // Interpolator
 #endif
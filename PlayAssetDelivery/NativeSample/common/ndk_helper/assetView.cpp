@@ -0,0 +1,87 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "assetView.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "JNIHelper.h"
+
+namespace ndk_helper {
+
+AssetView::AssetView() : asset_(NULL), map_(NULL), data_(NULL), size_(0) {}
+
+AssetView::~AssetView() { Close(); }
+
+bool AssetView::OpenAsset(AAssetManager* asset_manager,
+                          const char* asset_name) {
+  Close();
+  if (asset_manager == NULL) return false;
+
+  asset_ = AAssetManager_open(asset_manager, asset_name, AASSET_MODE_BUFFER);
+  if (asset_ == NULL) return false;
+
+  data_ = static_cast<const uint8_t*>(AAsset_getBuffer(asset_));
+  if (data_ == NULL) {
+    LOGE("Failed to map asset:%s", asset_name);
+    Close();
+    return false;
+  }
+  size_ = AAsset_getLength(asset_);
+  return true;
+}
+
+bool AssetView::OpenFile(const char* path) {
+  Close();
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+  void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file
+  close(fd);
+  if (map == MAP_FAILED) {
+    LOGE("Failed to map file:%s", path);
+    return false;
+  }
+  map_ = map;
+  data_ = static_cast<const uint8_t*>(map);
+  size_ = st.st_size;
+  return true;
+}
+
+void AssetView::Close() {
+  if (asset_) {
+    AAsset_close(asset_);
+    asset_ = NULL;
+  }
+  if (map_) {
+    munmap(map_, size_);
+    map_ = NULL;
+  }
+  data_ = NULL;
+  size_ = 0;
+}
+
+}  // namespace ndkHelper
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ASSETVIEW_H_
+#define ASSETVIEW_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <android/asset_manager.h>
+
+namespace ndk_helper {
+
+/******************************************************************
+ * Read-only view of a whole asset or file, without copying it
+ * - OpenAsset() uses AAsset_getBuffer(). Assets stored uncompressed in the
+ *   APK (see noCompress in build.gradle) are memory mapped, compressed ones
+ *   are inflated once by the asset manager.
+ * - OpenFile() memory maps a file, e.g. inside a downloaded asset pack.
+ * The data stays valid until Close() or the view is destroyed.
+ * A view may be opened and used on any thread.
+ */
+class AssetView {
+ private:
+  AAsset* asset_;
+  void* map_;
+  const uint8_t* data_;
+  size_t size_;
+
+  AssetView(const AssetView& rhs);
+  AssetView& operator=(const AssetView& rhs);
+
+ public:
+  AssetView();
+  ~AssetView();
+
+  bool OpenAsset(AAssetManager* asset_manager, const char* asset_name);
+  bool OpenFile(const char* path);
+  void Close();
+
+  bool IsOpen() const { return data_ != NULL; }
+  const uint8_t* Data() const { return data_; }
+  size_t Size() const { return size_; }
+};
+
+}  // namespace ndkHelper
+#endif /* ASSETVIEW_H_ */
@@ -0,0 +1,428 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frameScheduler.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+
+#if defined(__ANDROID__)
+#include <dlfcn.h>
+#endif
+
+#include "trace.h"
+
+namespace ndk_helper {
+
+namespace {
+
+// Intervals in a row the window disagrees with the estimate to relock
+const int32_t kRelockCount = 8;
+// A period as short as a quarter of the shortest interval is found
+const int64_t kMaxDivisor = 4;
+// Longer gaps between vsyncs, e.g. while paused, say nothing of the period
+const int64_t kMaxPeriodsPerSample = 8;
+// Nor do shorter ones, no display refreshes at more than 500Hz
+const int64_t kMinPeriodNs = 2000000;
+// Frames a shorter swap interval must fit in a row to switch to it
+const int32_t kSwapIntervalHold = 30;
+
+int64_t FloorDiv(int64_t a, int64_t b) {
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Within an eighth of period_ns of a whole number of periods, 0 if not
+int64_t CountPeriods(int64_t interval_ns, int64_t period_ns) {
+  int64_t periods = (interval_ns + period_ns / 2) / period_ns;
+  return std::abs(interval_ns - periods * period_ns) * 8 < period_ns ? periods
+                                                                     : 0;
+}
+
+}  // namespace
+
+//--------------------------------------------------------------------------------
+// ChoreographerVsync
+//--------------------------------------------------------------------------------
+ChoreographerVsync::ChoreographerVsync()
+    : choreographer_(NULL),
+      post_frame_callback64_(NULL),
+      post_frame_callback_(NULL),
+      unregister_refresh_rate_callback_(NULL),
+      callback_(NULL),
+      data_(NULL),
+      period_ns_(0) {}
+
+ChoreographerVsync::~ChoreographerVsync() { Release(); }
+
+void ChoreographerVsync::Release() {
+  if (unregister_refresh_rate_callback_) {
+    unregister_refresh_rate_callback_(choreographer_, OnRefreshRate, this);
+  }
+  Forget();
+}
+
+void ChoreographerVsync::Forget() {
+  choreographer_ = NULL;
+  unregister_refresh_rate_callback_ = NULL;
+  // A callback posted to another thread's looper never comes back
+  callback_ = NULL;
+  data_ = NULL;
+  period_ns_ = 0;
+}
+
+/*
+ * AChoreographer is per thread. NativeActivity runs android_main() on a new
+ * thread each time the activity is recreated, so every call looks up the
+ * instance of the calling thread and moves over to it. The one of a thread
+ * that exited without Release() went away with it and is only forgotten.
+ */
+bool ChoreographerVsync::Init() {
+#if defined(__ANDROID__)
+  // libandroid is loaded already, the handle is kept for the process life
+  void* android = dlopen("libandroid.so", RTLD_NOW);
+  if (!android) return false;
+  typedef AChoreographer* (*GetInstanceProc)();
+  typedef void (*RefreshRateProc)(AChoreographer*, void (*)(int64_t, void*),
+                                  void*);
+  GetInstanceProc get_instance = reinterpret_cast<GetInstanceProc>(
+      dlsym(android, "AChoreographer_getInstance"));
+  post_frame_callback64_ =
+      reinterpret_cast<void (*)(AChoreographer*, void (*)(int64_t, void*),
+                                void*)>(
+          dlsym(android, "AChoreographer_postFrameCallback64"));
+  if (sizeof(long) == sizeof(int64_t)) {
+    post_frame_callback_ = reinterpret_cast<void (*)(
+        AChoreographer*, void (*)(long, void*), void*)>(
+        dlsym(android, "AChoreographer_postFrameCallback"));
+  }
+  if (!get_instance || (!post_frame_callback64_ && !post_frame_callback_)) {
+    return false;
+  }
+  // NULL on a thread without a looper
+  AChoreographer* choreographer = get_instance();
+  if (choreographer && choreographer == choreographer_) return true;
+  Forget();
+  if (!choreographer) return false;
+  choreographer_ = choreographer;
+
+  RefreshRateProc register_refresh_rate = reinterpret_cast<RefreshRateProc>(
+      dlsym(android, "AChoreographer_registerRefreshRateCallback"));
+  RefreshRateProc unregister_refresh_rate = reinterpret_cast<RefreshRateProc>(
+      dlsym(android, "AChoreographer_unregisterRefreshRateCallback"));
+  if (register_refresh_rate && unregister_refresh_rate) {
+    register_refresh_rate(choreographer_, OnRefreshRate, this);
+    unregister_refresh_rate_callback_ = unregister_refresh_rate;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool ChoreographerVsync::RequestFrame(FrameCallback callback, void* data) {
+  if (!choreographer_ || callback_) return false;
+  callback_ = callback;
+  data_ = data;
+  if (post_frame_callback64_) {
+    post_frame_callback64_(choreographer_, OnFrame64, this);
+  } else {
+    post_frame_callback_(choreographer_, OnFrame, this);
+  }
+  return true;
+}
+
+void ChoreographerVsync::OnFrame64(int64_t frame_time_ns, void* data) {
+  ChoreographerVsync* vsync = static_cast<ChoreographerVsync*>(data);
+  FrameCallback callback = vsync->callback_;
+  vsync->callback_ = NULL;
+  if (callback) callback(frame_time_ns, vsync->data_);
+}
+
+void ChoreographerVsync::OnFrame(long frame_time_ns, void* data) {
+  OnFrame64(static_cast<int64_t>(frame_time_ns), data);
+}
+
+void ChoreographerVsync::OnRefreshRate(int64_t period_ns, void* data) {
+  static_cast<ChoreographerVsync*>(data)->period_ns_ = period_ns;
+}
+
+//--------------------------------------------------------------------------------
+// FakeVsync
+//--------------------------------------------------------------------------------
+FakeVsync::FakeVsync(int64_t period_ns)
+    : period_ns_(period_ns),
+      phase_ns_(0),
+      time_ns_(0),
+      request_ns_(0),
+      callback_(NULL),
+      data_(NULL) {}
+
+bool FakeVsync::RequestFrame(FrameCallback callback, void* data) {
+  if (callback_) return false;
+  callback_ = callback;
+  data_ = data;
+  request_ns_ = time_ns_;
+  return true;
+}
+
+int64_t FakeVsync::GetNextFrameTime() const {
+  if (!callback_) return -1;
+  // Requested before a period change, nothing was due until phase_ns_
+  if (request_ns_ < phase_ns_) return phase_ns_;
+  // The first vsync after the request
+  return phase_ns_ +
+         (FloorDiv(request_ns_ - phase_ns_, period_ns_) + 1) * period_ns_;
+}
+
+void FakeVsync::AdvanceTo(int64_t time_ns) {
+  time_ns_ = std::max(time_ns_, time_ns);
+  int64_t frame_time_ns = GetNextFrameTime();
+  if (frame_time_ns < 0 || frame_time_ns > time_ns_) return;
+  FrameCallback callback = callback_;
+  callback_ = NULL;
+  callback(frame_time_ns, data_);
+}
+
+void FakeVsync::SetPeriod(int64_t period_ns) {
+  // The next vsync keeps the old phase
+  phase_ns_ += (FloorDiv(time_ns_ - phase_ns_, period_ns_) + 1) * period_ns_;
+  period_ns_ = period_ns;
+}
+
+//--------------------------------------------------------------------------------
+// FrameScheduler
+//--------------------------------------------------------------------------------
+FrameScheduler::FrameScheduler()
+    : source_(NULL),
+      requested_(false),
+      pending_(false),
+      period_ns_(kDefaultPeriodNs),
+      last_vsync_ns_(0),
+      last_present_ns_(0),
+      last_frame_vsync_ns_(0),
+      start_ns_(0),
+      work_ns_(kDefaultPeriodNs),
+      swap_interval_(1),
+      shorter_frames_(0),
+      interval_count_(0),
+      mismatches_(0),
+      timing_(),
+      frame_start_ns_(-1) {
+  ResetStats();
+}
+
+void FrameScheduler::Init(VsyncSource* source, int64_t period_ns) {
+  source_ = source;
+  requested_ = false;
+  pending_ = false;
+  period_ns_ = period_ns;
+  last_vsync_ns_ = 0;
+  last_present_ns_ = 0;
+  last_frame_vsync_ns_ = 0;
+  // Start at the vsync until frames have been timed
+  work_ns_ = period_ns;
+  swap_interval_ = 1;
+  shorter_frames_ = 0;
+  interval_count_ = 0;
+  mismatches_ = 0;
+  frame_start_ns_ = -1;
+}
+
+void FrameScheduler::ResetStats() {
+  frame_count_ = 0;
+  missed_count_ = 0;
+  late_count_ = 0;
+}
+
+int64_t FrameScheduler::GetCurrentTimeNs() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return static_cast<int64_t>(time.tv_sec) * 1000000000LL + time.tv_nsec;
+}
+
+void FrameScheduler::Schedule() {
+  if (!source_ || requested_) return;
+  requested_ = source_->RequestFrame(OnVsync, this);
+  // No vsync would ever come, let the swap pace frames instead
+  if (!requested_) source_ = NULL;
+}
+
+void FrameScheduler::OnVsync(int64_t frame_time_ns, void* data) {
+  FrameScheduler* scheduler = static_cast<FrameScheduler*>(data);
+  // A frame still waiting to begin is timed from the newer vsync instead
+  scheduler->requested_ = false;
+  scheduler->pending_ = true;
+  scheduler->UpdatePeriod(frame_time_ns);
+
+  // Keep the cadence, the vsync of the previous frame plus the interval
+  int64_t period_ns = scheduler->period_ns_;
+  int64_t vsync_ns = frame_time_ns;
+  int64_t next_ns = scheduler->last_frame_vsync_ns_ +
+                    scheduler->swap_interval_ * period_ns;
+  if (next_ns > frame_time_ns) {
+    vsync_ns += (next_ns - frame_time_ns + period_ns / 2) / period_ns *
+                period_ns;
+  }
+  scheduler->SetTiming(vsync_ns, frame_time_ns);
+}
+
+/*
+ * A frame that takes longer than a period gets its vsync late, so two in a
+ * row may be several periods apart: the period is the longest one all the
+ * recent intervals are whole multiples of. While that agrees with the
+ * estimate each interval refines it. Once it has disagreed kRelockCount
+ * intervals in a row, as after a refresh rate switch or when the first
+ * guess was a multiple of the real period, it replaces the estimate.
+ */
+void FrameScheduler::UpdatePeriod(int64_t vsync_ns) {
+  int64_t reported_ns = source_ ? source_->GetPeriod() : 0;
+  int64_t delta = vsync_ns - last_vsync_ns_;
+  bool sample = last_vsync_ns_ > 0 && delta >= kMinPeriodNs &&
+                delta < kMaxPeriodsPerSample * period_ns_;
+  last_vsync_ns_ = vsync_ns;
+  if (reported_ns > 0) {
+    period_ns_ = reported_ns;
+    return;
+  }
+  if (!sample) return;
+
+  intervals_[interval_count_++ % kPeriodWindow] = delta;
+  int64_t window_ns = FindPeriod();
+  if (window_ns && CountPeriods(window_ns, period_ns_) != 1) {
+    if (++mismatches_ >= kRelockCount) {
+      period_ns_ = window_ns;
+      mismatches_ = 0;
+    }
+    return;
+  }
+  mismatches_ = 0;
+  int64_t periods = CountPeriods(delta, period_ns_);
+  if (periods) period_ns_ += (delta / periods - period_ns_) / 8;
+}
+
+// Mean period of the intervals in the window, 0 when they have none
+int64_t FrameScheduler::FindPeriod() const {
+  int32_t count = interval_count_ < static_cast<uint32_t>(kPeriodWindow)
+                      ? static_cast<int32_t>(interval_count_)
+                      : kPeriodWindow;
+  int64_t shortest_ns = intervals_[0];
+  for (int32_t i = 1; i < count; ++i) {
+    shortest_ns = std::min(shortest_ns, intervals_[i]);
+  }
+  for (int64_t divisor = 1; divisor <= kMaxDivisor; ++divisor) {
+    int64_t period_ns = shortest_ns / divisor;
+    if (period_ns < kMinPeriodNs) break;
+    int64_t total_ns = 0;
+    int64_t total_periods = 0;
+    int32_t i = 0;
+    for (; i < count; ++i) {
+      int64_t periods = CountPeriods(intervals_[i], period_ns);
+      if (!periods) break;
+      total_ns += intervals_[i];
+      total_periods += periods;
+    }
+    if (i == count) return total_ns / total_periods;
+  }
+  return 0;
+}
+
+/*
+ * A frame swapped before the next vsync is latched there and shown one
+ * vsync later. The desired present time is half a period before that, so
+ * jitter in the timestamps never holds the frame back a vsync. A frame
+ * longer than a period starts before its vsync, but never before the
+ * vsync callback that woke the looper.
+ */
+void FrameScheduler::SetTiming(int64_t vsync_ns, int64_t earliest_ns) {
+  timing_.vsync_ns = vsync_ns;
+  timing_.deadline_ns = vsync_ns + period_ns_;
+  timing_.present_ns = vsync_ns + period_ns_ * 2 - period_ns_ / 2;
+  // Some headroom for the frames that take longer than predicted
+  start_ns_ =
+      std::max(earliest_ns, timing_.deadline_ns - work_ns_ - period_ns_ / 8);
+}
+
+/*
+ * Up at once when the predicted frame no longer fits with the start
+ * headroom. Down once the shorter interval has fit for kSwapIntervalHold
+ * frames in a row, with a quarter period to spare, so a frame time close
+ * to a multiple of the period doesn't make the cadence flip.
+ */
+void FrameScheduler::UpdateSwapInterval() {
+  int64_t needed = (work_ns_ + period_ns_ / 8 + period_ns_ - 1) / period_ns_;
+  if (needed >= swap_interval_) {
+    swap_interval_ = static_cast<int32_t>(needed);
+    shorter_frames_ = 0;
+  } else if (work_ns_ + period_ns_ / 4 > (swap_interval_ - 1) * period_ns_) {
+    shorter_frames_ = 0;
+  } else if (++shorter_frames_ >= kSwapIntervalHold) {
+    swap_interval_ = std::max(static_cast<int32_t>(needed), 1);
+    shorter_frames_ = 0;
+  }
+}
+
+int32_t FrameScheduler::GetPollTimeout(int64_t now_ns) const {
+  if (!source_) return 0;
+  if (!pending_) return -1;
+  int64_t wait_ns = start_ns_ - now_ns;
+  if (wait_ns < kPollResolutionNs) return 0;
+  return static_cast<int32_t>(wait_ns / kPollResolutionNs);
+}
+
+bool FrameScheduler::BeginFrame(int64_t now_ns, FRAME_TIMING* timing) {
+  if (!source_) {
+    timing_.vsync_ns = now_ns;
+    timing_.deadline_ns = now_ns + period_ns_;
+    timing_.present_ns = 0;
+  } else {
+    // Within the timeout resolution of the start is close enough
+    if (!pending_ || now_ns + kPollResolutionNs <= start_ns_) return false;
+    int64_t late_ns = now_ns + work_ns_ - timing_.deadline_ns;
+    if (late_ns > 0) {
+      // Aim for the first vsync the frame can still make
+      int64_t vsync_ns = timing_.vsync_ns +
+                         (late_ns + period_ns_ - 1) / period_ns_ * period_ns_;
+      SetTiming(vsync_ns, vsync_ns);
+      ++late_count_;
+    }
+    last_frame_vsync_ns_ = timing_.vsync_ns;
+    // At least a period after the previous frame, even as the period
+    // estimate changes
+    timing_.present_ns =
+        std::max(timing_.present_ns, last_present_ns_ + period_ns_);
+    last_present_ns_ = timing_.present_ns;
+    pending_ = false;
+  }
+  frame_start_ns_ = now_ns;
+  *timing = timing_;
+  return true;
+}
+
+void FrameScheduler::EndFrame(int64_t now_ns) {
+  if (frame_start_ns_ < 0) return;
+  int64_t work_ns = now_ns - frame_start_ns_;
+  frame_start_ns_ = -1;
+  work_ns_ =
+      work_ns > work_ns_ ? work_ns : work_ns_ - (work_ns_ - work_ns) / 16;
+  NDK_TRACE_COUNTER("Predicted frame us", work_ns_ / 1000);
+  UpdateSwapInterval();
+  ++frame_count_;
+  if (now_ns > timing_.deadline_ns) ++missed_count_;
+}
+
+}  // namespace ndkHelper
@@ -0,0 +1,205 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FRAMESCHEDULER_H_
+#define FRAMESCHEDULER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct AChoreographer;
+
+namespace ndk_helper {
+
+/******************************************************************
+ * Source of vsync timestamps, CLOCK_MONOTONIC
+ */
+class VsyncSource {
+ public:
+  typedef void (*FrameCallback)(int64_t frame_time_ns, void* data);
+
+  virtual ~VsyncSource() {}
+  // Calls callback once, at the next vsync. One request at a time.
+  virtual bool RequestFrame(FrameCallback callback, void* data) = 0;
+  // Refresh period as reported by the display, 0 when unknown
+  virtual int64_t GetPeriod() const { return 0; }
+};
+
+/******************************************************************
+ * Vsync from AChoreographer
+ * Callbacks run on the looper of the thread that called Init(), from
+ * ALooper_pollOnce(). Uses AChoreographer_postFrameCallback64 (API 29),
+ * or AChoreographer_postFrameCallback (API 24) on 64-bit, where its long
+ * timestamp doesn't overflow. The refresh rate callback (API 30) keeps
+ * GetPeriod() up to date.
+ */
+class ChoreographerVsync : public VsyncSource {
+ private:
+  AChoreographer* choreographer_;
+  void (*post_frame_callback64_)(AChoreographer*,
+                                 void (*)(int64_t, void*), void*);
+  void (*post_frame_callback_)(AChoreographer*, void (*)(long, void*),
+                               void*);
+  void (*unregister_refresh_rate_callback_)(AChoreographer*,
+                                            void (*)(int64_t, void*), void*);
+  FrameCallback callback_;
+  void* data_;
+  int64_t period_ns_;
+
+  static void OnFrame64(int64_t frame_time_ns, void* data);
+  static void OnFrame(long frame_time_ns, void* data);
+  static void OnRefreshRate(int64_t period_ns, void* data);
+  void Forget();
+
+  ChoreographerVsync(const ChoreographerVsync& rhs);
+  ChoreographerVsync& operator=(const ChoreographerVsync& rhs);
+
+ public:
+  ChoreographerVsync();
+  ~ChoreographerVsync();
+
+  // Returns false before API 24 (API 29 on 32-bit) or without a looper.
+  // Call again from a new looper thread, callbacks move over to it.
+  bool Init();
+  // On the looper thread before it exits
+  void Release();
+  virtual bool RequestFrame(FrameCallback callback, void* data);
+  virtual int64_t GetPeriod() const { return period_ns_; }
+};
+
+/******************************************************************
+ * Vsync on a clock of its own, to run FrameScheduler off device
+ * Vsyncs are at every period from time 0. AdvanceTo() moves the clock
+ * and delivers the callback of a vsync that went by, as a looper would.
+ */
+class FakeVsync : public VsyncSource {
+ private:
+  int64_t period_ns_;
+  int64_t phase_ns_;  // a vsync time
+  int64_t time_ns_;
+  int64_t request_ns_;
+  FrameCallback callback_;
+  void* data_;
+
+ public:
+  explicit FakeVsync(int64_t period_ns);
+
+  virtual bool RequestFrame(FrameCallback callback, void* data);
+  // Vsync time the pending callback is for, -1 when none is pending
+  int64_t GetNextFrameTime() const;
+  void AdvanceTo(int64_t time_ns);
+  // Vsyncs are period_ns apart from the next one on, as on a rate switch
+  void SetPeriod(int64_t period_ns);
+  int64_t GetTime() const { return time_ns_; }
+};
+
+struct FRAME_TIMING {
+  int64_t vsync_ns;     // the frame is timed from this vsync
+  int64_t deadline_ns;  // swap by then to be latched at the next vsync
+  // Desired present time for eglPresentationTimeANDROID, 0 when unpaced
+  int64_t present_ns;
+};
+
+/******************************************************************
+ * Vsync-driven frame pacing for the looper thread
+ * A frame starts from a vsync callback instead of whenever the previous
+ * swap returned. Schedule() asks for the next vsync, GetPollTimeout() says
+ * how long the looper may sleep and BeginFrame() whether to draw now.
+ * Work starts as late as the predicted frame time allows, so the frame
+ * shows input that is as fresh as possible; a frame that can't make its
+ * deadline any more is timed for the vsync after. Frames longer than a
+ * period are kept a whole number of vsyncs apart, so they are shown at an
+ * even rate rather than one or two vsyncs apart in turn. The desired
+ * present time keeps frames that finish early from being shown early.
+ * The frame time prediction rises at once and decays slowly. The period
+ * comes from the source, or is measured from the vsync timestamps.
+ * Without a source every frame starts at once and the swap paces them,
+ * as it did before.
+ * Times are CLOCK_MONOTONIC ns, passed in so the pacing can run on a fake
+ * clock. Single thread.
+ */
+class FrameScheduler {
+ public:
+  static const int64_t kDefaultPeriodNs = 16666667;
+  // Resolution of the looper timeout
+  static const int64_t kPollResolutionNs = 1000000;
+  // Recent vsync intervals the period is measured from
+  static const int32_t kPeriodWindow = 8;
+
+ private:
+  VsyncSource* source_;
+  bool requested_;  // a vsync callback is on its way
+  bool pending_;    // a vsync arrived, its frame hasn't begun
+  int64_t period_ns_;
+  int64_t last_vsync_ns_;
+  int64_t last_present_ns_;
+  int64_t last_frame_vsync_ns_;  // the last frame begun was timed from it
+  int64_t start_ns_;  // when the pending frame should begin
+  int64_t work_ns_;   // predicted BeginFrame() to EndFrame()
+  int32_t swap_interval_;
+  int32_t shorter_frames_;  // in a row that fit a shorter interval
+  int64_t intervals_[kPeriodWindow];
+  uint32_t interval_count_;  // ever sampled, the window wraps around
+  int32_t mismatches_;      // window periods in a row off the estimate
+  FRAME_TIMING timing_;
+  int64_t frame_start_ns_;
+
+  uint32_t frame_count_;
+  uint32_t missed_count_;
+  uint32_t late_count_;
+
+  static void OnVsync(int64_t frame_time_ns, void* data);
+  void UpdatePeriod(int64_t vsync_ns);
+  int64_t FindPeriod() const;
+  void UpdateSwapInterval();
+  void SetTiming(int64_t vsync_ns, int64_t earliest_ns);
+
+  FrameScheduler(const FrameScheduler& rhs);
+  FrameScheduler& operator=(const FrameScheduler& rhs);
+
+ public:
+  FrameScheduler();
+
+  // source NULL runs unpaced. The source must outlive the scheduler.
+  void Init(VsyncSource* source, int64_t period_ns = kDefaultPeriodNs);
+  bool IsPaced() const { return source_ != NULL; }
+
+  // Ask for the next vsync unless one is on its way. Every frame does,
+  // even before it begins, so the vsyncs measured are consecutive.
+  void Schedule();
+  // ms the looper may block for: 0 to draw now, -1 until an event
+  int32_t GetPollTimeout(int64_t now_ns) const;
+  // True when a frame should be drawn now
+  bool BeginFrame(int64_t now_ns, FRAME_TIMING* timing);
+  // After the swap of a frame BeginFrame() started
+  void EndFrame(int64_t now_ns);
+
+  int64_t GetPeriod() const { return period_ns_; }
+  int64_t GetPredictedWork() const { return work_ns_; }
+  // Vsyncs between frames, enough for the predicted frame time
+  int32_t GetSwapInterval() const { return swap_interval_; }
+  uint32_t GetFrameCount() const { return frame_count_; }
+  // Frames swapped after their deadline
+  uint32_t GetMissedCount() const { return missed_count_; }
+  // Frames begun too late for their vsync and moved to a later one
+  uint32_t GetLateCount() const { return late_count_; }
+  void ResetStats();
+
+  static int64_t GetCurrentTimeNs();
+};
+
+}  // namespace ndkHelper
+#endif /* FRAMESCHEDULER_H_ */
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "glStateCache.h"
+
+#include <string.h>
+
+#include "../third_party/gl3stub.h"
+
+namespace ndk_helper {
+
+GLStateCache::GLStateCache() { Reset(); }
+
+void GLStateCache::Reset() {
+  program_ = kUnknown;
+  array_buffer_ = kUnknown;
+  element_buffer_ = kUnknown;
+  vertex_array_ = kUnknown;
+  uniforms_.clear();
+  current_uniforms_ = NULL;
+  issued_ = 0;
+  elided_ = 0;
+}
+
+void GLStateCache::UseProgram(GLuint program) {
+  if (program == program_) {
+    ++elided_;
+    return;
+  }
+  glUseProgram(program);
+  ++issued_;
+  program_ = program;
+  // Uniform values stay with their program across switches
+  current_uniforms_ = program ? &uniforms_[program] : NULL;
+}
+
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer) {
+  GLuint* binding = NULL;
+  if (target == GL_ARRAY_BUFFER) {
+    binding = &array_buffer_;
+  } else if (target == GL_ELEMENT_ARRAY_BUFFER) {
+    binding = &element_buffer_;
+  }
+  if (binding && *binding == buffer) {
+    ++elided_;
+    return;
+  }
+  glBindBuffer(target, buffer);
+  ++issued_;
+  if (binding) *binding = buffer;
+}
+
+void GLStateCache::BindVertexArray(GLuint vertex_array) {
+  if (!glBindVertexArray) return;
+  if (vertex_array == vertex_array_) {
+    ++elided_;
+    return;
+  }
+  glBindVertexArray(vertex_array);
+  ++issued_;
+  vertex_array_ = vertex_array;
+  // The element array binding belongs to the vertex array object
+  element_buffer_ = kUnknown;
+}
+
+void GLStateCache::DeleteProgram(GLuint program) {
+  if (!program) return;
+  glDeleteProgram(program);
+  // A current program lives on until replaced, but the name may come back
+  if (program == program_) {
+    program_ = kUnknown;
+    current_uniforms_ = NULL;
+  }
+  uniforms_.erase(program);
+}
+
+void GLStateCache::DeleteBuffer(GLuint buffer) {
+  if (!buffer) return;
+  glDeleteBuffers(1, &buffer);
+  // Deleting a bound buffer binds 0 in its place
+  if (array_buffer_ == buffer) array_buffer_ = 0;
+  if (element_buffer_ == buffer) element_buffer_ = 0;
+}
+
+void GLStateCache::DeleteVertexArray(GLuint vertex_array) {
+  if (!vertex_array || !glDeleteVertexArrays) return;
+  glDeleteVertexArrays(1, &vertex_array);
+  if (vertex_array_ == vertex_array) {
+    vertex_array_ = 0;
+    element_buffer_ = kUnknown;
+  }
+}
+
+bool GLStateCache::UpdateUniform(GLint location, const void* value,
+                                 uint32_t size) {
+  if (!current_uniforms_ || location >= kMaxCachedLocation) return true;
+  if (current_uniforms_->size() <= static_cast<size_t>(location)) {
+    UNIFORM_VALUE unset = {};
+    current_uniforms_->resize(location + 1, unset);
+  }
+  UNIFORM_VALUE& cached = (*current_uniforms_)[location];
+  if (cached.size == size && memcmp(cached.value, value, size) == 0) {
+    ++elided_;
+    return false;
+  }
+  memcpy(cached.value, value, size);
+  cached.size = size;
+  return true;
+}
+
+void GLStateCache::Uniform1i(GLint location, GLint v0) {
+  if (location < 0 || !UpdateUniform(location, &v0, sizeof(v0))) return;
+  glUniform1i(location, v0);
+  ++issued_;
+}
+
+void GLStateCache::Uniform3f(GLint location, GLfloat v0, GLfloat v1,
+                             GLfloat v2) {
+  const GLfloat value[3] = {v0, v1, v2};
+  if (location < 0 || !UpdateUniform(location, value, sizeof(value))) return;
+  glUniform3f(location, v0, v1, v2);
+  ++issued_;
+}
+
+void GLStateCache::Uniform4f(GLint location, GLfloat v0, GLfloat v1,
+                             GLfloat v2, GLfloat v3) {
+  const GLfloat value[4] = {v0, v1, v2, v3};
+  if (location < 0 || !UpdateUniform(location, value, sizeof(value))) return;
+  glUniform4f(location, v0, v1, v2, v3);
+  ++issued_;
+}
+
+void GLStateCache::UniformMatrix4fv(GLint location, const GLfloat* value) {
+  if (location < 0 || !UpdateUniform(location, value, 16 * sizeof(GLfloat))) {
+    return;
+  }
+  glUniformMatrix4fv(location, 1, GL_FALSE, value);
+  ++issued_;
+}
+
+}  // namespace ndkHelper
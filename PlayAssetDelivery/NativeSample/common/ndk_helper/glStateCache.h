@@ -0,0 +1,105 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GLSTATECACHE_H_
+#define GLSTATECACHE_H_
+
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include <GLES2/gl2.h>
+
+namespace ndk_helper {
+
+/******************************************************************
+ * Shadow copy of the GL bindings and uniforms the render path sets
+ * Calls that would not change anything are not passed to the driver:
+ * - the current program
+ * - GL_ARRAY_BUFFER and GL_ELEMENT_ARRAY_BUFFER bindings
+ * - the vertex array object, through gl3stub
+ * - uniform values, per program
+ * It only works if every such call on the context goes through here, or
+ * Reset() is called after one that didn't. Reset() also after the context
+ * is created or restored. Delete*() keep the cache right when GL names are
+ * deleted and reused.
+ * GL thread only.
+ */
+class GLStateCache {
+ private:
+  static const GLuint kUnknown = 0xFFFFFFFF;
+  static const GLint kMaxCachedLocation = 64;  // larger ones aren't cached
+
+  struct UNIFORM_VALUE {
+    GLfloat value[16];  // int uniforms are stored bit for bit
+    uint32_t size;      // 0 until set once
+  };
+  typedef std::vector<UNIFORM_VALUE> PROGRAM_UNIFORMS;
+
+  GLuint program_;
+  GLuint array_buffer_;
+  GLuint element_buffer_;
+  GLuint vertex_array_;
+  std::unordered_map<GLuint, PROGRAM_UNIFORMS> uniforms_;
+  PROGRAM_UNIFORMS* current_uniforms_;  // of program_, NULL if unknown
+
+  uint64_t issued_;
+  uint64_t elided_;
+
+  // True if the value differs and was stored, so it must be sent
+  bool UpdateUniform(GLint location, const void* value, uint32_t size);
+
+  GLStateCache();
+  GLStateCache(const GLStateCache& rhs);
+  GLStateCache& operator=(const GLStateCache& rhs);
+
+ public:
+  static GLStateCache* GetInstance() {
+    // Singleton
+    static GLStateCache instance;
+
+    return &instance;
+  }
+
+  // Forget everything, the next call of each kind goes to the driver
+  void Reset();
+
+  void UseProgram(GLuint program);
+  // Other targets go straight to the driver
+  void BindBuffer(GLenum target, GLuint buffer);
+  // Does nothing before OpenGL ES 3
+  void BindVertexArray(GLuint vertex_array);
+
+  void DeleteProgram(GLuint program);
+  void DeleteBuffer(GLuint buffer);
+  void DeleteVertexArray(GLuint vertex_array);
+
+  // Uniforms of the current program, a location of -1 is ignored like GL
+  void Uniform1i(GLint location, GLint v0);
+  void Uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+  void Uniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2,
+                 GLfloat v3);
+  // A single matrix, not transposed
+  void UniformMatrix4fv(GLint location, const GLfloat* value);
+
+  // Calls passed to the driver and calls dropped, since the last Reset()
+  uint64_t GetIssuedCount() const { return issued_; }
+  uint64_t GetElidedCount() const { return elided_; }
+};
+
+}  // namespace ndkHelper
+#endif /* GLSTATECACHE_H_ */
@@ -0,0 +1,173 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gpuTimer.h"
+
+#include <EGL/egl.h>
+
+#include "GLContext.h"
+#include "JNIHelper.h"
+
+// GL_EXT_disjoint_timer_query
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_QUERY_RESULT_EXT
+#define GL_QUERY_RESULT_EXT 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE_EXT
+#define GL_QUERY_RESULT_AVAILABLE_EXT 0x8867
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+namespace ndk_helper {
+
+GpuTimer::GpuTimer()
+    : gen_queries_(NULL),
+      delete_queries_(NULL),
+      begin_query_(NULL),
+      end_query_(NULL),
+      get_query_objectuiv_(NULL),
+      get_query_objectui64v_(NULL),
+      monitor_(NULL),
+      pass_count_(0),
+      active_(-1),
+      skipped_(0),
+      disjoint_(0) {}
+
+GpuTimer::~GpuTimer() {}
+
+bool GpuTimer::Init(PerfMonitor* monitor) {
+  Release();
+  if (!GLContext::GetInstance()->CheckExtension(
+          "GL_EXT_disjoint_timer_query")) {
+    LOGI("GL_EXT_disjoint_timer_query is not supported, no GPU timings");
+    return false;
+  }
+  gen_queries_ = reinterpret_cast<GenQueriesProc>(
+      eglGetProcAddress("glGenQueriesEXT"));
+  delete_queries_ = reinterpret_cast<DeleteQueriesProc>(
+      eglGetProcAddress("glDeleteQueriesEXT"));
+  begin_query_ = reinterpret_cast<BeginQueryProc>(
+      eglGetProcAddress("glBeginQueryEXT"));
+  end_query_ =
+      reinterpret_cast<EndQueryProc>(eglGetProcAddress("glEndQueryEXT"));
+  get_query_objectuiv_ = reinterpret_cast<GetQueryObjectuivProc>(
+      eglGetProcAddress("glGetQueryObjectuivEXT"));
+  get_query_objectui64v_ = reinterpret_cast<GetQueryObjectui64vProc>(
+      eglGetProcAddress("glGetQueryObjectui64vEXT"));
+  if (!gen_queries_ || !delete_queries_ || !begin_query_ || !end_query_ ||
+      !get_query_objectuiv_ || !get_query_objectui64v_) {
+    LOGW("GL_EXT_disjoint_timer_query entry points are missing");
+    return false;
+  }
+
+  // Reading the flag clears it, start from a clean state
+  GLint disjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+  monitor_ = monitor;
+  return true;
+}
+
+void GpuTimer::Release() {
+  if (monitor_) {
+    if (active_ >= 0) End();
+    for (int32_t i = 0; i < pass_count_; ++i) {
+      delete_queries_(kRingSize, passes_[i].queries);
+    }
+  }
+  monitor_ = NULL;
+  pass_count_ = 0;
+  active_ = -1;
+}
+
+int32_t GpuTimer::AddPass(const char* name) {
+  if (!monitor_ || pass_count_ == kMaxPasses) return -1;
+  int32_t metric = monitor_->AddMetric(name);
+  if (metric < 0) return -1;
+
+  PASS& pass = passes_[pass_count_];
+  pass.name = name;
+  pass.metric = metric;
+  gen_queries_(kRingSize, pass.queries);
+  for (int32_t i = 0; i < kRingSize; ++i) pass.pending[i] = false;
+  pass.next = 0;
+  pass.oldest = 0;
+  return pass_count_++;
+}
+
+void GpuTimer::Begin(int32_t pass) {
+  if (!monitor_ || pass < 0 || active_ >= 0) return;
+  PASS& p = passes_[pass];
+  if (p.pending[p.next]) {
+    // The GPU is kRingSize frames behind, don't wait for it
+    ++skipped_;
+    return;
+  }
+  begin_query_(GL_TIME_ELAPSED_EXT, p.queries[p.next]);
+  active_ = pass;
+}
+
+void GpuTimer::End() {
+  if (active_ < 0) return;
+  PASS& p = passes_[active_];
+  end_query_(GL_TIME_ELAPSED_EXT);
+  p.pending[p.next] = true;
+  p.next = (p.next + 1) % kRingSize;
+  active_ = -1;
+}
+
+void GpuTimer::Collect() {
+  if (!monitor_) return;
+
+  struct RESULT {
+    int32_t metric;
+    uint64_t ns;
+  } results[kMaxPasses * kRingSize];
+  int32_t count = 0;
+  for (int32_t i = 0; i < pass_count_; ++i) {
+    PASS& p = passes_[i];
+    // Queries complete in order, stop at the first one still running
+    while (p.pending[p.oldest]) {
+      GLuint available = GL_FALSE;
+      get_query_objectuiv_(p.queries[p.oldest], GL_QUERY_RESULT_AVAILABLE_EXT,
+                           &available);
+      if (!available) break;
+      results[count].metric = p.metric;
+      get_query_objectui64v_(p.queries[p.oldest], GL_QUERY_RESULT_EXT,
+                             &results[count].ns);
+      ++count;
+      p.pending[p.oldest] = false;
+      p.oldest = (p.oldest + 1) % kRingSize;
+    }
+  }
+
+  // Checked after reading, it covers every result read so far
+  GLint disjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+  if (disjoint) {
+    ++disjoint_;
+    return;
+  }
+  for (int32_t i = 0; i < count; ++i) {
+    monitor_->RecordMetric(results[i].metric,
+                           static_cast<int64_t>(results[i].ns));
+  }
+}
+
+}  // namespace ndkHelper
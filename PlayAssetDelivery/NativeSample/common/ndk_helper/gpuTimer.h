@@ -0,0 +1,102 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GPUTIMER_H_
+#define GPUTIMER_H_
+
+#include <stdint.h>
+
+#include <GLES2/gl2.h>
+
+#include "perfMonitor.h"
+
+namespace ndk_helper {
+
+/******************************************************************
+ * GPU time per render pass, with GL_EXT_disjoint_timer_query
+ * Begin()/End() bracket a pass with a GL_TIME_ELAPSED_EXT query; passes
+ * can't nest. Each pass has a ring of queries, so results are read a few
+ * frames late and Collect() never waits for the GPU. When the GPU is so
+ * far behind that the ring is full, the pass is not timed that frame.
+ * Collected durations go to the PerfMonitor metric named after the pass.
+ * Results of an interval flagged by GL_GPU_DISJOINT_EXT (frequency change,
+ * context switch...) are dropped.
+ * Without the extension every call does nothing.
+ * GL thread only; Release() before the context goes away.
+ */
+class GpuTimer {
+ public:
+  static const int32_t kMaxPasses = 4;
+  static const int32_t kRingSize = 4;  // frames in flight per pass
+
+ private:
+  typedef void (*GenQueriesProc)(GLsizei, GLuint*);
+  typedef void (*DeleteQueriesProc)(GLsizei, const GLuint*);
+  typedef void (*BeginQueryProc)(GLenum, GLuint);
+  typedef void (*EndQueryProc)(GLenum);
+  typedef void (*GetQueryObjectuivProc)(GLuint, GLenum, GLuint*);
+  typedef void (*GetQueryObjectui64vProc)(GLuint, GLenum, uint64_t*);
+
+  struct PASS {
+    const char* name;
+    int32_t metric;
+    GLuint queries[kRingSize];
+    bool pending[kRingSize];
+    int32_t next;    // slot for the next Begin()
+    int32_t oldest;  // slot to read next
+  };
+
+  GenQueriesProc gen_queries_;
+  DeleteQueriesProc delete_queries_;
+  BeginQueryProc begin_query_;
+  EndQueryProc end_query_;
+  GetQueryObjectuivProc get_query_objectuiv_;
+  GetQueryObjectui64vProc get_query_objectui64v_;
+
+  PerfMonitor* monitor_;
+  PASS passes_[kMaxPasses];
+  int32_t pass_count_;
+  int32_t active_;  // pass between Begin() and End(), -1 if none
+  uint32_t skipped_;
+  uint32_t disjoint_;
+
+  GpuTimer(const GpuTimer& rhs);
+  GpuTimer& operator=(const GpuTimer& rhs);
+
+ public:
+  GpuTimer();
+  ~GpuTimer();
+
+  // Returns false when the context can't time passes
+  bool Init(PerfMonitor* monitor);
+  void Release();
+  bool IsSupported() const { return monitor_ != NULL; }
+
+  // name must outlive the timer. Returns -1 when unsupported or full.
+  int32_t AddPass(const char* name);
+  void Begin(int32_t pass);
+  void End();
+  // Once per frame, reads whatever results are available
+  void Collect();
+
+  // Passes not timed because the ring was full
+  uint32_t GetSkippedCount() const { return skipped_; }
+  // Batches of results dropped as disjoint
+  uint32_t GetDisjointCount() const { return disjoint_; }
+};
+
+}  // namespace ndkHelper
+#endif /* GPUTIMER_H_ */
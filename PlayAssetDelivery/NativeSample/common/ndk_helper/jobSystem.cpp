@@ -0,0 +1,406 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jobSystem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <new>
+
+#if defined(__ANDROID__)
+#include "JNIHelper.h"
+#else
+// Host tools (tools/job_benchmark) build the job system without JNIHelper
+#ifndef LOGE
+#define LOGE(...) (fprintf(stderr, __VA_ARGS__), fprintf(stderr, "\n"))
+#endif
+#endif
+
+namespace ndk_helper {
+
+namespace {
+
+// Index of the calling thread in workers_, -1 for any other thread
+thread_local int32_t t_worker = -1;
+
+const int32_t kSpinCount = 64;  // idle loops before a worker sleeps
+
+// Read one number from a sysfs file, 0 if there is none
+uint32_t ReadSysfs(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (!f) return 0;
+  unsigned int value = 0;
+  if (fscanf(f, "%u", &value) != 1) value = 0;
+  fclose(f);
+  return value;
+}
+
+struct RANGE_JOB {
+  JobSystem::RangeFunction function;
+  void* data;
+  uint32_t begin;
+  uint32_t end;
+  uint32_t batch;
+};
+
+// Split off upper halves for thieves down to one batch, then run that
+void RangeJob(Job* job, void* data) {
+  RANGE_JOB range;
+  memcpy(&range, data, sizeof(range));
+  JobSystem* jobs = JobSystem::GetInstance();
+  while (range.end - range.begin > range.batch) {
+    RANGE_JOB upper = range;
+    upper.begin = range.begin + (range.end - range.begin) / 2;
+    jobs->Run(jobs->CreateChild(job, RangeJob, &upper, sizeof(upper)));
+    range.end = upper.begin;
+  }
+  range.function(range.begin, range.end, range.data);
+}
+
+}  // namespace
+
+/*
+ * Chase-Lev deque of a fixed size, with the memory orders of "Correct and
+ * Efficient Work-Stealing for Weak Memory Models" (Le et al., PPoPP 2013).
+ * Push() and Pop() by the owner only, Steal() from any thread.
+ */
+class JobSystem::JobDeque {
+ private:
+  static const int64_t kCapacity = JobSystem::kMaxJobs;
+
+  std::atomic<int64_t> top_;
+  std::atomic<int64_t> bottom_;
+  std::atomic<Job*> buffer_[kCapacity];
+
+ public:
+  JobDeque() : top_(0), bottom_(0) {}
+
+  // false when full
+  bool Push(Job* job) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    if (b - t >= kCapacity) return false;
+    buffer_[b & (kCapacity - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  Job* Pop() {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      // Empty
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return NULL;
+    }
+    Job* job = buffer_[b & (kCapacity - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+      // The last one, race the thieves for it
+      if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        job = NULL;
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+  }
+
+  Job* Steal() {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) return NULL;
+    Job* job = buffer_[t & (kCapacity - 1)].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return NULL;
+    }
+    return job;
+  }
+};
+
+struct JobSystem::WORKER {
+  JobDeque deque;
+  Job* jobs;  // ring of kMaxJobs
+  uint32_t next_job;
+  uint32_t victim;  // where stealing starts next
+  std::thread thread;
+};
+
+JobSystem::JobSystem()
+    : shared_jobs_(AllocateRing()),
+      shared_next_(0),
+      pending_(0),
+      sleeping_(0),
+      quit_(false) {}
+
+JobSystem::~JobSystem() {
+  Shutdown();
+  free(shared_jobs_);
+}
+
+Job* JobSystem::AllocateRing() {
+  void* memory = NULL;
+  if (posix_memalign(&memory, alignof(Job), sizeof(Job) * kMaxJobs) != 0) {
+    abort();
+  }
+  Job* ring = static_cast<Job*>(memory);
+  for (uint32_t i = 0; i < kMaxJobs; ++i) {
+    new (&ring[i]) Job();
+    ring[i].unfinished.store(0, std::memory_order_relaxed);
+  }
+  return ring;
+}
+
+CPU_TOPOLOGY JobSystem::GetCpuTopology() {
+  CPU_TOPOLOGY topology;
+  topology.cores = std::max(1L, sysconf(_SC_NPROCESSORS_CONF));
+  std::vector<uint32_t> frequencies(topology.cores);
+  uint32_t top = 0;
+  for (int32_t i = 0; i < topology.cores; ++i) {
+    char path[96];
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", i);
+    frequencies[i] = ReadSysfs(path);
+    top = std::max(top, frequencies[i]);
+  }
+  // Without cpufreq, as on most hosts, every core counts as fast
+  topology.fast_cores = 0;
+  for (int32_t i = 0; i < topology.cores; ++i) {
+    if (static_cast<uint64_t>(frequencies[i]) * 5 >=
+        static_cast<uint64_t>(top) * 4) {
+      ++topology.fast_cores;
+    }
+  }
+  return topology;
+}
+
+void JobSystem::Init(int32_t worker_count) {
+  Shutdown();
+  if (worker_count < 0) worker_count = GetCpuTopology().fast_cores - 1;
+  worker_count = std::min(worker_count, kMaxWorkers);
+  quit_ = false;
+  // All worker slots exist before any thread looks for a victim
+  for (int32_t i = 0; i < worker_count; ++i) {
+    WORKER* worker = new WORKER();
+    worker->jobs = AllocateRing();
+    worker->next_job = 0;
+    worker->victim = i + 1;
+    workers_.push_back(worker);
+  }
+  for (int32_t i = 0; i < worker_count; ++i) {
+    workers_[i]->thread = std::thread(&JobSystem::WorkerMain, this, i);
+  }
+}
+
+void JobSystem::Shutdown() {
+  if (workers_.empty()) return;
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    quit_ = true;
+  }
+  sleep_cond_.notify_all();
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    workers_[i]->thread.join();
+  }
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    free(workers_[i]->jobs);
+    delete workers_[i];
+  }
+  workers_.clear();
+  injected_.clear();
+  pending_.store(0);
+}
+
+Job* JobSystem::Allocate() {
+  for (uint32_t tries = 1;; ++tries) {
+    Job* job;
+    if (t_worker >= 0) {
+      WORKER* worker = workers_[t_worker];
+      job = &worker->jobs[worker->next_job++ & (kMaxJobs - 1)];
+    } else {
+      uint32_t index = shared_next_.fetch_add(1, std::memory_order_relaxed);
+      job = &shared_jobs_[index & (kMaxJobs - 1)];
+    }
+    if (job->unfinished.load(std::memory_order_acquire) == 0) {
+      job->parent = NULL;
+      job->unfinished.store(1, std::memory_order_relaxed);
+      return job;
+    }
+    // Skip jobs still in use; with the whole ring busy, help until one ends
+    if (tries % kMaxJobs == 0) {
+      Job* other = Take(t_worker);
+      if (other) {
+        Execute(other);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+}
+
+Job* JobSystem::Create(JobFunction function, const void* data, size_t size) {
+  if (size > Job::kDataSize) {
+    LOGE("JobSystem: %zu bytes of job data, at most %zu fit", size,
+         Job::kDataSize);
+    return NULL;
+  }
+  Job* job = Allocate();
+  job->function = function;
+  if (size) memcpy(job->data, data, size);
+  return job;
+}
+
+Job* JobSystem::CreateChild(Job* parent, JobFunction function,
+                            const void* data, size_t size) {
+  // Before the parent counts a child that never comes
+  if (size > Job::kDataSize) {
+    LOGE("JobSystem: %zu bytes of job data, at most %zu fit", size,
+         Job::kDataSize);
+    return NULL;
+  }
+  parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+  Job* job = Create(function, data, size);
+  job->parent = parent;
+  return job;
+}
+
+void JobSystem::Run(Job* job) {
+  if (workers_.empty()) {
+    // Nobody to hand it to; run it at once rather than in Wait()
+    Execute(job);
+    return;
+  }
+  pending_.fetch_add(1);
+  if (t_worker >= 0) {
+    if (!workers_[t_worker]->deque.Push(job)) {
+      pending_.fetch_sub(1);
+      Execute(job);
+      return;
+    }
+  } else {
+    std::lock_guard<std::mutex> lock(injected_mutex_);
+    injected_.push_back(job);
+  }
+  if (sleeping_.load() > 0) {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    sleep_cond_.notify_one();
+  }
+}
+
+Job* JobSystem::Take(int32_t worker) {
+  Job* job = NULL;
+  if (worker >= 0) job = workers_[worker]->deque.Pop();
+  if (!job && pending_.load(std::memory_order_relaxed) > 0) {
+    {
+      std::lock_guard<std::mutex> lock(injected_mutex_);
+      // Workers take the oldest, largest jobs like thieves. Other threads
+      // take the newest, like a deque owner, and so go depth first rather
+      // than splitting every range before running any.
+      if (!injected_.empty() && worker >= 0) {
+        job = injected_.front();
+        injected_.pop_front();
+      } else if (!injected_.empty()) {
+        job = injected_.back();
+        injected_.pop_back();
+      }
+    }
+    // Steal, starting from a different victim each time
+    int32_t count = static_cast<int32_t>(workers_.size());
+    uint32_t start = worker >= 0 ? workers_[worker]->victim++ : 0;
+    for (int32_t i = 0; i < count && !job; ++i) {
+      int32_t victim = (start + i) % count;
+      if (victim != worker) job = workers_[victim]->deque.Steal();
+    }
+  }
+  if (job) pending_.fetch_sub(1);
+  return job;
+}
+
+void JobSystem::Execute(Job* job) {
+  job->function(job, job->data);
+  Finish(job);
+}
+
+void JobSystem::Finish(Job* job) {
+  while (job) {
+    // Once its count drops to zero the job may be reused at once
+    Job* parent = job->parent;
+    if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) break;
+    job = parent;
+  }
+}
+
+void JobSystem::Wait(const Job* job) {
+  int32_t worker = t_worker;
+  while (!IsDone(job)) {
+    Job* other = Take(worker);
+    if (other) {
+      Execute(other);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void JobSystem::WorkerMain(int32_t index) {
+  t_worker = index;
+  int32_t idle = 0;
+  while (true) {
+    Job* job = Take(index);
+    if (job) {
+      Execute(job);
+      idle = 0;
+      continue;
+    }
+    if (++idle < kSpinCount) {
+      std::this_thread::yield();
+      continue;
+    }
+    // Run() sees sleeping_ raised before this checks pending_, so it either
+    // queued its job already or will notify under the mutex
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleeping_.fetch_add(1);
+    while (!quit_ && pending_.load() == 0) sleep_cond_.wait(lock);
+    sleeping_.fetch_sub(1);
+    if (quit_) break;
+    idle = 0;
+  }
+  t_worker = -1;
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t batch,
+                            RangeFunction function, void* data) {
+  if (count == 0) return;
+  batch = std::max(batch, 1u);
+  if (workers_.empty() || count <= batch) {
+    function(0, count, data);
+    return;
+  }
+  RANGE_JOB range = {function, data, 0, count, batch};
+  Job* root = Create(RangeJob, &range, sizeof(range));
+  Run(root);
+  Wait(root);
+}
+
+}  // namespace ndkHelper
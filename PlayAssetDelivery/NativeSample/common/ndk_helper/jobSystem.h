@@ -0,0 +1,156 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JOBSYSTEM_H_
+#define JOBSYSTEM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ndk_helper {
+
+struct Job;
+typedef void (*JobFunction)(Job* job, void* data);
+
+/*
+ * A unit of work. Its data is copied in at creation. A job is done once it
+ * and all of its children ran.
+ */
+struct alignas(64) Job {
+  static const size_t kDataSize = 40;
+
+  JobFunction function;
+  Job* parent;
+  std::atomic<int32_t> unfinished;  // itself plus unfinished children
+  uint8_t data[kDataSize];
+};
+
+struct CPU_TOPOLOGY {
+  int32_t cores;
+  // Cores of the fastest clusters, at least 80% of the top frequency
+  int32_t fast_cores;
+};
+
+/******************************************************************
+ * Work-stealing job scheduler
+ * Each worker thread has a Chase-Lev deque: it pushes and pops jobs at the
+ * bottom without locks while idle workers steal from the top. Jobs run
+ * from any other thread go to a shared queue and ring instead. Wait() runs
+ * other jobs until the one waited for is done, so no thread sits idle on a
+ * dependency and jobs can wait on their children.
+ * Jobs come from a ring per thread and are reused once done, never freed.
+ * A thread with kMaxJobs of its jobs unfinished runs others in Create()
+ * until one is done.
+ * Idle workers spin briefly, then sleep until a job is run.
+ */
+class JobSystem {
+ public:
+  static const int32_t kMaxWorkers = 16;
+  static const uint32_t kMaxJobs = 4096;  // per thread, a power of two
+
+  typedef void (*RangeFunction)(uint32_t begin, uint32_t end, void* data);
+
+ private:
+  class JobDeque;
+  struct WORKER;
+
+  std::vector<WORKER*> workers_;
+  // Jobs run by threads other than the workers, and their job ring
+  std::mutex injected_mutex_;
+  std::deque<Job*> injected_;
+  Job* shared_jobs_;
+  std::atomic<uint32_t> shared_next_;
+
+  // Jobs queued and not taken yet, sleeping workers wait for it
+  std::atomic<int32_t> pending_;
+  std::atomic<int32_t> sleeping_;
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cond_;
+  bool quit_;
+
+  static Job* AllocateRing();
+  Job* Allocate();
+  Job* Take(int32_t worker);
+  void Execute(Job* job);
+  void Finish(Job* job);
+  void WorkerMain(int32_t index);
+
+  JobSystem();
+  ~JobSystem();
+  JobSystem(const JobSystem& rhs);
+  JobSystem& operator=(const JobSystem& rhs);
+
+ public:
+  static JobSystem* GetInstance() {
+    // Singleton
+    static JobSystem instance;
+
+    return &instance;
+  }
+
+  /******************************************************************
+   * Start the worker threads
+   * By default one per fast core, less one for the thread that waits on
+   * the results; LITTLE cores would finish their share late and keep the
+   * others waiting, and they have the UI and system threads to run. With
+   * no workers every job runs in Wait().
+   *
+   * arguments:
+   *  in: worker_count, negative picks it from GetCpuTopology()
+   *
+   */
+  void Init(int32_t worker_count = -1);
+  // Stops the workers; jobs not run by then are dropped
+  void Shutdown();
+  int32_t GetWorkerCount() const {
+    return static_cast<int32_t>(workers_.size());
+  }
+  static CPU_TOPOLOGY GetCpuTopology();
+
+  // data is copied into the job. NULL, logged, if size is over
+  // Job::kDataSize.
+  Job* Create(JobFunction function, const void* data = NULL, size_t size = 0);
+  // parent isn't done before the child, it must not have finished yet
+  Job* CreateChild(Job* parent, JobFunction function, const void* data = NULL,
+                   size_t size = 0);
+  void Run(Job* job);
+  // Runs other jobs until job is done
+  void Wait(const Job* job);
+  bool IsDone(const Job* job) const {
+    return job->unfinished.load(std::memory_order_acquire) == 0;
+  }
+
+  /******************************************************************
+   * ParallelFor()
+   * Call function on ranges covering [0, count), none longer than batch,
+   * from any thread including the caller. The range is split in halves
+   * recursively so idle workers steal large pieces first.
+   * Returns once every range is done.
+   *
+   */
+  void ParallelFor(uint32_t count, uint32_t batch, RangeFunction function,
+                   void* data);
+};
+
+}  // namespace ndkHelper
+#endif /* JOBSYSTEM_H_ */
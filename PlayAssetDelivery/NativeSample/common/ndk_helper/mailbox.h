@@ -0,0 +1,76 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAILBOX_H_
+#define MAILBOX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+namespace ndk_helper {
+
+/******************************************************************
+ * Triple buffered mailbox from one producer thread to one consumer thread
+ * The producer fills BeginWrite() and publishes it with EndWrite(); an
+ * older value not read yet is dropped. The consumer takes the newest value
+ * with Acquire(), which keeps returning the same one until a newer value
+ * is published. Neither side ever waits: each owns one slot at all times
+ * and the third is swapped between them with a single atomic exchange.
+ * Slots are reused, so values keep their allocations from one use to the
+ * next.
+ */
+template <typename T>
+class Mailbox {
+ private:
+  static const uint32_t kIndexMask = 3;
+  static const uint32_t kFresh = 4;  // the shared slot hasn't been read
+
+  T slots_[3];
+  std::atomic<uint32_t> shared_;
+  uint32_t write_;  // producer's slot
+  uint32_t read_;   // consumer's slot
+  bool has_value_;  // consumer side, something was acquired
+
+  Mailbox(const Mailbox& rhs);
+  Mailbox& operator=(const Mailbox& rhs);
+
+ public:
+  Mailbox() : shared_(1), write_(0), read_(2), has_value_(false) {}
+
+  // Producer
+  T* BeginWrite() { return &slots_[write_]; }
+  void EndWrite() {
+    write_ = shared_.exchange(write_ | kFresh, std::memory_order_acq_rel) &
+             kIndexMask;
+  }
+
+  // Consumer. NULL until the first value is published.
+  const T* Acquire() {
+    // Only the consumer clears kFresh, so it can't be gone by the exchange
+    if (shared_.load(std::memory_order_relaxed) & kFresh) {
+      read_ = shared_.exchange(read_, std::memory_order_acq_rel) & kIndexMask;
+      has_value_ = true;
+    }
+    return Peek();
+  }
+  // The value of the last Acquire()
+  const T* Peek() const { return has_value_ ? &slots_[read_] : NULL; }
+};
+
+}  // namespace ndkHelper
+#endif /* MAILBOX_H_ */
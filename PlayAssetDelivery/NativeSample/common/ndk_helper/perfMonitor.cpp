@@ -16,15 +16,88 @@
 
 #include "perfMonitor.h"
 
+#include <string.h>
+
 namespace ndk_helper {
 
+namespace {
+// Gaps longer than this are the app being idle or paused, not slow frames
+const int64_t kIdleThresholdNs = 1000000000LL;
+const int64_t kDefaultRefreshPeriodNs = 1000000000LL / 60;
+
+const char* const kMetricNames[FRAME_METRIC_COUNT] = {
+    "CPU frame time", "Swap interval", "Input latency",
+};
+}  // namespace
+
+//--------------------------------------------------------------------------------
+// FrameHistogram
+//--------------------------------------------------------------------------------
+int32_t FrameHistogram::BucketIndex(uint64_t us) {
+  if (us < 2 * kSubBuckets) return static_cast<int32_t>(us);
+  int32_t msb = 63 - __builtin_clzll(us);
+  int32_t shift = msb - kSubBucketBits;
+  if (shift > kMaxShift) return kNumBuckets - 1;
+  // mantissa is in [kSubBuckets, 2 * kSubBuckets)
+  return shift * kSubBuckets + static_cast<int32_t>(us >> shift);
+}
+
+uint64_t FrameHistogram::BucketValue(int32_t index) {
+  if (index < 2 * kSubBuckets) return index;
+  int32_t shift = index / kSubBuckets - 1;
+  uint64_t mantissa = index - shift * kSubBuckets;
+  return ((mantissa + 1) << shift) - 1;
+}
+
+void FrameHistogram::Record(int64_t ns) {
+  if (ns < 0) ns = 0;
+  ++counts_[BucketIndex(ns / 1000)];
+  ++count_;
+  sum_ns_ += ns;
+  if (ns > max_ns_) max_ns_ = ns;
+}
+
+void FrameHistogram::Reset() {
+  for (int32_t i = 0; i < kNumBuckets; ++i) counts_[i] = 0;
+  count_ = 0;
+  max_ns_ = 0;
+  sum_ns_ = 0;
+}
+
+int64_t FrameHistogram::GetPercentile(double fraction) const {
+  if (!count_) return 0;
+  uint64_t target = static_cast<uint64_t>(fraction * count_ + 0.999999);
+  if (target < 1) target = 1;
+  uint64_t seen = 0;
+  for (int32_t i = 0; i < kNumBuckets; ++i) {
+    seen += counts_[i];
+    if (seen >= target) {
+      int64_t ns = static_cast<int64_t>(BucketValue(i)) * 1000 + 999;
+      return ns < max_ns_ ? ns : max_ns_;
+    }
+  }
+  return max_ns_;
+}
+
+//--------------------------------------------------------------------------------
+// PerfMonitor
+//--------------------------------------------------------------------------------
 PerfMonitor::PerfMonitor()
     : current_FPS_(0),
-      tv_last_sec_(0),
+      last_fps_ns_(0),
       last_tick_(0.f),
       tickindex_(0),
-      ticksum_(0) {
+      ticksum_(0),
+      frame_start_ns_(0),
+      last_frame_end_ns_(0),
+      first_input_ns_(0),
+      refresh_period_ns_(kDefaultRefreshPeriodNs),
+      missed_vsyncs_(0) {
   for (int32_t i = 0; i < kNumSamples; ++i) ticklist_[i] = 0;
+  for (int32_t i = 0; i < FRAME_METRIC_COUNT; ++i) {
+    metric_names_[i] = kMetricNames[i];
+  }
+  metric_count_ = FRAME_METRIC_COUNT;
 }
 
 PerfMonitor::~PerfMonitor() {}
@@ -39,17 +112,16 @@ double PerfMonitor::UpdateTick(double currentTick) {
 }
 
 bool PerfMonitor::Update(float &fFPS) {
-  struct timeval Time;
-  gettimeofday(&Time, NULL);
+  int64_t now = GetCurrentTimeNs();
 
-  double time = Time.tv_sec + Time.tv_usec * 1.0 / 1000000.0;
+  double time = now * 1e-9;
   double tick = time - last_tick_;
   double d = UpdateTick(tick);
   last_tick_ = time;
 
-  if (Time.tv_sec - tv_last_sec_ >= 1) {
+  if (now - last_fps_ns_ >= 1000000000LL) {
     current_FPS_ = 1.f / d;
-    tv_last_sec_ = Time.tv_sec;
+    last_fps_ns_ = now;
     fFPS = current_FPS_;
     return true;
   } else {
@@ -58,4 +130,67 @@ bool PerfMonitor::Update(float &fFPS) {
   }
 }
 
+void PerfMonitor::BeginFrame() { frame_start_ns_ = GetCurrentTimeNs(); }
+
+void PerfMonitor::EndFrame() {
+  int64_t now = GetCurrentTimeNs();
+  if (frame_start_ns_) {
+    histograms_[FRAME_METRIC_CPU].Record(now - frame_start_ns_);
+    frame_start_ns_ = 0;
+  }
+
+  int64_t interval = now - last_frame_end_ns_;
+  if (last_frame_end_ns_ && interval < kIdleThresholdNs) {
+    histograms_[FRAME_METRIC_SWAP_INTERVAL].Record(interval);
+    // Past one and a half periods the frame missed a vsync, every further
+    // period another one
+    if (interval * 2 > refresh_period_ns_ * 3) {
+      missed_vsyncs_ += static_cast<uint32_t>(
+          (interval + refresh_period_ns_ / 2) / refresh_period_ns_ - 1);
+    }
+  }
+  last_frame_end_ns_ = now;
+
+  if (first_input_ns_) {
+    histograms_[FRAME_METRIC_INPUT_LATENCY].Record(now - first_input_ns_);
+    first_input_ns_ = 0;
+  }
+}
+
+void PerfMonitor::RecordInput(int64_t event_time_ns) {
+  // The oldest event not shown yet waited the longest
+  if (!first_input_ns_) first_input_ns_ = event_time_ns;
+}
+
+int32_t PerfMonitor::AddMetric(const char *name) {
+  for (int32_t i = 0; i < metric_count_; ++i) {
+    if (!strcmp(metric_names_[i], name)) return i;
+  }
+  if (metric_count_ == kMaxFrameMetrics) return -1;
+  metric_names_[metric_count_] = name;
+  return metric_count_++;
+}
+
+void PerfMonitor::Dump() const {
+  for (int32_t i = 0; i < metric_count_; ++i) {
+    const FrameHistogram &histogram = histograms_[i];
+    LOGI("%s: %u samples, mean %.2f ms, p50 %.2f ms, p90 %.2f ms, "
+         "p99 %.2f ms, max %.2f ms",
+         metric_names_[i], histogram.GetCount(), histogram.GetMean() * 1e-6,
+         histogram.GetPercentile(0.5) * 1e-6,
+         histogram.GetPercentile(0.9) * 1e-6,
+         histogram.GetPercentile(0.99) * 1e-6, histogram.GetMax() * 1e-6);
+  }
+  LOGI("Missed vsyncs: %u at %.2f ms refresh period", missed_vsyncs_,
+       refresh_period_ns_ * 1e-6);
+}
+
+void PerfMonitor::ResetStats() {
+  for (int32_t i = 0; i < metric_count_; ++i) histograms_[i].Reset();
+  frame_start_ns_ = 0;
+  last_frame_end_ns_ = 0;
+  first_input_ns_ = 0;
+  missed_vsyncs_ = 0;
+}
+
 }  // namespace ndkHelper
@@ -19,6 +19,7 @@
 
 #include <jni.h>
 #include <errno.h>
+#include <stdint.h>
 #include <time.h>
 #include "JNIHelper.h"
 
@@ -26,19 +27,80 @@ namespace ndk_helper {
 
 const int32_t kNumSamples = 100;
 
+/******************************************************************
+ * Log-bucketed histogram of durations, HDR histogram style
+ * Values are kept in microseconds: exactly below 64us, then 32 linear
+ * buckets per power of two, so any percentile is within ~3% of the real
+ * value. Storage is fixed, Record() never allocates. Values above ~67s
+ * land in the last bucket; the exact maximum is kept aside.
+ */
+class FrameHistogram {
+ public:
+  static const int32_t kSubBucketBits = 5;
+  static const int32_t kSubBuckets = 1 << kSubBucketBits;
+  static const int32_t kMaxShift = 21;
+  static const int32_t kNumBuckets = 2 * kSubBuckets + kMaxShift * kSubBuckets;
+
+ private:
+  uint32_t counts_[kNumBuckets];
+  uint32_t count_;
+  int64_t max_ns_;
+  int64_t sum_ns_;
+
+  static int32_t BucketIndex(uint64_t us);
+  static uint64_t BucketValue(int32_t index);
+
+ public:
+  FrameHistogram() { Reset(); }
+
+  void Record(int64_t ns);
+  void Reset();
+
+  uint32_t GetCount() const { return count_; }
+  int64_t GetMax() const { return max_ns_; }
+  int64_t GetMean() const { return count_ ? sum_ns_ / count_ : 0; }
+  // Highest value of the bucket holding the given fraction, in ns
+  int64_t GetPercentile(double fraction) const;
+};
+
+// Built-in metrics, AddMetric() appends more up to kMaxFrameMetrics
+enum FRAME_METRIC {
+  FRAME_METRIC_CPU,             // BeginFrame() to EndFrame()
+  FRAME_METRIC_SWAP_INTERVAL,   // EndFrame() to EndFrame()
+  FRAME_METRIC_INPUT_LATENCY,   // input event to the end of the next frame
+  FRAME_METRIC_COUNT,
+};
+
+const int32_t kMaxFrameMetrics = 8;
+
 /******************************************************************
  * Helper class for a performance monitoring and get current tick time
+ * Besides the FPS counter, BeginFrame()/EndFrame() around each frame feed
+ * frame time histograms and count missed vsyncs; Dump() logs
+ * p50/p90/p99/max. Nothing allocates per frame, so it can stay on in
+ * release builds.
+ * "Present" is when eglSwapBuffers() returned, the display may show the
+ * frame later.
  */
 class PerfMonitor {
  private:
   float current_FPS_;
-  time_t tv_last_sec_;
+  int64_t last_fps_ns_;
 
   double last_tick_;
   int32_t tickindex_;
   double ticksum_;
   double ticklist_[kNumSamples];
 
+  FrameHistogram histograms_[kMaxFrameMetrics];
+  const char *metric_names_[kMaxFrameMetrics];
+  int32_t metric_count_;
+  int64_t frame_start_ns_;
+  int64_t last_frame_end_ns_;
+  int64_t first_input_ns_;
+  int64_t refresh_period_ns_;
+  uint32_t missed_vsyncs_;
+
   double UpdateTick(double current_tick);
 
  public:
@@ -47,12 +109,38 @@ class PerfMonitor {
 
   bool Update(float &fFPS);
 
-  static double GetCurrentTime() {
-    struct timeval time;
-    gettimeofday(&time, NULL);
-    double ret = time.tv_sec + time.tv_usec * 1.0 / 1000000.0;
-    return ret;
+  // Frame statistics
+  void BeginFrame();
+  void EndFrame();
+  // Event time of an input event, e.g. AMotionEvent_getEventTime()
+  void RecordInput(int64_t event_time_ns);
+  // Display refresh period, for missed vsyncs. Defaults to 60Hz.
+  void SetRefreshPeriod(int64_t period_ns) { refresh_period_ns_ = period_ns; }
+  /*
+   * Extra duration metric reported with the built-in ones, e.g. GPU time of
+   * a pass. name must outlive the monitor. Returns the existing metric for
+   * a known name, -1 when all slots are used.
+   */
+  int32_t AddMetric(const char *name);
+  void RecordMetric(int32_t metric, int64_t ns) {
+    histograms_[metric].Record(ns);
+  }
+  const FrameHistogram &GetHistogram(int32_t metric) const {
+    return histograms_[metric];
   }
+  uint32_t GetMissedVsyncs() const { return missed_vsyncs_; }
+  void Dump() const;
+  void ResetStats();
+
+  // CLOCK_MONOTONIC, the clock of input event times
+  static int64_t GetCurrentTimeNs() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<int64_t>(time.tv_sec) * 1000000000LL + time.tv_nsec;
+  }
+
+  // Seconds, for intervals
+  static double GetCurrentTime() { return GetCurrentTimeNs() * 1e-9; }
 };
 
 }  // namespace ndkHelper
@@ -0,0 +1,379 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "programBuilder.h"
+
+#include <atomic>
+#include <vector>
+
+#include "GLContext.h"
+#include "JNIHelper.h"
+#include "shader.h"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace ndk_helper {
+
+namespace {
+// Job states besides PROGRAM_STATUS
+const int kStateRetry = 3;      // the worker has no context, build in Poll()
+const int kStateAbandoned = 4;  // the future was dropped while pending
+
+void LogInfo(GLuint object, bool program) {
+  GLint length = 0;
+  if (program) {
+    glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+  } else {
+    glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+  }
+  if (length <= 0) return;
+  std::vector<GLchar> log(length);
+  if (program) {
+    glGetProgramInfoLog(object, length, &length, &log[0]);
+  } else {
+    glGetShaderInfoLog(object, length, &length, &log[0]);
+  }
+  LOGI("%s log:\n%s", program ? "Program link" : "Shader compile", &log[0]);
+}
+}  // namespace
+
+struct PROGRAM_JOB {
+  PROGRAM_SOURCE source;
+  std::string name;  // for logs
+  GLuint program;
+  GLuint shaders[2];  // only kept while the driver compiles in parallel
+  bool parallel;
+  bool finished;  // reflected and stored
+  PROGRAM_REFLECTION reflection;
+  // PROGRAM_STATUS or kState*, handed between the worker and the GL thread
+  std::atomic<int> state;
+};
+
+//--------------------------------------------------------------------------------
+// ProgramFuture
+//--------------------------------------------------------------------------------
+ProgramFuture& ProgramFuture::operator=(ProgramFuture&& rhs) {
+  if (this != &rhs) {
+    Reset();
+    job_ = std::move(rhs.job_);
+  }
+  return *this;
+}
+
+PROGRAM_STATUS ProgramFuture::Poll() {
+  if (!job_) return PROGRAM_FAILED;
+  return ProgramBuilder::GetInstance()->Poll(job_.get());
+}
+
+GLuint ProgramFuture::Get(PROGRAM_REFLECTION* reflection) {
+  if (Poll() != PROGRAM_READY) return 0;
+  GLuint program = job_->program;
+  *reflection = job_->reflection;
+  job_->program = 0;
+  job_.reset();
+  return program;
+}
+
+void ProgramFuture::Reset() {
+  if (!job_) return;
+  PROGRAM_JOB* job = job_.get();
+  int expected = PROGRAM_PENDING;
+  if (!job->parallel &&
+      job->state.compare_exchange_strong(expected, kStateAbandoned)) {
+    // Still queued or on the worker, which deletes the program when done
+    job_.reset();
+    return;
+  }
+  if (job->parallel) {
+    // Deleting a program the driver is still linking is fine
+    for (int i = 0; i < 2; ++i) {
+      if (job->shaders[i]) glDeleteShader(job->shaders[i]);
+    }
+  }
+  if (job->program) glDeleteProgram(job->program);
+  job_.reset();
+}
+
+//--------------------------------------------------------------------------------
+// ProgramBuilder
+//--------------------------------------------------------------------------------
+ProgramBuilder::ProgramBuilder()
+    : initialized_(false),
+      main_context_(EGL_NO_CONTEXT),
+      parallel_(false),
+      display_(EGL_NO_DISPLAY),
+      worker_context_(EGL_NO_CONTEXT),
+      worker_surface_(EGL_NO_SURFACE),
+      worker_failed_(false),
+      quit_(false) {}
+
+ProgramBuilder::~ProgramBuilder() { Shutdown(); }
+
+void ProgramBuilder::Init() {
+  GLContext* context = GLContext::GetInstance();
+  if (initialized_ && main_context_ == context->GetContext()) return;
+  // First use, or the context was recreated since
+  Shutdown();
+  initialized_ = true;
+  main_context_ = context->GetContext();
+  worker_failed_ = false;
+
+  parallel_ = false;
+  if (context->CheckExtension("GL_KHR_parallel_shader_compile")) {
+    MaxShaderCompilerThreadsProc max_threads =
+        reinterpret_cast<MaxShaderCompilerThreadsProc>(
+            eglGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+    if (max_threads) {
+      // Let the driver pick the number of threads
+      max_threads(0xFFFFFFFF);
+      parallel_ = true;
+    }
+  }
+  LOGI("Programs build %s",
+       parallel_ ? "on driver threads" : "on a worker thread");
+}
+
+void ProgramBuilder::StartWorker() {
+  if (worker_.joinable() || worker_failed_) return;
+  GLContext* context = GLContext::GetInstance();
+  if (!context->CreateSharedContext(&worker_context_, &worker_surface_)) {
+    LOGW("No shared context, programs build on the GL thread");
+    worker_failed_ = true;
+    return;
+  }
+  display_ = context->GetDisplay();
+  quit_ = false;
+  worker_ = std::thread(&ProgramBuilder::WorkerMain, this);
+}
+
+void ProgramBuilder::Shutdown() {
+  if (worker_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      quit_ = true;
+    }
+    cond_.notify_one();
+    worker_.join();
+  }
+  // Jobs that never started can't finish with this context
+  for (size_t i = 0; i < jobs_.size(); ++i) {
+    int expected = PROGRAM_PENDING;
+    jobs_[i]->state.compare_exchange_strong(expected, PROGRAM_FAILED);
+  }
+  jobs_.clear();
+  if (worker_context_ != EGL_NO_CONTEXT) {
+    GLContext::GetInstance()->DestroySharedContext(worker_context_,
+                                                   worker_surface_);
+    worker_context_ = EGL_NO_CONTEXT;
+    worker_surface_ = EGL_NO_SURFACE;
+  }
+  initialized_ = false;
+}
+
+void ProgramBuilder::WorkerMain() {
+  bool current = eglMakeCurrent(display_, worker_surface_, worker_surface_,
+                                worker_context_) == EGL_TRUE;
+  if (!current) LOGW("Unable to eglMakeCurrent on the shader worker");
+
+  while (true) {
+    std::shared_ptr<PROGRAM_JOB> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this] { return quit_ || !jobs_.empty(); });
+      if (quit_) break;
+      job = jobs_.front();
+      jobs_.pop_front();
+    }
+    if (job->state.load() == kStateAbandoned) continue;
+
+    int result = kStateRetry;
+    if (current) {
+      result = Link(job.get()) ? PROGRAM_READY : PROGRAM_FAILED;
+      // The GL thread may only use the program once it is complete
+      glFinish();
+    }
+    int expected = PROGRAM_PENDING;
+    if (!job->state.compare_exchange_strong(expected, result) &&
+        job->program) {
+      glDeleteProgram(job->program);
+      job->program = 0;
+    }
+  }
+
+  if (current) {
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  }
+}
+
+bool ProgramBuilder::Link(PROGRAM_JOB* job) {
+  const PROGRAM_SOURCE& source = job->source;
+  GLuint vert_shader, frag_shader;
+  if (!shader::CompileShader(&vert_shader, GL_VERTEX_SHADER,
+                             source.vsh.c_str(), source.vsh.size())) {
+    LOGI("Failed to compile vertex shader of %s", job->name.c_str());
+    return false;
+  }
+  if (!shader::CompileShader(&frag_shader, GL_FRAGMENT_SHADER,
+                             source.fsh.c_str(), source.fsh.size())) {
+    LOGI("Failed to compile fragment shader of %s", job->name.c_str());
+    glDeleteShader(vert_shader);
+    return false;
+  }
+
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vert_shader);
+  glAttachShader(program, frag_shader);
+  for (std::map<std::string, GLint>::const_iterator it =
+           source.attributes.begin();
+       it != source.attributes.end(); ++it) {
+    glBindAttribLocation(program, it->second, it->first.c_str());
+  }
+  ProgramCache::GetInstance()->SetRetrievable(source, program);
+
+  bool linked = shader::LinkProgram(program);
+  glDeleteShader(vert_shader);
+  glDeleteShader(frag_shader);
+  if (!linked) {
+    LOGI("Failed to link %s", job->name.c_str());
+    glDeleteProgram(program);
+    return false;
+  }
+  job->program = program;
+  return true;
+}
+
+/*
+ * Queue everything without asking for a status, any query before
+ * GL_COMPLETION_STATUS_KHR turns true would wait for the driver.
+ */
+void ProgramBuilder::StartParallel(PROGRAM_JOB* job) {
+  const PROGRAM_SOURCE& source = job->source;
+  const GLenum types[2] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+  const std::string* sources[2] = {&source.vsh, &source.fsh};
+  job->program = glCreateProgram();
+  for (int i = 0; i < 2; ++i) {
+    const GLchar* str = sources[i]->c_str();
+    GLint size = sources[i]->size();
+    job->shaders[i] = glCreateShader(types[i]);
+    glShaderSource(job->shaders[i], 1, &str, &size);
+    glCompileShader(job->shaders[i]);
+    glAttachShader(job->program, job->shaders[i]);
+  }
+  for (std::map<std::string, GLint>::const_iterator it =
+           source.attributes.begin();
+       it != source.attributes.end(); ++it) {
+    glBindAttribLocation(job->program, it->second, it->first.c_str());
+  }
+  ProgramCache::GetInstance()->SetRetrievable(source, job->program);
+  glLinkProgram(job->program);
+}
+
+ProgramFuture ProgramBuilder::Build(
+    const char* vsh_file, const char* fsh_file,
+    const std::map<std::string, std::string>& parameters,
+    const std::map<std::string, GLint>& attributes) {
+  Init();
+
+  ProgramFuture future;
+  std::shared_ptr<PROGRAM_JOB> job = std::make_shared<PROGRAM_JOB>();
+  job->name = std::string(vsh_file) + "+" + fsh_file;
+  job->program = 0;
+  job->shaders[0] = job->shaders[1] = 0;
+  job->parallel = parallel_;
+  job->finished = false;
+  job->state.store(PROGRAM_PENDING);
+
+  ProgramCache* cache = ProgramCache::GetInstance();
+  if (!cache->Prepare(vsh_file, fsh_file, parameters, attributes,
+                      &job->source)) {
+    return future;
+  }
+  future.job_ = job;
+
+  job->program = cache->LoadBinary(job->source, &job->reflection);
+  if (job->program) {
+    job->parallel = false;
+    job->finished = true;
+    job->state.store(PROGRAM_READY);
+    return future;
+  }
+
+  if (parallel_) {
+    StartParallel(job.get());
+    return future;
+  }
+
+  StartWorker();
+  if (worker_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      jobs_.push_back(job);
+    }
+    cond_.notify_one();
+  } else {
+    job->state.store(kStateRetry);
+  }
+  return future;
+}
+
+PROGRAM_STATUS ProgramBuilder::Poll(PROGRAM_JOB* job) {
+  int state = job->state.load();
+  if (state == PROGRAM_PENDING && job->parallel) {
+    GLint done = GL_FALSE;
+    glGetProgramiv(job->program, GL_COMPLETION_STATUS_KHR, &done);
+    if (!done) return PROGRAM_PENDING;
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(job->program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+      LOGI("Failed to link %s", job->name.c_str());
+      for (int i = 0; i < 2; ++i) LogInfo(job->shaders[i], false);
+      LogInfo(job->program, true);
+    }
+    for (int i = 0; i < 2; ++i) {
+      glDetachShader(job->program, job->shaders[i]);
+      glDeleteShader(job->shaders[i]);
+      job->shaders[i] = 0;
+    }
+    if (!linked) {
+      glDeleteProgram(job->program);
+      job->program = 0;
+    }
+    state = linked ? PROGRAM_READY : PROGRAM_FAILED;
+    job->state.store(state);
+  } else if (state == kStateRetry) {
+    // No worker context, build here rather than never
+    LOGI("Building %s on the GL thread", job->name.c_str());
+    state = Link(job) ? PROGRAM_READY : PROGRAM_FAILED;
+    job->state.store(state);
+  }
+
+  if (state == PROGRAM_READY && !job->finished) Finish(job);
+  return state == PROGRAM_READY || state == PROGRAM_FAILED
+             ? static_cast<PROGRAM_STATUS>(state)
+             : PROGRAM_PENDING;
+}
+
+void ProgramBuilder::Finish(PROGRAM_JOB* job) {
+  job->finished = true;
+  ProgramCache::Reflect(job->program, &job->reflection);
+  ProgramCache::GetInstance()->StoreBinary(job->source, job->program,
+                                           job->reflection);
+}
+
+}  // namespace ndkHelper
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROGRAMBUILDER_H_
+#define PROGRAMBUILDER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include "programCache.h"
+
+namespace ndk_helper {
+
+enum PROGRAM_STATUS {
+  PROGRAM_PENDING,
+  PROGRAM_READY,
+  PROGRAM_FAILED,
+};
+
+struct PROGRAM_JOB;
+
+/******************************************************************
+ * Handle to a program being built by ProgramBuilder
+ * Poll() once per frame; it never waits for the driver. Once it returns
+ * PROGRAM_READY, Get() hands the linked program over to the caller.
+ * Dropping or resetting the handle before that deletes the program when it
+ * is done.
+ */
+class ProgramFuture {
+ private:
+  std::shared_ptr<PROGRAM_JOB> job_;
+
+  friend class ProgramBuilder;
+
+ public:
+  ProgramFuture() {}
+  ~ProgramFuture() { Reset(); }
+  ProgramFuture(const ProgramFuture& rhs) = delete;
+  ProgramFuture& operator=(const ProgramFuture& rhs) = delete;
+  ProgramFuture(ProgramFuture&& rhs) : job_(std::move(rhs.job_)) {}
+  ProgramFuture& operator=(ProgramFuture&& rhs);
+
+  bool IsValid() const { return job_ != nullptr; }
+  PROGRAM_STATUS Poll();
+  // Linked program and its locations, 0 unless Poll() returned READY
+  GLuint Get(PROGRAM_REFLECTION* reflection);
+  void Reset();
+};
+
+/******************************************************************
+ * Non-blocking program builder
+ * Build() goes through ProgramCache and returns at once:
+ * - a cached binary is ready immediately
+ * - with GL_KHR_parallel_shader_compile, compiling and linking run on the
+ *   driver's threads and Poll() checks GL_COMPLETION_STATUS_KHR
+ * - otherwise a worker thread with a shared EGL context compiles and links
+ * - without a shared context either, Poll() compiles synchronously
+ * Finished programs are reflected and stored in the cache on the GL thread.
+ * Call Shutdown() before the EGL display is terminated; a new context is
+ * also picked up on the next Build().
+ * GL thread only.
+ */
+class ProgramBuilder {
+ private:
+  typedef void (*MaxShaderCompilerThreadsProc)(GLuint);
+
+  bool initialized_;
+  EGLContext main_context_;
+  bool parallel_;
+
+  // Worker thread and its context
+  EGLDisplay display_;
+  EGLContext worker_context_;
+  EGLSurface worker_surface_;
+  bool worker_failed_;
+  std::thread worker_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<std::shared_ptr<PROGRAM_JOB> > jobs_;
+  bool quit_;
+
+  void Init();
+  void StartWorker();
+  void WorkerMain();
+  static bool Link(PROGRAM_JOB* job);
+  void StartParallel(PROGRAM_JOB* job);
+  PROGRAM_STATUS Poll(PROGRAM_JOB* job);
+  void Finish(PROGRAM_JOB* job);
+
+  ProgramBuilder();
+  ~ProgramBuilder();
+  ProgramBuilder(const ProgramBuilder& rhs);
+  ProgramBuilder& operator=(const ProgramBuilder& rhs);
+
+  friend class ProgramFuture;
+
+ public:
+  static ProgramBuilder* GetInstance() {
+    // Singleton
+    static ProgramBuilder instance;
+
+    return &instance;
+  }
+
+  /******************************************************************
+   * Build()
+   *
+   * arguments:
+   *  in: vsh_file, fsh_file, parameters, attributes, see ProgramCache::Load()
+   * return: handle to poll, invalid if a shader file can't be read
+   *
+   */
+  ProgramFuture Build(const char* vsh_file, const char* fsh_file,
+                      const std::map<std::string, std::string>& parameters,
+                      const std::map<std::string, GLint>& attributes);
+
+  // Stop the worker and release its context
+  void Shutdown();
+};
+
+}  // namespace ndkHelper
+#endif /* PROGRAMBUILDER_H_ */
@@ -0,0 +1,397 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "programCache.h"
+
+#include <EGL/egl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <vector>
+
+#include "../third_party/gl3stub.h"
+#include "GLContext.h"
+#include "JNIHelper.h"
+#include "shader.h"
+#include "shaderPreprocessor.h"
+
+namespace ndk_helper {
+
+namespace {
+
+const uint32_t kProgramCacheMagic = 0x42435050;  // "PPCB"
+const uint32_t kProgramCacheVersion = 1;
+
+/*
+ * File layout: header, then uniform_count + attribute_count locations, each
+ * an int32_t location, a uint32_t name length and the name, then the binary.
+ * The checksum covers everything after the header.
+ */
+struct PROGRAM_CACHE_HEADER {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint64_t checksum;
+  uint32_t binary_format;
+  uint32_t binary_size;
+  uint32_t uniform_count;
+  uint32_t attribute_count;
+};
+
+// FNV-1a, good enough to tell sources apart and to catch torn writes
+const uint64_t kFnvOffset = 14695981039346656037ULL;
+
+uint64_t Hash(uint64_t hash, const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+uint64_t Hash(uint64_t hash, const std::string& str) {
+  // The terminator keeps "ab"+"c" and "a"+"bc" apart
+  return Hash(hash, str.c_str(), str.size() + 1);
+}
+
+void AppendLocations(std::vector<uint8_t>* out,
+                     const std::map<std::string, GLint>& locations) {
+  for (std::map<std::string, GLint>::const_iterator it = locations.begin();
+       it != locations.end(); ++it) {
+    int32_t location = it->second;
+    uint32_t length = it->first.size();
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&location);
+    out->insert(out->end(), p, p + sizeof(location));
+    p = reinterpret_cast<const uint8_t*>(&length);
+    out->insert(out->end(), p, p + sizeof(length));
+    out->insert(out->end(), it->first.begin(), it->first.end());
+  }
+}
+
+bool ReadLocations(const uint8_t** data, const uint8_t* end, uint32_t count,
+                   std::map<std::string, GLint>* locations) {
+  for (uint32_t i = 0; i < count; ++i) {
+    int32_t location;
+    uint32_t length;
+    if (end - *data < static_cast<ptrdiff_t>(sizeof(location) + sizeof(length)))
+      return false;
+    memcpy(&location, *data, sizeof(location));
+    memcpy(&length, *data + sizeof(location), sizeof(length));
+    *data += sizeof(location) + sizeof(length);
+    if (static_cast<size_t>(end - *data) < length) return false;
+    (*locations)[std::string(*data, *data + length)] = location;
+    *data += length;
+  }
+  return true;
+}
+
+}  // namespace
+
+GLint PROGRAM_REFLECTION::GetUniform(const char* name) const {
+  std::map<std::string, GLint>::const_iterator it = uniforms.find(name);
+  return it != uniforms.end() ? it->second : -1;
+}
+
+GLint PROGRAM_REFLECTION::GetAttribute(const char* name) const {
+  std::map<std::string, GLint>::const_iterator it = attributes.find(name);
+  return it != attributes.end() ? it->second : -1;
+}
+
+void ProgramCache::Reflect(GLuint program, PROGRAM_REFLECTION* reflection) {
+  reflection->uniforms.clear();
+  reflection->attributes.clear();
+
+  GLint count = 0;
+  GLint max_length = 0;
+  glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+  std::vector<GLchar> name(max_length + 1);
+  for (GLint i = 0; i < count; ++i) {
+    GLsizei length = 0;
+    GLint size;
+    GLenum type;
+    glGetActiveUniform(program, i, name.size(), &length, &size, &type,
+                       &name[0]);
+    std::string str(&name[0], length);
+    GLint location = glGetUniformLocation(program, str.c_str());
+    reflection->uniforms[str] = location;
+    // Arrays are reported as "name[0]", also accept the plain name
+    if (str.size() > 3 && str.compare(str.size() - 3, 3, "[0]") == 0) {
+      reflection->uniforms[str.substr(0, str.size() - 3)] = location;
+    }
+  }
+
+  count = 0;
+  max_length = 0;
+  glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+  glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+  name.resize(max_length + 1);
+  for (GLint i = 0; i < count; ++i) {
+    GLsizei length = 0;
+    GLint size;
+    GLenum type;
+    glGetActiveAttrib(program, i, name.size(), &length, &size, &type,
+                      &name[0]);
+    std::string str(&name[0], length);
+    reflection->attributes[str] = glGetAttribLocation(program, str.c_str());
+  }
+}
+
+ProgramCache::ProgramCache()
+    : initialized_(false),
+      get_program_binary_(NULL),
+      program_binary_(NULL),
+      es3_(false) {}
+
+void ProgramCache::Init() {
+  if (initialized_) return;
+  initialized_ = true;
+
+  // Binaries are only valid for the driver that produced them
+  driver_ = std::string(reinterpret_cast<const char*>(glGetString(GL_VENDOR))) +
+            "|" + reinterpret_cast<const char*>(glGetString(GL_RENDERER)) +
+            "|" + reinterpret_cast<const char*>(glGetString(GL_VERSION));
+
+  GLContext* context = GLContext::GetInstance();
+  es3_ = context->GetGLVersion() >= 3.0f;
+  if (es3_) {
+    get_program_binary_ =
+        reinterpret_cast<GetProgramBinaryProc>(glGetProgramBinary);
+    program_binary_ = reinterpret_cast<ProgramBinaryProc>(glProgramBinary);
+  } else if (context->CheckExtension("GL_OES_get_program_binary")) {
+    get_program_binary_ = reinterpret_cast<GetProgramBinaryProc>(
+        eglGetProcAddress("glGetProgramBinaryOES"));
+    program_binary_ = reinterpret_cast<ProgramBinaryProc>(
+        eglGetProcAddress("glProgramBinaryOES"));
+  }
+
+  // Some drivers expose the entry points but no format to store
+  GLint formats = 0;
+  if (get_program_binary_ && program_binary_) {
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  }
+  if (formats <= 0) {
+    LOGI("Program binaries are not supported, shaders compile every time");
+    get_program_binary_ = NULL;
+    program_binary_ = NULL;
+    return;
+  }
+
+  if (directory_.empty()) {
+    std::string files_dir = JNIHelper::GetInstance()->GetExternalFilesDir();
+    if (!files_dir.empty()) directory_ = files_dir + "/program_cache";
+  }
+  if (!directory_.empty() && mkdir(directory_.c_str(), 0700) != 0 &&
+      errno != EEXIST) {
+    LOGW("Unable to create %s", directory_.c_str());
+    directory_.clear();
+  }
+}
+
+bool ProgramCache::IsSupported() {
+  Init();
+  return program_binary_ != NULL && !directory_.empty();
+}
+
+bool ProgramCache::Prepare(
+    const char* vsh_file, const char* fsh_file,
+    const std::map<std::string, std::string>& parameters,
+    const std::map<std::string, GLint>& attributes, PROGRAM_SOURCE* source) {
+  Init();
+
+  // Parameters and #include are resolved here, so an edited include file
+  // changes the key too
+  shader::Preprocessor* preprocessor = shader::Preprocessor::GetInstance();
+  const std::string* vsh = preprocessor->Process(vsh_file, parameters);
+  const std::string* fsh = preprocessor->Process(fsh_file, parameters);
+  if (!vsh || !fsh) {
+    LOGI("Can not open %s or %s", vsh_file, fsh_file);
+    return false;
+  }
+  source->vsh = *vsh;
+  source->fsh = *fsh;
+  source->attributes = attributes;
+  source->path.clear();
+  source->key = 0;
+  if (!IsSupported()) return true;
+
+  uint64_t key = Hash(Hash(kFnvOffset, *vsh), *fsh);
+  for (std::map<std::string, GLint>::const_iterator it = attributes.begin();
+       it != attributes.end(); ++it) {
+    key = Hash(Hash(key, it->first), &it->second, sizeof(it->second));
+  }
+  source->key = Hash(key, driver_);
+
+  // One file per shader pair, a new key overwrites the stale entry
+  char name[32];
+  uint64_t file_key = Hash(Hash(kFnvOffset, vsh_file), fsh_file);
+  snprintf(name, sizeof(name), "/%016llx.bin",
+           static_cast<unsigned long long>(file_key));
+  source->path = directory_ + name;
+  return true;
+}
+
+GLuint ProgramCache::Load(const char* vsh_file, const char* fsh_file,
+                          const std::map<std::string, std::string>& parameters,
+                          const std::map<std::string, GLint>& attributes,
+                          PROGRAM_REFLECTION* reflection) {
+  PROGRAM_SOURCE source;
+  if (!Prepare(vsh_file, fsh_file, parameters, attributes, &source)) return 0;
+  GLuint program = LoadBinary(source, reflection);
+  if (program) return program;
+
+  // Cold path, compile from source
+  GLuint vert_shader, frag_shader;
+  if (!shader::CompileShader(&vert_shader, GL_VERTEX_SHADER,
+                             source.vsh.c_str(), source.vsh.size())) {
+    LOGI("Failed to compile vertex shader %s", vsh_file);
+    return 0;
+  }
+  if (!shader::CompileShader(&frag_shader, GL_FRAGMENT_SHADER,
+                             source.fsh.c_str(), source.fsh.size())) {
+    LOGI("Failed to compile fragment shader %s", fsh_file);
+    glDeleteShader(vert_shader);
+    return 0;
+  }
+
+  program = glCreateProgram();
+  glAttachShader(program, vert_shader);
+  glAttachShader(program, frag_shader);
+  for (std::map<std::string, GLint>::const_iterator it = attributes.begin();
+       it != attributes.end(); ++it) {
+    glBindAttribLocation(program, it->second, it->first.c_str());
+  }
+  SetRetrievable(source, program);
+
+  bool linked = shader::LinkProgram(program);
+  glDeleteShader(vert_shader);
+  glDeleteShader(frag_shader);
+  if (!linked) {
+    LOGI("Failed to link program: %d", program);
+    glDeleteProgram(program);
+    return 0;
+  }
+
+  Reflect(program, reflection);
+  StoreBinary(source, program, *reflection);
+  return program;
+}
+
+void ProgramCache::SetRetrievable(const PROGRAM_SOURCE& source,
+                                  GLuint program) {
+  if (es3_ && !source.path.empty()) {
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+}
+
+GLuint ProgramCache::LoadBinary(const PROGRAM_SOURCE& source,
+                                PROGRAM_REFLECTION* reflection) {
+  if (source.path.empty()) return 0;
+  const std::string& path = source.path;
+  AssetView file;
+  if (!file.OpenFile(path.c_str())) return 0;
+
+  PROGRAM_CACHE_HEADER header;
+  if (file.Size() < sizeof(header)) {
+    LOGW("Program cache %s is truncated", path.c_str());
+    return 0;
+  }
+  memcpy(&header, file.Data(), sizeof(header));
+  if (header.magic != kProgramCacheMagic ||
+      header.version != kProgramCacheVersion || header.key != source.key) {
+    LOGI("Program cache %s is stale", path.c_str());
+    return 0;
+  }
+  const uint8_t* data = file.Data() + sizeof(header);
+  const uint8_t* end = file.Data() + file.Size();
+  if (Hash(kFnvOffset, data, end - data) != header.checksum) {
+    LOGW("Program cache %s is corrupt", path.c_str());
+    return 0;
+  }
+
+  reflection->uniforms.clear();
+  reflection->attributes.clear();
+  if (!ReadLocations(&data, end, header.uniform_count,
+                     &reflection->uniforms) ||
+      !ReadLocations(&data, end, header.attribute_count,
+                     &reflection->attributes) ||
+      static_cast<size_t>(end - data) != header.binary_size) {
+    LOGW("Program cache %s is corrupt", path.c_str());
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  program_binary_(program, header.binary_format, data, header.binary_size);
+  GLint status = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (!status) {
+    // The driver may reject binaries for reasons of its own
+    LOGI("Program cache %s was rejected by the driver", path.c_str());
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+void ProgramCache::StoreBinary(const PROGRAM_SOURCE& source, GLuint program,
+                               const PROGRAM_REFLECTION& reflection) {
+  if (source.path.empty()) return;
+  const std::string& path = source.path;
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) return;
+
+  std::vector<uint8_t> payload;
+  AppendLocations(&payload, reflection.uniforms);
+  AppendLocations(&payload, reflection.attributes);
+  size_t binary_offset = payload.size();
+  payload.resize(binary_offset + length);
+  GLsizei written = 0;
+  GLenum format = 0;
+  get_program_binary_(program, length, &written, &format,
+                      &payload[binary_offset]);
+  if (written <= 0) return;
+  payload.resize(binary_offset + written);
+
+  PROGRAM_CACHE_HEADER header;
+  header.magic = kProgramCacheMagic;
+  header.version = kProgramCacheVersion;
+  header.key = source.key;
+  header.checksum = Hash(kFnvOffset, payload.data(), payload.size());
+  header.binary_format = format;
+  header.binary_size = written;
+  header.uniform_count = reflection.uniforms.size();
+  header.attribute_count = reflection.attributes.size();
+
+  // Write aside and rename, a crash never leaves a half written entry
+  std::string temp = path + ".tmp";
+  FILE* f = fopen(temp.c_str(), "wb");
+  if (!f) {
+    LOGW("Unable to write %s", temp.c_str());
+    return;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+            fwrite(payload.data(), payload.size(), 1, f) == 1;
+  ok = fclose(f) == 0 && ok;
+  if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+    LOGW("Unable to write %s", path.c_str());
+    remove(temp.c_str());
+  }
+}
+
+}  // namespace ndkHelper
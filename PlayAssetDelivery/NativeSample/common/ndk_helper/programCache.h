@@ -0,0 +1,138 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROGRAMCACHE_H_
+#define PROGRAMCACHE_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include <GLES2/gl2.h>
+
+namespace ndk_helper {
+
+/******************************************************************
+ * Active uniforms and attributes of a linked program, by name
+ */
+struct PROGRAM_REFLECTION {
+  std::map<std::string, GLint> uniforms;
+  std::map<std::string, GLint> attributes;
+
+  // -1 when the program has no such active uniform, like glGetUniformLocation
+  GLint GetUniform(const char* name) const;
+  GLint GetAttribute(const char* name) const;
+};
+
+/******************************************************************
+ * Expanded shader pair and where its binary is cached, see
+ * ProgramCache::Prepare()
+ */
+struct PROGRAM_SOURCE {
+  std::string vsh;
+  std::string fsh;
+  std::map<std::string, GLint> attributes;
+  std::string path;  // cache file, empty when binaries are not stored
+  uint64_t key;
+};
+
+/******************************************************************
+ * Persistent program binary cache
+ * Load() links a program from a vertex and a fragment shader file. The
+ * linked binary (glGetProgramBinary, OpenGL ES 3 or
+ * GL_OES_get_program_binary) is stored under
+ * JNIHelper::GetExternalFilesDir() together with the reflected uniform and
+ * attribute locations, so the next start skips compiling, linking and
+ * location lookups.
+ * Entries are keyed by a hash of the shader sources as expanded by
+ * shader::Preprocessor (parameters and #include applied), the attribute
+ * bindings and the GL vendor/renderer/version strings; a driver update
+ * invalidates them. Stale, corrupt or rejected entries fall back to
+ * compiling from source and are rewritten.
+ * GL thread only.
+ */
+class ProgramCache {
+ private:
+  typedef void (*GetProgramBinaryProc)(GLuint, GLsizei, GLsizei*, GLenum*,
+                                        void*);
+  typedef void (*ProgramBinaryProc)(GLuint, GLenum, const void*, GLint);
+
+  bool initialized_;
+  GetProgramBinaryProc get_program_binary_;
+  ProgramBinaryProc program_binary_;
+  bool es3_;
+  std::string directory_;
+  std::string driver_;
+
+  void Init();
+
+  ProgramCache();
+  ProgramCache(const ProgramCache& rhs);
+  ProgramCache& operator=(const ProgramCache& rhs);
+
+ public:
+  static ProgramCache* GetInstance() {
+    // Singleton
+    static ProgramCache instance;
+
+    return &instance;
+  }
+
+  /******************************************************************
+   * Load()
+   *
+   * arguments:
+   *  in: vsh_file, fsh_file, shader file names for JNIHelper::OpenFile()
+   *  in: parameters, token replacements, see shader::Preprocessor
+   *  in: attributes, attribute name -> location, bound before linking
+   *  out: reflection, active uniform and attribute locations
+   * return: linked program, 0 if building it failed
+   *
+   */
+  GLuint Load(const char* vsh_file, const char* fsh_file,
+              const std::map<std::string, std::string>& parameters,
+              const std::map<std::string, GLint>& attributes,
+              PROGRAM_REFLECTION* reflection);
+
+  /******************************************************************
+   * Pieces of Load() for callers that compile on their own, like
+   * ProgramBuilder:
+   * Prepare() expands both shaders and computes the cache key, false if a
+   * file can't be read. LoadBinary() returns the cached program or 0.
+   * After compiling, SetRetrievable() must be called before linking and
+   * StoreBinary() once the program linked.
+   */
+  bool Prepare(const char* vsh_file, const char* fsh_file,
+               const std::map<std::string, std::string>& parameters,
+               const std::map<std::string, GLint>& attributes,
+               PROGRAM_SOURCE* source);
+  GLuint LoadBinary(const PROGRAM_SOURCE& source,
+                    PROGRAM_REFLECTION* reflection);
+  void SetRetrievable(const PROGRAM_SOURCE& source, GLuint program);
+  void StoreBinary(const PROGRAM_SOURCE& source, GLuint program,
+                   const PROGRAM_REFLECTION& reflection);
+  // Active uniform and attribute locations of a linked program
+  static void Reflect(GLuint program, PROGRAM_REFLECTION* reflection);
+
+  // True when program binaries can be stored on this device
+  bool IsSupported();
+  // Where cache files go, defaults to <external files dir>/program_cache
+  void SetDirectory(const std::string& directory) { directory_ = directory; }
+};
+
+}  // namespace ndkHelper
+#endif /* PROGRAMCACHE_H_ */
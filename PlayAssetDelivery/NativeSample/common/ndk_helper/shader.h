@@ -81,14 +81,16 @@ bool CompileShader(GLuint *shader, const GLenum type, const char *strFileName);
 
 /******************************************************************
  * CompileShader() with std::map helps patching on a shader on the fly.
+ * The source goes through shader::Preprocessor, which also resolves
+ * #include lines and memoizes the result per file and parameter set.
  *
  * arguments:
  *  out: shader, shader variable
  *  in: type, shader type (i.e. GL_VERTEX_SHADER/GL_FRAGMENT_SHADER)
  *  in: mapParameters
  *      For a example,
- *      map : %KEY% -> %VALUE% replaces all %KEY% entries in the given shader
- *code to %VALUE"
+ *      map : %KEY% -> %VALUE% replaces all %KEY% tokens in the given shader
+ *code to %VALUE". Identifiers can be keys too, only whole tokens match.
  * return: true if a shader compilation succeeded, false if it failed
  *
  */
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "shaderPreprocessor.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "JNIHelper.h"
+
+namespace ndk_helper {
+
+namespace {
+
+const size_t kMaxIncludeDepth = 16;
+
+bool IsIdentifierStart(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool IsIdentifierChar(char c) {
+  return IsIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+bool LoadFile(const std::string& file_name, std::string* source) {
+  AssetView data;
+  if (!JNIHelper::GetInstance()->OpenFile(file_name.c_str(), &data)) {
+    return false;
+  }
+  source->assign(data.Data(), data.Data() + data.Size());
+  return true;
+}
+
+/*
+ * Parse `#include "name"` or `#include <name>` starting at the '#'.
+ * Returns false for any other directive.
+ */
+bool ParseInclude(const char* p, const char* end, std::string* name) {
+  static const char kInclude[] = "include";
+  const size_t length = sizeof(kInclude) - 1;
+  ++p;
+  while (p < end && (*p == ' ' || *p == '\t')) ++p;
+  if (end - p < static_cast<ptrdiff_t>(length) ||
+      strncmp(p, kInclude, length) != 0)
+    return false;
+  p += length;
+  while (p < end && (*p == ' ' || *p == '\t')) ++p;
+  if (p == end || (*p != '"' && *p != '<')) return false;
+  const char close = *p == '"' ? '"' : '>';
+  const char* first = ++p;
+  while (p < end && *p != close && *p != '\n') ++p;
+  if (p == end || *p != close) return false;
+  name->assign(first, p);
+  return !name->empty();
+}
+
+}  // namespace
+
+shader::Preprocessor::Preprocessor() : loader_(LoadFile) {}
+
+void shader::Preprocessor::SetLoader(const Loader& loader) {
+  loader_ = loader;
+  Clear();
+}
+
+void shader::Preprocessor::Clear() {
+  files_.clear();
+  expanded_.clear();
+}
+
+const std::string* shader::Preprocessor::ReadFile(
+    const std::string& file_name) {
+  std::map<std::string, std::string>::iterator it = files_.find(file_name);
+  if (it != files_.end()) return &it->second;
+
+  std::string source;
+  if (!loader_(file_name, &source)) return NULL;
+  return &(files_[file_name] = source);
+}
+
+const std::string* shader::Preprocessor::Process(
+    const char* file_name,
+    const std::map<std::string, std::string>& parameters) {
+  std::string key(file_name);
+  for (std::map<std::string, std::string>::const_iterator it =
+           parameters.begin();
+       it != parameters.end(); ++it) {
+    key += '\0';
+    key += it->first;
+    key += '\0';
+    key += it->second;
+  }
+  std::map<std::string, std::string>::iterator it = expanded_.find(key);
+  if (it != expanded_.end()) return &it->second;
+
+  std::string out;
+  std::vector<std::string> include_stack;
+  if (!Expand(file_name, parameters, &include_stack, &out)) return NULL;
+  return &(expanded_[key] = out);
+}
+
+bool shader::Preprocessor::Expand(
+    const std::string& file_name,
+    const std::map<std::string, std::string>& parameters,
+    std::vector<std::string>* include_stack, std::string* out) {
+  if (include_stack->size() >= kMaxIncludeDepth ||
+      std::find(include_stack->begin(), include_stack->end(), file_name) !=
+          include_stack->end()) {
+    LOGE("Recursive #include of %s", file_name.c_str());
+    return false;
+  }
+  const std::string* source = ReadFile(file_name);
+  if (!source) {
+    LOGE("Can not open a file:%s", file_name.c_str());
+    return false;
+  }
+  include_stack->push_back(file_name);
+  out->reserve(out->size() + source->size());
+
+  const char* p = source->data();
+  const char* end = p + source->size();
+  bool line_start = true;
+  while (p < end) {
+    if (line_start) {
+      line_start = false;
+      const char* q = p;
+      while (q < end && (*q == ' ' || *q == '\t')) ++q;
+      std::string include;
+      if (q < end && *q == '#' && ParseInclude(q, end, &include)) {
+        // Relative to the including file, unless already a full name
+        size_t slash = file_name.rfind('/');
+        if (include.find_first_of("/:") == std::string::npos &&
+            slash != std::string::npos) {
+          include = file_name.substr(0, slash + 1) + include;
+        }
+        if (!Expand(include, parameters, include_stack, out)) return false;
+        if (out->empty() || (*out)[out->size() - 1] != '\n') *out += '\n';
+        const char* eol = static_cast<const char*>(memchr(q, '\n', end - q));
+        p = eol ? eol + 1 : end;
+        line_start = true;
+        continue;
+      }
+    }
+
+    const char c = *p;
+    if (c == '\n') {
+      *out += c;
+      ++p;
+      line_start = true;
+    } else if (c == '/' && p + 1 < end && p[1] == '/') {
+      // Comments are copied as is
+      const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+      const char* stop = eol ? eol : end;
+      out->append(p, stop);
+      p = stop;
+    } else if (c == '/' && p + 1 < end && p[1] == '*') {
+      const char* stop = p + 2;
+      while (stop + 1 < end && !(stop[0] == '*' && stop[1] == '/')) ++stop;
+      stop = std::min(stop + 2, end);
+      out->append(p, stop);
+      p = stop;
+    } else if (IsIdentifierStart(c) || c == '%') {
+      // Identifier, or %NAME% when the closing % follows the name
+      const char* stop = p + 1;
+      while (stop < end && IsIdentifierChar(*stop)) ++stop;
+      if (c == '%') {
+        if (stop < end && *stop == '%' && stop > p + 1) {
+          ++stop;
+        } else {
+          stop = p + 1;
+        }
+      }
+      std::map<std::string, std::string>::const_iterator it =
+          parameters.empty() ? parameters.end()
+                             : parameters.find(std::string(p, stop));
+      if (it != parameters.end()) {
+        *out += it->second;
+      } else {
+        out->append(p, stop);
+      }
+      p = stop;
+    } else if (c >= '0' && c <= '9') {
+      // Numbers like 1e5 or 0x1F are not identifiers
+      const char* stop = p + 1;
+      while (stop < end && (IsIdentifierChar(*stop) || *stop == '.')) ++stop;
+      out->append(p, stop);
+      p = stop;
+    } else {
+      *out += c;
+      ++p;
+    }
+  }
+
+  include_stack->pop_back();
+  return true;
+}
+
+}  // namespace ndkHelper
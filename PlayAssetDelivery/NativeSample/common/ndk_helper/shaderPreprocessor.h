@@ -0,0 +1,96 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SHADERPREPROCESSOR_H_
+#define SHADERPREPROCESSOR_H_
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ndk_helper {
+
+namespace shader {
+
+/******************************************************************
+ * Shader source preprocessor
+ * Process() expands a shader file in a single pass over its tokens:
+ * - identifiers and %NAME% tokens found in the parameter map are replaced
+ *   by their value; replacements are not scanned again
+ * - #include "file" lines are replaced by the processed file, looked up
+ *   next to the including file unless the name has a directory or a
+ *   "pack:" prefix, see SetLoader()
+ * The expanded source is memoized per (file, parameter set), so shader
+ * permutations only cost a map lookup once built. Included files are read
+ * once.
+ * GL thread only.
+ */
+class Preprocessor {
+ public:
+  /*
+   * Reads a source file by name, returns false when it doesn't exist.
+   * The default loader uses JNIHelper::OpenFile().
+   */
+  typedef std::function<bool(const std::string& file_name,
+                             std::string* source)> Loader;
+
+ private:
+  Loader loader_;
+  std::map<std::string, std::string> files_;     // raw sources
+  std::map<std::string, std::string> expanded_;  // by file + parameters
+
+  const std::string* ReadFile(const std::string& file_name);
+  bool Expand(const std::string& file_name,
+              const std::map<std::string, std::string>& parameters,
+              std::vector<std::string>* include_stack, std::string* out);
+
+  Preprocessor();
+  Preprocessor(const Preprocessor& rhs);
+  Preprocessor& operator=(const Preprocessor& rhs);
+
+ public:
+  static Preprocessor* GetInstance() {
+    // Singleton
+    static Preprocessor instance;
+
+    return &instance;
+  }
+
+  /******************************************************************
+   * Process()
+   *
+   * arguments:
+   *  in: file_name, shader file
+   *  in: parameters, token -> replacement
+   * return: expanded source, NULL if the file or one of its includes can't
+   *  be read. Valid until Clear() or SetLoader().
+   *
+   */
+  const std::string* Process(
+      const char* file_name,
+      const std::map<std::string, std::string>& parameters);
+
+  // Replace the file loader, e.g. to read includes from asset packs
+  void SetLoader(const Loader& loader);
+  // Forget memoized sources, e.g. after shader files changed
+  void Clear();
+};
+
+}  // namespace shader
+
+}  // namespace ndkHelper
+#endif /* SHADERPREPROCESSOR_H_ */
@@ -105,6 +105,8 @@ class TapCamera {
   }
 
   void Reset(const bool bAnimate);
+  // Still moving after the fingers left, Update() keeps changing the view
+  bool HasMomentum() const { return momentum_; }
 };
 
 }  // namespace ndkHelper
@@ -0,0 +1,233 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace.h"
+
+#include <stdio.h>
+
+#if defined(__ANDROID__)
+#include <dlfcn.h>
+#else
+#include <time.h>
+
+#include <atomic>
+#endif
+
+namespace ndk_helper {
+
+namespace trace {
+
+#if defined(__ANDROID__)
+
+namespace {
+
+struct ATRACE_API {
+  bool (*is_enabled)();
+  void (*begin_section)(const char*);
+  void (*end_section)();
+  void (*set_counter)(const char*, int64_t);
+};
+
+ATRACE_API LoadApi() {
+  ATRACE_API api = {};
+  // libandroid is loaded already, the handle is kept for the process life
+  void* android = dlopen("libandroid.so", RTLD_NOW);
+  if (!android) return api;
+  api.is_enabled =
+      reinterpret_cast<bool (*)()>(dlsym(android, "ATrace_isEnabled"));
+  api.begin_section = reinterpret_cast<void (*)(const char*)>(
+      dlsym(android, "ATrace_beginSection"));
+  api.end_section =
+      reinterpret_cast<void (*)()>(dlsym(android, "ATrace_endSection"));
+  api.set_counter = reinterpret_cast<void (*)(const char*, int64_t)>(
+      dlsym(android, "ATrace_setCounter"));
+  if (!api.is_enabled || !api.begin_section || !api.end_section) {
+    // Before API 23, nothing to trace to
+    ATRACE_API none = {};
+    return none;
+  }
+  return api;
+}
+
+const ATRACE_API& Api() {
+  static const ATRACE_API api = LoadApi();
+  return api;
+}
+
+}  // namespace
+
+bool IsEnabled() {
+  const ATRACE_API& api = Api();
+  return api.is_enabled && api.is_enabled();
+}
+
+void BeginSection(const char* name) {
+  const ATRACE_API& api = Api();
+  if (api.begin_section) api.begin_section(name);
+}
+
+void EndSection() {
+  const ATRACE_API& api = Api();
+  if (api.end_section) api.end_section();
+}
+
+void SetCounter(const char* name, int64_t value) {
+  const ATRACE_API& api = Api();
+  if (api.set_counter && api.is_enabled()) api.set_counter(name, value);
+}
+
+bool WriteJson(const char* path) { return false; }
+
+#else
+
+namespace {
+
+const uint32_t kRingSize = 8192;  // events per thread, a power of two
+
+/*
+ * WriteJson() may read a slot while its thread overwrites it. Fields are
+ * relaxed atomics and seq publishes them: 0 while the slot is written, then
+ * the event number + 1. A reader that sees the same number before and after
+ * copying the fields has a whole event.
+ */
+struct TRACE_EVENT {
+  std::atomic<uint64_t> seq;
+  std::atomic<const char*> name;
+  std::atomic<int64_t> time_ns;
+  std::atomic<int64_t> value;
+  std::atomic<char> phase;  // 'B', 'E' or 'C' as in the Chrome trace format
+};
+
+/*
+ * Written by its thread only. head counts every event ever recorded; the
+ * writer publishes an event by bumping it.
+ */
+struct TRACE_RING {
+  TRACE_EVENT events[kRingSize];
+  std::atomic<uint64_t> head;
+  uint32_t tid;
+  TRACE_RING* next;
+};
+
+// Rings are never freed, a thread may exit before the trace is written
+std::atomic<TRACE_RING*> g_rings(nullptr);
+std::atomic<uint32_t> g_next_tid(1);
+thread_local TRACE_RING* t_ring = nullptr;
+
+TRACE_RING* GetRing() {
+  if (t_ring) return t_ring;
+  TRACE_RING* ring = new TRACE_RING();
+  for (uint32_t i = 0; i < kRingSize; ++i) ring->events[i].seq.store(0);
+  ring->head.store(0);
+  ring->tid = g_next_tid.fetch_add(1);
+  ring->next = g_rings.load();
+  while (!g_rings.compare_exchange_weak(ring->next, ring)) {
+  }
+  t_ring = ring;
+  return ring;
+}
+
+void Record(char phase, const char* name, int64_t value) {
+  TRACE_RING* ring = GetRing();
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  TRACE_EVENT& event = ring->events[head & (kRingSize - 1)];
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  event.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  event.name.store(name, std::memory_order_relaxed);
+  event.time_ns.store(
+      static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec,
+      std::memory_order_relaxed);
+  event.value.store(value, std::memory_order_relaxed);
+  event.phase.store(phase, std::memory_order_relaxed);
+  event.seq.store(head + 1, std::memory_order_release);
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+// False when the slot no longer, or not yet, holds event number index
+bool ReadEvent(const TRACE_EVENT& event, uint64_t index, const char** name,
+               int64_t* time_ns, int64_t* value, char* phase) {
+  if (event.seq.load(std::memory_order_acquire) != index + 1) return false;
+  *name = event.name.load(std::memory_order_relaxed);
+  *time_ns = event.time_ns.load(std::memory_order_relaxed);
+  *value = event.value.load(std::memory_order_relaxed);
+  *phase = event.phase.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return event.seq.load(std::memory_order_relaxed) == index + 1;
+}
+
+void WriteString(FILE* f, const char* str) {
+  fputc('"', f);
+  for (; str && *str; ++str) {
+    if (*str == '"' || *str == '\\') fputc('\\', f);
+    if (static_cast<unsigned char>(*str) >= 0x20) fputc(*str, f);
+  }
+  fputc('"', f);
+}
+
+}  // namespace
+
+bool IsEnabled() { return true; }
+
+void BeginSection(const char* name) { Record('B', name, 0); }
+
+void EndSection() { Record('E', nullptr, 0); }
+
+void SetCounter(const char* name, int64_t value) { Record('C', name, value); }
+
+bool WriteJson(const char* path) {
+  FILE* f = fopen(path, "w");
+  if (!f) return false;
+
+  fputs("{\"traceEvents\":[", f);
+  bool first = true;
+  for (TRACE_RING* ring = g_rings.load(); ring; ring = ring->next) {
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t start = head > kRingSize ? head - kRingSize : 0;
+    for (uint64_t i = start; i < head; ++i) {
+      const char* name;
+      int64_t time_ns;
+      int64_t value;
+      char phase;
+      if (!ReadEvent(ring->events[i & (kRingSize - 1)], i, &name, &time_ns,
+                     &value, &phase)) {
+        continue;
+      }
+      fputs(first ? "\n" : ",\n", f);
+      first = false;
+      fprintf(f, "{\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%.3f", phase,
+              ring->tid, time_ns / 1000.0);
+      if (name) {
+        fputs(",\"name\":", f);
+        WriteString(f, name);
+      }
+      if (phase == 'C') {
+        fprintf(f, ",\"args\":{\"value\":%lld}",
+                static_cast<long long>(value));
+      }
+      fputc('}', f);
+    }
+  }
+  fputs("\n]}\n", f);
+  return fclose(f) == 0;
+}
+
+#endif
+
+}  // namespace trace
+
+}  // namespace ndkHelper
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+
+/******************************************************************
+ * Trace markers
+ * NDK_TRACE_SCOPE("name") marks the rest of the enclosing block,
+ * NDK_TRACE_BEGIN/NDK_TRACE_END an explicit section on the same thread and
+ * NDK_TRACE_COUNTER("name", value) a counter track. Names must be string
+ * literals, they are kept by pointer.
+ * On device the markers go to ATrace (systrace, Perfetto), loaded at run
+ * time as it needs API 23 (counters API 29). Elsewhere they are recorded
+ * into a per-thread ring buffer without locks and trace::WriteJson()
+ * writes them in the Chrome trace format, for chrome://tracing or
+ * ui.perfetto.dev.
+ * Building with NDK_HELPER_TRACE=0 compiles every marker out.
+ */
+#ifndef NDK_HELPER_TRACE
+#define NDK_HELPER_TRACE 1
+#endif
+
+namespace ndk_helper {
+
+namespace trace {
+
+// True while a trace is being captured; host builds always record
+bool IsEnabled();
+void BeginSection(const char* name);
+void EndSection();
+void SetCounter(const char* name, int64_t value);
+
+/******************************************************************
+ * WriteJson()
+ * Write the events still in the ring buffers of every thread that traced,
+ * oldest first. Events a thread overwrites while they are read are left
+ * out. Does nothing on device, ATrace owns the data there.
+ *
+ * arguments:
+ *  in: path, output file
+ * return: true if the file was written
+ *
+ */
+bool WriteJson(const char* path);
+
+class ScopedSection {
+ public:
+  explicit ScopedSection(const char* name) { BeginSection(name); }
+  ~ScopedSection() { EndSection(); }
+
+ private:
+  ScopedSection(const ScopedSection& rhs);
+  ScopedSection& operator=(const ScopedSection& rhs);
+};
+
+}  // namespace trace
+
+}  // namespace ndkHelper
+
+#if NDK_HELPER_TRACE
+#define NDK_TRACE_CONCAT_(a, b) a##b
+#define NDK_TRACE_CONCAT(a, b) NDK_TRACE_CONCAT_(a, b)
+#define NDK_TRACE_SCOPE(name)                                          \
+  ndk_helper::trace::ScopedSection NDK_TRACE_CONCAT(ndk_trace_scope_, \
+                                                    __LINE__)(name)
+#define NDK_TRACE_BEGIN(name) ndk_helper::trace::BeginSection(name)
+#define NDK_TRACE_END() ndk_helper::trace::EndSection()
+#define NDK_TRACE_COUNTER(name, value) \
+  ndk_helper::trace::SetCounter(name, static_cast<int64_t>(value))
+#else
+#define NDK_TRACE_SCOPE(name) ((void)0)
+#define NDK_TRACE_BEGIN(name) ((void)0)
+#define NDK_TRACE_END() ((void)0)
+#define NDK_TRACE_COUNTER(name, value) ((void)0)
+#endif
+
+#endif /* TRACE_H_ */
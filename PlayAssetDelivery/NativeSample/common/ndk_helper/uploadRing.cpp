@@ -0,0 +1,192 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "uploadRing.h"
+
+#include <EGL/egl.h>
+
+#include "GLContext.h"
+#include "glStateCache.h"
+#include "JNIHelper.h"
+#include "perfMonitor.h"
+#include "trace.h"
+
+// GL_EXT_buffer_storage
+#ifndef GL_MAP_PERSISTENT_BIT_EXT
+#define GL_MAP_PERSISTENT_BIT_EXT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT_EXT
+#define GL_MAP_COHERENT_BIT_EXT 0x0080
+#endif
+
+namespace ndk_helper {
+
+// Waits longer than this are retried, a lost context would fail instead
+static const GLuint64 kFenceTimeoutNs = 100000000;
+
+UploadRing::UploadRing()
+    : target_(GL_ARRAY_BUFFER),
+      buffer_(0),
+      segment_size_(0),
+      frame_(0),
+      cursor_(0),
+      persistent_(NULL),
+      mapped_(NULL),
+      mapped_offset_(0),
+      in_frame_(false),
+      stalls_(0),
+      stall_time_ns_(0),
+      overflows_(0) {
+  for (int32_t i = 0; i < kFrameCount; ++i) fences_[i] = NULL;
+}
+
+UploadRing::~UploadRing() {}
+
+void UploadRing::Bind() {
+  GLStateCache::GetInstance()->BindBuffer(target_, buffer_);
+}
+
+bool UploadRing::Init(GLenum target, GLsizeiptr frame_size) {
+  Release();
+  if (GLContext::GetInstance()->GetGLVersion() < 3.0f || !glMapBufferRange ||
+      !glFenceSync) {
+    return false;
+  }
+  target_ = target;
+  // Segments start aligned for any Allocate() up to 256 bytes
+  segment_size_ = (frame_size + 255) & ~static_cast<GLsizeiptr>(255);
+  GLsizeiptr size = segment_size_ * kFrameCount;
+
+  glGenBuffers(1, &buffer_);
+  Bind();
+  BufferStorageProc buffer_storage = NULL;
+  if (GLContext::GetInstance()->CheckExtension("GL_EXT_buffer_storage")) {
+    buffer_storage = reinterpret_cast<BufferStorageProc>(
+        eglGetProcAddress("glBufferStorageEXT"));
+  }
+  if (buffer_storage) {
+    const GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT_EXT | GL_MAP_COHERENT_BIT_EXT;
+    buffer_storage(target_, size, NULL, flags);
+    persistent_ =
+        static_cast<uint8_t*>(glMapBufferRange(target_, 0, size, flags));
+    if (!persistent_) {
+      LOGW("Persistent mapping failed, mapping every frame");
+      // Immutable storage can't be respecified, start over with a new buffer
+      GLStateCache::GetInstance()->DeleteBuffer(buffer_);
+      glGenBuffers(1, &buffer_);
+      Bind();
+    }
+  }
+  if (!persistent_) glBufferData(target_, size, NULL, GL_DYNAMIC_DRAW);
+  frame_ = 0;
+  cursor_ = 0;
+  in_frame_ = false;
+  LOGI("Upload ring of %d x %ld bytes, %s", kFrameCount,
+       static_cast<long>(segment_size_),
+       persistent_ ? "persistently mapped" : "mapped per frame");
+  return true;
+}
+
+void UploadRing::Release() {
+  if (buffer_) {
+    Unmap();
+    if (persistent_) {
+      Bind();
+      glUnmapBuffer(target_);
+      persistent_ = NULL;
+    }
+    GLStateCache::GetInstance()->DeleteBuffer(buffer_);
+    buffer_ = 0;
+  }
+  for (int32_t i = 0; i < kFrameCount; ++i) {
+    if (fences_[i]) glDeleteSync(fences_[i]);
+    fences_[i] = NULL;
+  }
+  segment_size_ = 0;
+  in_frame_ = false;
+}
+
+void UploadRing::BeginFrame() {
+  if (!buffer_ || in_frame_) return;
+  frame_ = (frame_ + 1) % kFrameCount;
+  cursor_ = 0;
+  in_frame_ = true;
+
+  GLsync fence = fences_[frame_];
+  if (!fence) return;
+  fences_[frame_] = NULL;
+  GLenum result = glClientWaitSync(fence, 0, 0);
+  if (result == GL_TIMEOUT_EXPIRED) {
+    NDK_TRACE_SCOPE("UploadRing stall");
+    ++stalls_;
+    int64_t start = PerfMonitor::GetCurrentTimeNs();
+    do {
+      result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                kFenceTimeoutNs);
+    } while (result == GL_TIMEOUT_EXPIRED);
+    stall_time_ns_ += PerfMonitor::GetCurrentTimeNs() - start;
+    NDK_TRACE_COUNTER("UploadRing stalls", stalls_);
+  }
+  if (result == GL_WAIT_FAILED) LOGW("glClientWaitSync failed");
+  glDeleteSync(fence);
+}
+
+UPLOAD_ALLOCATION UploadRing::Allocate(GLsizeiptr size,
+                                       GLsizeiptr alignment) {
+  UPLOAD_ALLOCATION allocation = {NULL, 0};
+  if (!in_frame_) return allocation;
+  GLintptr start = (cursor_ + alignment - 1) & ~(alignment - 1);
+  if (start + size > segment_size_) {
+    ++overflows_;
+    return allocation;
+  }
+  GLintptr base = frame_ * segment_size_;
+  if (persistent_) {
+    allocation.data = persistent_ + base + start;
+  } else {
+    if (!mapped_) {
+      // The fence made sure the GPU is done with the rest of the segment
+      Bind();
+      mapped_offset_ = base + start;
+      mapped_ = static_cast<uint8_t*>(glMapBufferRange(
+          target_, mapped_offset_, segment_size_ - start,
+          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+              GL_MAP_UNSYNCHRONIZED_BIT));
+      if (!mapped_) return allocation;
+    }
+    allocation.data = mapped_ + (base + start - mapped_offset_);
+  }
+  allocation.offset = base + start;
+  cursor_ = start + size;
+  return allocation;
+}
+
+void UploadRing::Unmap() {
+  if (!mapped_) return;
+  Bind();
+  glUnmapBuffer(target_);
+  mapped_ = NULL;
+}
+
+void UploadRing::EndFrame() {
+  if (!in_frame_) return;
+  Unmap();
+  fences_[frame_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  in_frame_ = false;
+}
+
+}  // namespace ndkHelper
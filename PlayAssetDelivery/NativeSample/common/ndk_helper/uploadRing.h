@@ -0,0 +1,110 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UPLOADRING_H_
+#define UPLOADRING_H_
+
+#include <stdint.h>
+
+#include "../third_party/gl3stub.h"
+
+namespace ndk_helper {
+
+struct UPLOAD_ALLOCATION {
+  void* data;       // write only, NULL if the allocation failed
+  GLintptr offset;  // in GetBuffer()
+};
+
+/******************************************************************
+ * Ring buffer for data written every frame, OpenGL ES 3
+ * The buffer holds kFrameCount segments, one per frame in flight. Each
+ * segment is fenced with glFenceSync when its frame ends, and BeginFrame()
+ * waits on the fence of the segment it reuses; that wait is only a stall
+ * when the CPU got kFrameCount frames ahead of the GPU.
+ * With GL_EXT_buffer_storage the buffer is mapped once, persistent and
+ * coherent. Otherwise the segment is mapped with GL_MAP_UNSYNCHRONIZED_BIT
+ * on the first Allocate() and Unmap() must be called before drawing from
+ * it; both are cheap as the fence already did the synchronization.
+ * Either way data goes to the buffer without a driver copy, unlike
+ * glBufferSubData().
+ * GL thread only; Release() before the context goes away.
+ */
+class UploadRing {
+ public:
+  static const int32_t kFrameCount = 3;
+
+ private:
+  typedef void (*BufferStorageProc)(GLenum, GLsizeiptr, const void*,
+                                    GLbitfield);
+
+  GLenum target_;
+  GLuint buffer_;
+  GLsizeiptr segment_size_;
+  int32_t frame_;           // segment of the current frame
+  GLintptr cursor_;         // next free byte of the segment
+  GLsync fences_[kFrameCount];
+  uint8_t* persistent_;     // whole buffer mapping, NULL if not persistent
+  uint8_t* mapped_;         // start of the current mapping
+  GLintptr mapped_offset_;  // its offset in the buffer
+  bool in_frame_;
+
+  uint32_t stalls_;
+  int64_t stall_time_ns_;
+  uint32_t overflows_;
+
+  void Bind();
+
+  UploadRing(const UploadRing& rhs);
+  UploadRing& operator=(const UploadRing& rhs);
+
+ public:
+  UploadRing();
+  ~UploadRing();
+
+  /******************************************************************
+   * Init()
+   *
+   * arguments:
+   *  in: target, such as GL_ARRAY_BUFFER or GL_UNIFORM_BUFFER
+   *  in: frame_size, bytes available each frame
+   * return: false before OpenGL ES 3
+   *
+   */
+  bool Init(GLenum target, GLsizeiptr frame_size);
+  void Release();
+  bool IsSupported() const { return buffer_ != 0; }
+  bool IsPersistent() const { return persistent_ != NULL; }
+  GLuint GetBuffer() const { return buffer_; }
+  GLsizeiptr GetFrameSize() const { return segment_size_; }
+
+  // Wait for the GPU to release the oldest segment
+  void BeginFrame();
+  // alignment is a power of two. Fails when the frame's segment is full.
+  UPLOAD_ALLOCATION Allocate(GLsizeiptr size, GLsizeiptr alignment);
+  // Finish writing before the buffer is read, a no-op when persistent
+  void Unmap();
+  // After the last draw reading this frame's data
+  void EndFrame();
+
+  // Frames that waited on the GPU, and for how long in total
+  uint32_t GetStallCount() const { return stalls_; }
+  int64_t GetStallTimeNs() const { return stall_time_ns_; }
+  // Allocations that didn't fit
+  uint32_t GetOverflowCount() const { return overflows_; }
+};
+
+}  // namespace ndkHelper
+#endif /* UPLOADRING_H_ */
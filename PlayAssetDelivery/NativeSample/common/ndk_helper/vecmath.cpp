@@ -19,8 +19,60 @@
 //--------------------------------------------------------------------------------
 #include "vecmath.h"
 
+#if defined(NDK_HELPER_VECMATH_NEON)
+#include <arm_neon.h>
+#elif defined(NDK_HELPER_VECMATH_SSE)
+#include <xmmintrin.h>
+#endif
+
 namespace ndk_helper {
 
+namespace {
+//--------------------------------------------------------------------------------
+// Column major 4x4 product, out = lhs * rhs
+// out may alias lhs or rhs.
+//--------------------------------------------------------------------------------
+inline void MultiplyMatrix(const float* lhs, const float* rhs, float* out) {
+#if defined(NDK_HELPER_VECMATH_NEON)
+  // Each column of the result is a linear combination of the lhs columns.
+  // Multiplies and adds are kept separate (no vmla/vfma) so rounding matches
+  // the scalar implementation.
+  const float32x4_t c0 = vld1q_f32(&lhs[0]);
+  const float32x4_t c1 = vld1q_f32(&lhs[4]);
+  const float32x4_t c2 = vld1q_f32(&lhs[8]);
+  const float32x4_t c3 = vld1q_f32(&lhs[12]);
+  for (int32_t i = 0; i < 16; i += 4) {
+    float32x4_t col = vmulq_n_f32(c0, rhs[i]);
+    col = vaddq_f32(col, vmulq_n_f32(c1, rhs[i + 1]));
+    col = vaddq_f32(col, vmulq_n_f32(c2, rhs[i + 2]));
+    col = vaddq_f32(col, vmulq_n_f32(c3, rhs[i + 3]));
+    vst1q_f32(&out[i], col);
+  }
+#elif defined(NDK_HELPER_VECMATH_SSE)
+  const __m128 c0 = _mm_loadu_ps(&lhs[0]);
+  const __m128 c1 = _mm_loadu_ps(&lhs[4]);
+  const __m128 c2 = _mm_loadu_ps(&lhs[8]);
+  const __m128 c3 = _mm_loadu_ps(&lhs[12]);
+  for (int32_t i = 0; i < 16; i += 4) {
+    __m128 col = _mm_mul_ps(c0, _mm_set1_ps(rhs[i]));
+    col = _mm_add_ps(col, _mm_mul_ps(c1, _mm_set1_ps(rhs[i + 1])));
+    col = _mm_add_ps(col, _mm_mul_ps(c2, _mm_set1_ps(rhs[i + 2])));
+    col = _mm_add_ps(col, _mm_mul_ps(c3, _mm_set1_ps(rhs[i + 3])));
+    _mm_storeu_ps(&out[i], col);
+  }
+#else
+  float ret[16];
+  for (int32_t i = 0; i < 16; i += 4) {
+    for (int32_t r = 0; r < 4; ++r) {
+      ret[i + r] = lhs[r] * rhs[i] + lhs[4 + r] * rhs[i + 1] +
+                   lhs[8 + r] * rhs[i + 2] + lhs[12 + r] * rhs[i + 3];
+    }
+  }
+  for (int32_t i = 0; i < 16; ++i) out[i] = ret[i];
+#endif
+}
+}  // namespace
+
 //--------------------------------------------------------------------------------
 // vec3
 //--------------------------------------------------------------------------------
@@ -58,51 +110,30 @@ Mat4::Mat4(const float* mIn) {
 
 Mat4 Mat4::operator*(const Mat4& rhs) const {
   Mat4 ret;
-  ret.f_[0] = f_[0] * rhs.f_[0] + f_[4] * rhs.f_[1] + f_[8] * rhs.f_[2] +
-              f_[12] * rhs.f_[3];
-  ret.f_[1] = f_[1] * rhs.f_[0] + f_[5] * rhs.f_[1] + f_[9] * rhs.f_[2] +
-              f_[13] * rhs.f_[3];
-  ret.f_[2] = f_[2] * rhs.f_[0] + f_[6] * rhs.f_[1] + f_[10] * rhs.f_[2] +
-              f_[14] * rhs.f_[3];
-  ret.f_[3] = f_[3] * rhs.f_[0] + f_[7] * rhs.f_[1] + f_[11] * rhs.f_[2] +
-              f_[15] * rhs.f_[3];
-
-  ret.f_[4] = f_[0] * rhs.f_[4] + f_[4] * rhs.f_[5] + f_[8] * rhs.f_[6] +
-              f_[12] * rhs.f_[7];
-  ret.f_[5] = f_[1] * rhs.f_[4] + f_[5] * rhs.f_[5] + f_[9] * rhs.f_[6] +
-              f_[13] * rhs.f_[7];
-  ret.f_[6] = f_[2] * rhs.f_[4] + f_[6] * rhs.f_[5] + f_[10] * rhs.f_[6] +
-              f_[14] * rhs.f_[7];
-  ret.f_[7] = f_[3] * rhs.f_[4] + f_[7] * rhs.f_[5] + f_[11] * rhs.f_[6] +
-              f_[15] * rhs.f_[7];
-
-  ret.f_[8] = f_[0] * rhs.f_[8] + f_[4] * rhs.f_[9] + f_[8] * rhs.f_[10] +
-              f_[12] * rhs.f_[11];
-  ret.f_[9] = f_[1] * rhs.f_[8] + f_[5] * rhs.f_[9] + f_[9] * rhs.f_[10] +
-              f_[13] * rhs.f_[11];
-  ret.f_[10] = f_[2] * rhs.f_[8] + f_[6] * rhs.f_[9] + f_[10] * rhs.f_[10] +
-               f_[14] * rhs.f_[11];
-  ret.f_[11] = f_[3] * rhs.f_[8] + f_[7] * rhs.f_[9] + f_[11] * rhs.f_[10] +
-               f_[15] * rhs.f_[11];
-
-  ret.f_[12] = f_[0] * rhs.f_[12] + f_[4] * rhs.f_[13] + f_[8] * rhs.f_[14] +
-               f_[12] * rhs.f_[15];
-  ret.f_[13] = f_[1] * rhs.f_[12] + f_[5] * rhs.f_[13] + f_[9] * rhs.f_[14] +
-               f_[13] * rhs.f_[15];
-  ret.f_[14] = f_[2] * rhs.f_[12] + f_[6] * rhs.f_[13] + f_[10] * rhs.f_[14] +
-               f_[14] * rhs.f_[15];
-  ret.f_[15] = f_[3] * rhs.f_[12] + f_[7] * rhs.f_[13] + f_[11] * rhs.f_[14] +
-               f_[15] * rhs.f_[15];
-
+  MultiplyMatrix(f_, rhs.f_, ret.f_);
   return ret;
 }
 
 Vec4 Mat4::operator*(const Vec4& rhs) const {
   Vec4 ret;
+#if defined(NDK_HELPER_VECMATH_NEON)
+  float32x4_t v = vmulq_n_f32(vld1q_f32(&f_[0]), rhs.x_);
+  v = vaddq_f32(v, vmulq_n_f32(vld1q_f32(&f_[4]), rhs.y_));
+  v = vaddq_f32(v, vmulq_n_f32(vld1q_f32(&f_[8]), rhs.z_));
+  v = vaddq_f32(v, vmulq_n_f32(vld1q_f32(&f_[12]), rhs.w_));
+  vst1q_f32(&ret.x_, v);
+#elif defined(NDK_HELPER_VECMATH_SSE)
+  __m128 v = _mm_mul_ps(_mm_loadu_ps(&f_[0]), _mm_set1_ps(rhs.x_));
+  v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(&f_[4]), _mm_set1_ps(rhs.y_)));
+  v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(&f_[8]), _mm_set1_ps(rhs.z_)));
+  v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(&f_[12]), _mm_set1_ps(rhs.w_)));
+  _mm_storeu_ps(&ret.x_, v);
+#else
   ret.x_ = rhs.x_ * f_[0] + rhs.y_ * f_[4] + rhs.z_ * f_[8] + rhs.w_ * f_[12];
   ret.y_ = rhs.x_ * f_[1] + rhs.y_ * f_[5] + rhs.z_ * f_[9] + rhs.w_ * f_[13];
   ret.z_ = rhs.x_ * f_[2] + rhs.y_ * f_[6] + rhs.z_ * f_[10] + rhs.w_ * f_[14];
   ret.w_ = rhs.x_ * f_[3] + rhs.y_ * f_[7] + rhs.z_ * f_[11] + rhs.w_ * f_[15];
+#endif
   return ret;
 }
 
@@ -177,6 +208,127 @@ Mat4 Mat4::Inverse() {
   return *this;
 }
 
+//--------------------------------------------------------------------------------
+// Batched operations
+//--------------------------------------------------------------------------------
+void Mat4::Multiply(const Mat4* lhs, const Mat4* rhs, Mat4* out,
+                    const int32_t count) {
+  for (int32_t i = 0; i < count; ++i) {
+    MultiplyMatrix(lhs[i].f_, rhs[i].f_, out[i].f_);
+  }
+}
+
+void Mat4::Multiply(const Mat4& lhs, const Mat4* rhs, Mat4* out,
+                    const int32_t count) {
+  for (int32_t i = 0; i < count; ++i) {
+    MultiplyMatrix(lhs.f_, rhs[i].f_, out[i].f_);
+  }
+}
+
+void Mat4::Transform(const Vec4Array& in, Vec4Array* out) const {
+  if (out->Size() != in.Size()) out->Resize(in.Size());
+
+  const float* x = in.X();
+  const float* y = in.Y();
+  const float* z = in.Z();
+  const float* w = in.W();
+  float* ox = out->X();
+  float* oy = out->Y();
+  float* oz = out->Z();
+  float* ow = out->W();
+  const int32_t stride = in.Stride();
+
+  // Same evaluation order as Mat4::operator*(const Vec4&), 4 vectors at a time
+#if defined(NDK_HELPER_VECMATH_NEON)
+  for (int32_t i = 0; i < stride; i += 4) {
+    const float32x4_t vx = vld1q_f32(x + i);
+    const float32x4_t vy = vld1q_f32(y + i);
+    const float32x4_t vz = vld1q_f32(z + i);
+    const float32x4_t vw = vld1q_f32(w + i);
+    float* dst[4] = {ox + i, oy + i, oz + i, ow + i};
+    for (int32_t r = 0; r < 4; ++r) {
+      float32x4_t v = vmulq_n_f32(vx, f_[r]);
+      v = vaddq_f32(v, vmulq_n_f32(vy, f_[4 + r]));
+      v = vaddq_f32(v, vmulq_n_f32(vz, f_[8 + r]));
+      v = vaddq_f32(v, vmulq_n_f32(vw, f_[12 + r]));
+      vst1q_f32(dst[r], v);
+    }
+  }
+#elif defined(NDK_HELPER_VECMATH_SSE)
+  for (int32_t i = 0; i < stride; i += 4) {
+    const __m128 vx = _mm_load_ps(x + i);
+    const __m128 vy = _mm_load_ps(y + i);
+    const __m128 vz = _mm_load_ps(z + i);
+    const __m128 vw = _mm_load_ps(w + i);
+    float* dst[4] = {ox + i, oy + i, oz + i, ow + i};
+    for (int32_t r = 0; r < 4; ++r) {
+      __m128 v = _mm_mul_ps(vx, _mm_set1_ps(f_[r]));
+      v = _mm_add_ps(v, _mm_mul_ps(vy, _mm_set1_ps(f_[4 + r])));
+      v = _mm_add_ps(v, _mm_mul_ps(vz, _mm_set1_ps(f_[8 + r])));
+      v = _mm_add_ps(v, _mm_mul_ps(vw, _mm_set1_ps(f_[12 + r])));
+      _mm_store_ps(dst[r], v);
+    }
+  }
+#else
+  for (int32_t i = 0; i < stride; ++i) {
+    const float vx = x[i], vy = y[i], vz = z[i], vw = w[i];
+    ox[i] = vx * f_[0] + vy * f_[4] + vz * f_[8] + vw * f_[12];
+    oy[i] = vx * f_[1] + vy * f_[5] + vz * f_[9] + vw * f_[13];
+    oz[i] = vx * f_[2] + vy * f_[6] + vz * f_[10] + vw * f_[14];
+    ow[i] = vx * f_[3] + vy * f_[7] + vz * f_[11] + vw * f_[15];
+  }
+#endif
+}
+
+//--------------------------------------------------------------------------------
+// Vec4Array
+//--------------------------------------------------------------------------------
+void Vec4Array::Resize(const int32_t size) {
+  const int32_t kAlignment = 4;  // in floats, 16 bytes
+  size_ = size;
+  stride_ = (size + kAlignment - 1) & ~(kAlignment - 1);
+
+  // One allocation for all 4 components with room to align the first one
+  storage_.assign(stride_ * 4 + kAlignment, 0.f);
+  uintptr_t base = reinterpret_cast<uintptr_t>(storage_.data());
+  uintptr_t aligned = (base + kAlignment * sizeof(float) - 1) &
+                      ~(uintptr_t)(kAlignment * sizeof(float) - 1);
+  x_ = reinterpret_cast<float*>(aligned);
+  y_ = x_ + stride_;
+  z_ = y_ + stride_;
+  w_ = z_ + stride_;
+}
+
+void Vec4Array::SetPositions(const float* xyz, const int32_t count,
+                             const float fW) {
+  if (count != size_) Resize(count);
+  for (int32_t i = 0; i < count; ++i) {
+    x_[i] = xyz[i * 3];
+    y_[i] = xyz[i * 3 + 1];
+    z_[i] = xyz[i * 3 + 2];
+    w_[i] = fW;
+  }
+}
+
+void Vec4Array::GetPositions(float* xyz) const {
+  for (int32_t i = 0; i < size_; ++i) {
+    xyz[i * 3] = x_[i];
+    xyz[i * 3 + 1] = y_[i];
+    xyz[i * 3 + 2] = z_[i];
+  }
+}
+
+void Vec4Array::Set(const int32_t index, const Vec4& vec) {
+  x_[index] = vec.x_;
+  y_[index] = vec.y_;
+  z_[index] = vec.z_;
+  w_[index] = vec.w_;
+}
+
+Vec4 Vec4Array::Get(const int32_t index) const {
+  return Vec4(x_[index], y_[index], z_[index], w_[index]);
+}
+
 //--------------------------------------------------------------------------------
 // Misc
 //--------------------------------------------------------------------------------
@@ -18,23 +18,46 @@
 #define VECMATH_H_
 
 #include <cmath>
+#include <vector>
+#if defined(__ANDROID__)
 #include "JNIHelper.h"
+#else
+// Host tools (tools/vecmath_benchmark) build vecmath without JNIHelper
+#include <stdint.h>
+#include <stdio.h>
+#ifndef LOGI
+#define LOGI(...) (printf(__VA_ARGS__), printf("\n"))
+#endif
+#endif
 
 namespace ndk_helper {
 
 /******************************************************************
  * Helper class for vector math operations
- * Currently all implementations are in pure C++.
  * Each class is an opaque class so caller does not have a direct access
  * to each element. This is for an ease of future optimization to use vector
  *operations.
  *
+ * Mat4 x Mat4 and Mat4 x Vec4 products use NEON (armeabi-v7a, arm64-v8a) or
+ * SSE (x86, x86_64) when available, other operations are in pure C++.
+ * The vector paths keep the column major layout and the evaluation order of
+ * the C++ implementation, so both produce the same results.
+ * Define NDK_HELPER_VECMATH_SCALAR to force the C++ implementation.
+ *
  */
+#if !defined(NDK_HELPER_VECMATH_SCALAR)
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define NDK_HELPER_VECMATH_NEON 1
+#elif defined(__SSE__) || defined(__x86_64__)
+#define NDK_HELPER_VECMATH_SSE 1
+#endif
+#endif
 
 class Vec2;
 class Vec3;
 class Vec4;
 class Mat4;
+class Vec4Array;
 
 /******************************************************************
  * 2 elements vector class
@@ -410,6 +433,7 @@ class Vec4 {
  public:
   friend class Vec3;
   friend class Mat4;
+  friend class Vec4Array;
   friend class Quaternion;
 
   Vec4() { x_ = y_ = z_ = w_ = 0.f; }
@@ -669,44 +693,7 @@ class Mat4 {
   }
 
   Mat4& operator*=(const Mat4& rhs) {
-    Mat4 ret;
-    ret.f_[0] = f_[0] * rhs.f_[0] + f_[4] * rhs.f_[1] + f_[8] * rhs.f_[2] +
-                f_[12] * rhs.f_[3];
-    ret.f_[1] = f_[1] * rhs.f_[0] + f_[5] * rhs.f_[1] + f_[9] * rhs.f_[2] +
-                f_[13] * rhs.f_[3];
-    ret.f_[2] = f_[2] * rhs.f_[0] + f_[6] * rhs.f_[1] + f_[10] * rhs.f_[2] +
-                f_[14] * rhs.f_[3];
-    ret.f_[3] = f_[3] * rhs.f_[0] + f_[7] * rhs.f_[1] + f_[11] * rhs.f_[2] +
-                f_[15] * rhs.f_[3];
-
-    ret.f_[4] = f_[0] * rhs.f_[4] + f_[4] * rhs.f_[5] + f_[8] * rhs.f_[6] +
-                f_[12] * rhs.f_[7];
-    ret.f_[5] = f_[1] * rhs.f_[4] + f_[5] * rhs.f_[5] + f_[9] * rhs.f_[6] +
-                f_[13] * rhs.f_[7];
-    ret.f_[6] = f_[2] * rhs.f_[4] + f_[6] * rhs.f_[5] + f_[10] * rhs.f_[6] +
-                f_[14] * rhs.f_[7];
-    ret.f_[7] = f_[3] * rhs.f_[4] + f_[7] * rhs.f_[5] + f_[11] * rhs.f_[6] +
-                f_[15] * rhs.f_[7];
-
-    ret.f_[8] = f_[0] * rhs.f_[8] + f_[4] * rhs.f_[9] + f_[8] * rhs.f_[10] +
-                f_[12] * rhs.f_[11];
-    ret.f_[9] = f_[1] * rhs.f_[8] + f_[5] * rhs.f_[9] + f_[9] * rhs.f_[10] +
-                f_[13] * rhs.f_[11];
-    ret.f_[10] = f_[2] * rhs.f_[8] + f_[6] * rhs.f_[9] + f_[10] * rhs.f_[10] +
-                 f_[14] * rhs.f_[11];
-    ret.f_[11] = f_[3] * rhs.f_[8] + f_[7] * rhs.f_[9] + f_[11] * rhs.f_[10] +
-                 f_[15] * rhs.f_[11];
-
-    ret.f_[12] = f_[0] * rhs.f_[12] + f_[4] * rhs.f_[13] + f_[8] * rhs.f_[14] +
-                 f_[12] * rhs.f_[15];
-    ret.f_[13] = f_[1] * rhs.f_[12] + f_[5] * rhs.f_[13] + f_[9] * rhs.f_[14] +
-                 f_[13] * rhs.f_[15];
-    ret.f_[14] = f_[2] * rhs.f_[12] + f_[6] * rhs.f_[13] + f_[10] * rhs.f_[14] +
-                 f_[14] * rhs.f_[15];
-    ret.f_[15] = f_[3] * rhs.f_[12] + f_[7] * rhs.f_[13] + f_[11] * rhs.f_[14] +
-                 f_[15] * rhs.f_[15];
-
-    *this = ret;
+    *this = *this * rhs;
     return *this;
   }
 
@@ -786,6 +773,18 @@ class Mat4 {
 
   static Mat4 Scale(const float scaleX, const float scaleY, const float scaleZ);
 
+  //--------------------------------------------------------------------------------
+  // Batched operations
+  //--------------------------------------------------------------------------------
+  // out[i] = lhs[i] * rhs[i]
+  static void Multiply(const Mat4* lhs, const Mat4* rhs, Mat4* out,
+                       const int32_t count);
+  // out[i] = lhs * rhs[i], e.g. view * model for many objects
+  static void Multiply(const Mat4& lhs, const Mat4* rhs, Mat4* out,
+                       const int32_t count);
+  // out[i] = *this * in[i], out is resized to in.Size() if needed
+  void Transform(const Vec4Array& in, Vec4Array* out) const;
+
   static Mat4 Identity() {
     Mat4 ret;
     ret.f_[0] = 1.f;
@@ -815,6 +814,58 @@ class Mat4 {
   }
 };
 
+/******************************************************************
+ * Structure of arrays buffer of 4 elements vectors
+ * Each component is stored in its own 16 bytes aligned array, padded to a
+ * multiple of 4 elements, so batched operations such as Mat4::Transform()
+ * can process 4 vectors per SIMD instruction without a scalar tail.
+ * Padding elements are zero.
+ *
+ */
+class Vec4Array {
+ private:
+  std::vector<float> storage_;
+  float* x_;
+  float* y_;
+  float* z_;
+  float* w_;
+  int32_t size_;
+  int32_t stride_;
+
+  Vec4Array(const Vec4Array&);
+  void operator=(const Vec4Array&);
+
+ public:
+  Vec4Array() : x_(NULL), y_(NULL), z_(NULL), w_(NULL), size_(0), stride_(0) {}
+  explicit Vec4Array(const int32_t size)
+      : x_(NULL), y_(NULL), z_(NULL), w_(NULL), size_(0), stride_(0) {
+    Resize(size);
+  }
+
+  // Every element is reset to zero, whatever the new size.
+  void Resize(const int32_t size);
+
+  // Fill from/to interleaved xyz positions, w is set to fW.
+  void SetPositions(const float* xyz, const int32_t count, const float fW);
+  void GetPositions(float* xyz) const;
+
+  void Set(const int32_t index, const Vec4& vec);
+  Vec4 Get(const int32_t index) const;
+
+  int32_t Size() const { return size_; }
+  // Number of elements in each component array, including padding
+  int32_t Stride() const { return stride_; }
+
+  float* X() { return x_; }
+  float* Y() { return y_; }
+  float* Z() { return z_; }
+  float* W() { return w_; }
+  const float* X() const { return x_; }
+  const float* Y() const { return y_; }
+  const float* Z() const { return z_; }
+  const float* W() const { return w_; }
+};
+
 /******************************************************************
  * Quaternion class
  *
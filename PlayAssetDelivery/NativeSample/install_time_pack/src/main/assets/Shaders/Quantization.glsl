@@ -0,0 +1,34 @@
+//
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Quantization.glsl
+//  Decoding of the quantized mesh layout, see MeshFormat.h.
+//  Pulled in with #include by shader::Preprocessor.
+//
+
+// Position dequantization, identity for float meshes
+uniform highp vec3      uPositionScale;
+uniform highp vec3      uPositionBias;
+
+// Octahedral normal decode for the quantized mesh layout. Lighting shaders
+// feed the xy of myNormal through this; the textured teapot is unlit.
+mediump vec3 decodeNormal(mediump vec2 e)
+{
+    mediump vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * (step(0.0, n.xy) * 2.0 - 1.0);
+    }
+    return normalize(n);
+}
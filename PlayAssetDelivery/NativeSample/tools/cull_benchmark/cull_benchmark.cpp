@@ -0,0 +1,150 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// cull_benchmark.cpp
+// Host tool timing CullSpheres() of Teapot/src/main/cpp/FrustumCull.h, NEON
+// or SSE2 where the target has them, against CullSpheresScalar() on the
+// same random spheres and perspective frustum. Fails unless both find the
+// same visible spheres.
+//
+// usage: cull_benchmark [--count N] [--runs N]
+//   --count  spheres, 4096 by default
+//   --runs   timed runs per path, the best is kept, 20 by default
+//--------------------------------------------------------------------------------
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "FrustumCull.h"
+
+static double NowNs() {
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Reproducible from run to run, in [low, high)
+static void FillRandom(std::vector<float>* values, uint32_t seed, float low,
+                       float high) {
+  for (size_t i = 0; i < values->size(); ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    (*values)[i] = low + (high - low) * ((seed >> 8) / 16777216.f);
+  }
+}
+
+/*
+ * Column major perspective projection looking down -z, as
+ * ndk_helper::Mat4::Perspective() builds it
+ */
+static void Perspective(float fov_y, float aspect, float near_plane,
+                        float far_plane, float* m) {
+  float f = 1.f / tanf(fov_y / 2.f);
+  memset(m, 0, 16 * sizeof(float));
+  m[0] = f / aspect;
+  m[5] = f;
+  m[10] = (far_plane + near_plane) / (near_plane - far_plane);
+  m[11] = -1.f;
+  m[14] = 2.f * far_plane * near_plane / (near_plane - far_plane);
+}
+
+/*
+ * Best of runs, in ns per sphere. Each run repeats the culling until it
+ * has taken a millisecond, so small counts aren't lost in the timer.
+ */
+template <typename F>
+static double Measure(int32_t runs, size_t spheres, F run) {
+  double best = 0.0;
+  for (int32_t i = 0; i < runs; ++i) {
+    int32_t repeats = 0;
+    double start = NowNs();
+    double ns;
+    do {
+      run();
+      ++repeats;
+      ns = NowNs() - start;
+    } while (ns < 1e6);
+    ns /= static_cast<double>(repeats) * spheres;
+    if (i == 0 || ns < best) best = ns;
+  }
+  return best;
+}
+
+int main(int argc, char** argv) {
+  int32_t count = 4096;
+  int32_t runs = 20;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--count") && i + 1 < argc) {
+      count = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--runs") && i + 1 < argc) {
+      runs = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--count N] [--runs N]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (count <= 0 || runs <= 0) {
+    fprintf(stderr, "Counts must be positive\n");
+    return 1;
+  }
+
+  // A box around the view, so that some spheres are in, some out and some
+  // across a plane
+  SPHERES_SOA spheres;
+  spheres.Resize(count);
+  FillRandom(&spheres.x, 1, -12.f, 12.f);
+  FillRandom(&spheres.y, 2, -12.f, 12.f);
+  FillRandom(&spheres.z, 3, -24.f, 2.f);
+  FillRandom(&spheres.radius, 4, 0.05f, 1.f);
+  float matrix[16];
+  Perspective(1.f, 16.f / 9.f, 1.f, 20.f, matrix);
+  FRUSTUM frustum;
+  ExtractFrustum(matrix, &frustum);
+
+  std::vector<uint32_t> simd_visible(count);
+  std::vector<uint32_t> scalar_visible(count);
+  size_t simd_count = 0;
+  size_t scalar_count = 0;
+  double simd_ns = Measure(runs, count, [&] {
+    simd_count = CullSpheres(frustum, spheres, simd_visible.data());
+  });
+  double scalar_ns = Measure(runs, count, [&] {
+    scalar_count =
+        CullSpheresScalar(frustum, spheres, 0, scalar_visible.data());
+  });
+
+  // Past the count the buffers hold scratch indices, leave them out
+  bool same = simd_count == scalar_count &&
+              memcmp(simd_visible.data(), scalar_visible.data(),
+                     simd_count * sizeof(uint32_t)) == 0;
+  printf("%d spheres, %.1f%% visible\n", count, 100.0 * scalar_count / count);
+  printf("  %-12s %8.2f ns/sphere %10.0f spheres/ms\n", "CullSpheres", simd_ns,
+         simd_ns > 0 ? 1e6 / simd_ns : 0.0);
+  printf("  %-12s %8.2f ns/sphere %10.0f spheres/ms\n", "Scalar", scalar_ns,
+         scalar_ns > 0 ? 1e6 / scalar_ns : 0.0);
+  printf("  %.2fx%s\n", simd_ns > 0 ? scalar_ns / simd_ns : 0.0,
+         same ? "" : "  results differ");
+  if (!same) {
+    fprintf(stderr, "CullSpheres() and CullSpheresScalar() disagree\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// frame_pacing.cpp
+// Host tool running the frame loop of TeapotNativeActivity against
+// common/ndk_helper/frameScheduler.h on a fake vsync clock. Frames take a
+// made up amount of work; nothing sleeps, so a run takes no time.
+// Fails when the pacing breaks a rule: the looper spinning without drawing,
+// a frame begun earlier than its deadline needs, present times going back,
+// no vsync coming at all, the period estimate ending more than 1% off, or
+// more than 1 present in 20 off the vsync grid or changing cadence.
+//
+// usage: frame_pacing [--period-ms N] [--work-ms N] [--jitter-ms N]
+//                     [--frames N] [--switch-ms N]
+//   --period-ms  display refresh period, 16.667 by default
+//   --work-ms    mean frame time, 4 by default
+//   --jitter-ms  frame times are spread evenly this much around the mean
+//   --frames     frames to draw, 600 by default
+//   --switch-ms  refresh period from half way on, as on a rate switch
+//--------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "frameScheduler.h"
+
+using ndk_helper::FakeVsync;
+using ndk_helper::FrameScheduler;
+
+static const int64_t kMsToNs = 1000000;
+
+static int64_t ParseMs(const char *arg) {
+  return static_cast<int64_t>(atof(arg) * kMsToNs);
+}
+
+// Frame times are reproducible from run to run
+static int64_t NextWork(int64_t work_ns, int64_t jitter_ns, uint32_t *seed) {
+  *seed = *seed * 1664525u + 1013904223u;
+  double unit = (*seed >> 8) / static_cast<double>(1 << 24);
+  return std::max(int64_t(0),
+                  work_ns + static_cast<int64_t>((unit * 2 - 1) * jitter_ns));
+}
+
+int main(int argc, char **argv) {
+  int64_t period_ns = 16666667;
+  int64_t work_ns = 4 * kMsToNs;
+  int64_t jitter_ns = kMsToNs;
+  uint32_t frames = 600;
+  int64_t switch_ns = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--period-ms") && i + 1 < argc) {
+      period_ns = ParseMs(argv[++i]);
+    } else if (!strcmp(argv[i], "--work-ms") && i + 1 < argc) {
+      work_ns = ParseMs(argv[++i]);
+    } else if (!strcmp(argv[i], "--jitter-ms") && i + 1 < argc) {
+      jitter_ns = ParseMs(argv[++i]);
+    } else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+      frames = static_cast<uint32_t>(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--switch-ms") && i + 1 < argc) {
+      switch_ns = ParseMs(argv[++i]);
+    } else {
+      fprintf(stderr,
+              "usage: %s [--period-ms N] [--work-ms N] [--jitter-ms N] "
+              "[--frames N] [--switch-ms N]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (period_ns <= 0 || switch_ns < 0) {
+    fprintf(stderr, "Periods must be positive\n");
+    return 1;
+  }
+
+  FakeVsync vsync(period_ns);
+  FrameScheduler scheduler;
+  // Started at 60Hz whatever the display, as on device before the first
+  // refresh rate callback
+  scheduler.Init(&vsync);
+
+  int64_t now = 0;
+  int64_t last_present = 0;
+  int64_t slack_sum = 0;
+  int64_t uneven = 0;
+  int64_t last_periods = 0;
+  uint32_t drawn = 0;
+  uint32_t spins = 0;
+  uint32_t seed = 1;
+  while (drawn < frames) {
+    if (switch_ns && drawn == frames / 2) {
+      vsync.SetPeriod(switch_ns);
+      period_ns = switch_ns;
+      switch_ns = 0;
+    }
+    // What the main loop does, with ALooper_pollOnce() returning at the
+    // vsync callback or the timeout
+    vsync.AdvanceTo(now);
+    scheduler.Schedule();
+    int32_t timeout = scheduler.GetPollTimeout(now);
+    int64_t frame_time = vsync.GetNextFrameTime();
+    if (frame_time >= 0 &&
+        (timeout < 0 || frame_time < now + timeout * kMsToNs)) {
+      now = std::max(now, frame_time);
+      continue;
+    }
+    if (timeout < 0) {
+      fprintf(stderr, "Frame %u: waiting for a vsync never requested\n",
+              drawn);
+      return 1;
+    }
+    now += timeout * kMsToNs;
+
+    ndk_helper::FRAME_TIMING timing;
+    uint32_t late = scheduler.GetLateCount();
+    if (!scheduler.BeginFrame(now, &timing)) {
+      ++spins;
+      continue;
+    }
+    // Unless moved to a later vsync
+    if (late == scheduler.GetLateCount() &&
+        now + FrameScheduler::kPollResolutionNs <
+            timing.deadline_ns - scheduler.GetPredictedWork() -
+                scheduler.GetPeriod() / 4) {
+      fprintf(stderr, "Frame %u: begun earlier than its deadline needs\n",
+              drawn);
+      return 1;
+    }
+    if (timing.present_ns <= last_present) {
+      fprintf(stderr, "Frame %u: present time went back\n", drawn);
+      return 1;
+    }
+    // Off the vsync grid, or a cadence change
+    int64_t interval = timing.present_ns - last_present;
+    int64_t periods = (interval + period_ns / 2) / period_ns;
+    if (last_present &&
+        (std::abs(interval - periods * period_ns) * 8 > period_ns ||
+         periods != last_periods)) {
+      ++uneven;
+    }
+    last_periods = periods;
+    last_present = timing.present_ns;
+    slack_sum += timing.deadline_ns - now;
+
+    now += NextWork(work_ns, jitter_ns, &seed);
+    scheduler.EndFrame(now);
+    ++drawn;
+  }
+
+  printf("%u frames, %.3f ms period\n", drawn, period_ns * 1e-6);
+  printf("  estimated period      %8.3f ms\n", scheduler.GetPeriod() * 1e-6);
+  printf("  predicted frame time  %8.3f ms\n",
+         scheduler.GetPredictedWork() * 1e-6);
+  printf("  swap interval         %8d vsyncs\n", scheduler.GetSwapInterval());
+  printf("  start before deadline %8.3f ms mean\n", slack_sum * 1e-6 / drawn);
+  printf("  missed deadlines      %8u\n", scheduler.GetMissedCount());
+  printf("  moved to a later vsync%8u\n", scheduler.GetLateCount());
+  printf("  uneven present times  %8lld\n", static_cast<long long>(uneven));
+  printf("  polls without a frame %8u\n", spins);
+
+  bool failed = false;
+  if (spins) {
+    fprintf(stderr, "The looper woke without drawing\n");
+    failed = true;
+  }
+  if (std::abs(scheduler.GetPeriod() - period_ns) * 100 > period_ns) {
+    fprintf(stderr, "The period estimate is off\n");
+    failed = true;
+  }
+  // A rate switch costs a few until the new period is measured
+  if (uneven * 20 > drawn) {
+    fprintf(stderr, "Too many uneven present times\n");
+    failed = true;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// job_benchmark.cpp
+// Host tool measuring the scheduling overhead per job of
+// common/ndk_helper/jobSystem.h. Every job is empty, so the times are the
+// scheduler's own cost.
+//
+// usage: job_benchmark [--workers N] [--jobs N]
+//   --workers  worker threads, by default picked from the CPU topology
+//   --jobs     jobs per measurement, 100000 by default
+//--------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#include "jobSystem.h"
+
+using ndk_helper::Job;
+using ndk_helper::JobSystem;
+
+static std::atomic<uint32_t> g_executed(0);
+
+static void EmptyJob(Job *, void *) {
+  g_executed.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Spawns its count of empty children from inside a job, on a worker deque
+static void SpawnJob(Job *job, void *data) {
+  uint32_t count;
+  memcpy(&count, data, sizeof(count));
+  JobSystem *jobs = JobSystem::GetInstance();
+  for (uint32_t i = 0; i < count; ++i) {
+    jobs->Run(jobs->CreateChild(job, EmptyJob));
+  }
+}
+
+static void EmptyRange(uint32_t begin, uint32_t end, void *) {
+  g_executed.fetch_add(end - begin, std::memory_order_relaxed);
+}
+
+static double NowNs() {
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * Best of a few runs, in ns per job; the first run also warms up the
+ * workers. Checks that every job ran.
+ */
+template <typename F>
+static double Measure(uint32_t jobs, uint32_t expected, F run) {
+  const int kRuns = 5;
+  double best = 0.0;
+  for (int i = 0; i < kRuns; ++i) {
+    g_executed.store(0);
+    double start = NowNs();
+    run();
+    double ns = (NowNs() - start) / jobs;
+    if (g_executed.load() != expected) {
+      fprintf(stderr, "%u of %u jobs ran\n", g_executed.load(), expected);
+      exit(1);
+    }
+    if (i == 0 || ns < best) best = ns;
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  int32_t workers = -1;
+  uint32_t count = 100000;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--workers") && i + 1 < argc) {
+      workers = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--jobs") && i + 1 < argc) {
+      count = static_cast<uint32_t>(atoi(argv[++i]));
+    } else {
+      fprintf(stderr, "usage: %s [--workers N] [--jobs N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  ndk_helper::CPU_TOPOLOGY topology = JobSystem::GetCpuTopology();
+  JobSystem *jobs = JobSystem::GetInstance();
+  jobs->Init(workers);
+  printf("%d cores, %d fast, %d workers, %u jobs per run\n", topology.cores,
+         topology.fast_cores, jobs->GetWorkerCount(), count);
+
+  // A job ring holds kMaxJobs, keep the children of one spawn below that
+  const uint32_t spawn = std::min(count, JobSystem::kMaxJobs / 2);
+  const uint32_t rounds = std::max(1u, count / spawn);
+  printf("  spawn from a job      %8.1f ns/job\n",
+         Measure(spawn * rounds, spawn * rounds, [&] {
+           for (uint32_t r = 0; r < rounds; ++r) {
+             Job *root = jobs->Create(SpawnJob, &spawn, sizeof(spawn));
+             jobs->Run(root);
+             jobs->Wait(root);
+           }
+         }));
+
+  printf("  run and wait, one     %8.1f ns/job\n",
+         Measure(count, count, [&] {
+           for (uint32_t i = 0; i < count; ++i) {
+             Job *job = jobs->Create(EmptyJob);
+             jobs->Run(job);
+             jobs->Wait(job);
+           }
+         }));
+
+  // Each split is a job, so about count / batch of them per loop. Without
+  // workers the whole loop is a single call.
+  const uint32_t kBatches[] = {1, 16, 256};
+  for (uint32_t batch : kBatches) {
+    printf("  parallel for, batch %-3u%7.1f ns/item\n", batch,
+           Measure(count, count, [&] {
+             jobs->ParallelFor(count, batch, EmptyRange, NULL);
+           }));
+  }
+
+  jobs->Shutdown();
+  return 0;
+}
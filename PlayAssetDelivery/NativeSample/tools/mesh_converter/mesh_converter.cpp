@@ -0,0 +1,460 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// mesh_converter.cpp
+// Host tool converting the teapot model tables (teapot.inl) into the binary
+// mesh format loaded by Teapot/src/main/cpp/Mesh.cpp.
+//
+// usage: mesh_converter [--tiled] [--quantize] [--no-optimize] <output.mesh>
+//   --tiled     keep the tiled texture coordinates of the model instead of
+//               stretching one copy of the texture over the teapot
+//   --quantize  write the compact 16 byte vertex layout (see MeshFormat.h)
+//               and check its error against the float mesh
+//   --no-optimize  keep the triangle and vertex order of the model instead of
+//                  reordering them for the vertex cache (mesh_optimizer.h)
+//--------------------------------------------------------------------------------
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "MeshFormat.h"
+#include "mesh_optimizer.h"
+
+//--------------------------------------------------------------------------------
+// Teapot model data
+//--------------------------------------------------------------------------------
+#include "teapot.inl"
+
+/**
+ * Mesh in structure of arrays form, as it comes from the model tables.
+ */
+struct MeshData {
+  std::vector<float> positions;  // xyz
+  std::vector<float> normals;    // xyz
+  std::vector<float> uvs;        // uv
+  std::vector<uint16_t> indices;
+
+  size_t VertexCount() const { return positions.size() / 3; }
+};
+
+static void LoadTeapot(bool tiled, MeshData *mesh) {
+  const size_t vertex_count =
+      sizeof(teapotPositions) / sizeof(teapotPositions[0]) / 3;
+  mesh->positions.assign(teapotPositions, teapotPositions + vertex_count * 3);
+  mesh->normals.assign(teapotNormals, teapotNormals + vertex_count * 3);
+
+  // The model stores 3 texture coordinates per vertex with the texture tiled
+  // twice. Halving u and v stretches a single copy over the teapot.
+  const float uv_scale = tiled ? 1.f : 0.5f;
+  mesh->uvs.resize(vertex_count * 2);
+  for (size_t i = 0; i < vertex_count; ++i) {
+    mesh->uvs[i * 2] = teapotTexCoords[i * 3] * uv_scale;
+    mesh->uvs[i * 2 + 1] = teapotTexCoords[i * 3 + 1] * uv_scale;
+  }
+
+  mesh->indices.assign(
+      teapotIndices,
+      teapotIndices + sizeof(teapotIndices) / sizeof(teapotIndices[0]));
+}
+
+/**
+ * Reorder triangles for the post-transform cache, then vertices for fetch
+ * locality, and report the cache efficiency before and after.
+ */
+static void OptimizeMesh(MeshData *mesh) {
+  // Common FIFO sizes on mobile GPUs
+  const uint32_t cache_sizes[] = {16, 32};
+  const size_t cache_size_count = sizeof(cache_sizes) / sizeof(cache_sizes[0]);
+  VertexCacheStats before[cache_size_count];
+  for (size_t i = 0; i < cache_size_count; ++i) {
+    before[i] = AnalyzeVertexCache(mesh->indices.data(), mesh->indices.size(),
+                                   mesh->VertexCount(), cache_sizes[i]);
+  }
+
+  // The optimizer is greedy; a model that already comes in a cache friendly
+  // order (the teapot's patch grids are) can end up slightly worse, so only
+  // keep the new triangle order when it simulates better on the small cache.
+  std::vector<uint16_t> source_order(mesh->indices);
+  OptimizeVertexCache(mesh->indices.data(), mesh->indices.size(),
+                      mesh->VertexCount());
+  VertexCacheStats optimized =
+      AnalyzeVertexCache(mesh->indices.data(), mesh->indices.size(),
+                         mesh->VertexCount(), cache_sizes[0]);
+  if (optimized.transformed > before[0].transformed) {
+    printf("Vertex cache: keeping the source triangle order\n");
+    mesh->indices.swap(source_order);
+  }
+  std::vector<uint32_t> remap;
+  size_t vertex_count =
+      OptimizeVertexFetch(mesh->indices.data(), mesh->indices.size(),
+                          mesh->VertexCount(), &remap);
+  RemapVertices(remap, vertex_count, 3, &mesh->positions);
+  RemapVertices(remap, vertex_count, 3, &mesh->normals);
+  RemapVertices(remap, vertex_count, 2, &mesh->uvs);
+
+  for (size_t i = 0; i < cache_size_count; ++i) {
+    VertexCacheStats after =
+        AnalyzeVertexCache(mesh->indices.data(), mesh->indices.size(),
+                           mesh->VertexCount(), cache_sizes[i]);
+    printf("Vertex cache FIFO %u: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+           cache_sizes[i], before[i].acmr, after.acmr, before[i].atvr,
+           after.atvr);
+  }
+}
+
+static void AddAttribute(MESH_FILE_HEADER *header, uint32_t semantic,
+                         uint32_t components, uint32_t type,
+                         uint32_t normalized, uint32_t encoding,
+                         uint32_t size) {
+  MESH_ATTRIBUTE &attr = header->attributes[header->attribute_count++];
+  attr.semantic = semantic;
+  attr.components = components;
+  attr.type = type;
+  attr.normalized = normalized;
+  attr.offset = header->vertex_stride;
+  attr.encoding = encoding;
+  header->vertex_stride += size;
+}
+
+template <typename T>
+static void Append(std::vector<uint8_t> *out, const T *values, size_t count) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(values);
+  out->insert(out->end(), bytes, bytes + count * sizeof(T));
+}
+
+//--------------------------------------------------------------------------------
+// Quantization helpers
+//--------------------------------------------------------------------------------
+static uint16_t FloatToHalf(float f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  const uint32_t sign = (bits >> 16) & 0x8000;
+  const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  if (exponent >= 31) return sign | 0x7c00;  // overflow to infinity
+  if (exponent <= 0) {
+    // Denormal or zero
+    if (exponent < -10) return sign;
+    mantissa |= 0x800000;
+    const uint32_t shift = 14 - exponent;
+    uint32_t half = mantissa >> shift;
+    const uint32_t rest = mantissa & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1))) ++half;
+    return sign | half;
+  }
+  uint32_t half = (exponent << 10) | (mantissa >> 13);
+  const uint32_t rest = mantissa & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) ++half;
+  return sign | half;  // a carry into the exponent is still correct
+}
+
+static float HalfToFloat(uint16_t h) {
+  const int32_t exponent = (h >> 10) & 0x1f;
+  const int32_t mantissa = h & 0x3ff;
+  float f;
+  if (exponent == 0) {
+    f = ldexpf(static_cast<float>(mantissa), -24);
+  } else if (exponent == 31) {
+    f = INFINITY;
+  } else {
+    f = ldexpf(static_cast<float>(mantissa | 0x400), exponent - 25);
+  }
+  return (h & 0x8000) ? -f : f;
+}
+
+static float SignNotZero(float f) { return f < 0.f ? -1.f : 1.f; }
+
+static int32_t ToSnorm10(float f) {
+  return static_cast<int32_t>(roundf(std::max(-1.f, std::min(1.f, f)) * 511.f));
+}
+
+static float FromSnorm10(int32_t i) {
+  // Same conversion as GLES3 for normalized signed attributes
+  return std::max(static_cast<float>(i) / 511.f, -1.f);
+}
+
+// Mirrors decodeNormal() in the vertex shaders
+static void DecodeOctahedral(float ex, float ey, float *n) {
+  n[0] = ex;
+  n[1] = ey;
+  n[2] = 1.f - fabsf(ex) - fabsf(ey);
+  if (n[2] < 0.f) {
+    n[0] = (1.f - fabsf(ey)) * SignNotZero(ex);
+    n[1] = (1.f - fabsf(ex)) * SignNotZero(ey);
+  }
+  const float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+  for (int32_t c = 0; c < 3; ++c) n[c] /= len;
+}
+
+static float AngleDegrees(const float *a, const float *b) {
+  const float len_a = sqrtf(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+  const float len_b = sqrtf(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+  float d = (a[0] * b[0] + a[1] * b[1] + a[2] * b[2]) / (len_a * len_b);
+  d = std::max(-1.f, std::min(1.f, d));
+  return acosf(d) * 180.f / static_cast<float>(M_PI);
+}
+
+/**
+ * Octahedral encode a normal into x/y of a signed 10:10:10:2 value.
+ * Of the four snorm roundings around the exact encoding, the one that decodes
+ * closest to the input is kept.
+ */
+static uint32_t EncodeNormal(const float *normal) {
+  const float l1 = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+  float ex = normal[0] / l1;
+  float ey = normal[1] / l1;
+  if (normal[2] < 0.f) {
+    const float x = ex;
+    ex = (1.f - fabsf(ey)) * SignNotZero(x);
+    ey = (1.f - fabsf(x)) * SignNotZero(ey);
+  }
+
+  const int32_t base_x = static_cast<int32_t>(floorf(ex * 511.f));
+  const int32_t base_y = static_cast<int32_t>(floorf(ey * 511.f));
+  int32_t best_x = ToSnorm10(ex);
+  int32_t best_y = ToSnorm10(ey);
+  float best_error = 360.f;
+  for (int32_t i = 0; i < 4; ++i) {
+    const int32_t qx = std::max(-511, std::min(511, base_x + (i & 1)));
+    const int32_t qy = std::max(-511, std::min(511, base_y + (i >> 1)));
+    float decoded[3];
+    DecodeOctahedral(FromSnorm10(qx), FromSnorm10(qy), decoded);
+    const float error = AngleDegrees(normal, decoded);
+    if (error < best_error) {
+      best_error = error;
+      best_x = qx;
+      best_y = qy;
+    }
+  }
+  return (static_cast<uint32_t>(best_x) & 0x3ff) |
+         ((static_cast<uint32_t>(best_y) & 0x3ff) << 10);
+}
+
+static void DecodeNormal(uint32_t packed, float *n) {
+  // Sign extend the 10 bit fields
+  const int32_t qx = static_cast<int32_t>(packed << 22) >> 22;
+  const int32_t qy = static_cast<int32_t>(packed << 12) >> 22;
+  DecodeOctahedral(FromSnorm10(qx), FromSnorm10(qy), n);
+}
+
+//--------------------------------------------------------------------------------
+// Vertex layouts
+//--------------------------------------------------------------------------------
+static void ComputeBounds(const MeshData &mesh, MESH_FILE_HEADER *header) {
+  for (int32_t c = 0; c < 3; ++c) {
+    header->bounds_min[c] = header->bounds_max[c] = mesh.positions[c];
+  }
+  for (size_t i = 0; i < mesh.VertexCount(); ++i) {
+    for (int32_t c = 0; c < 3; ++c) {
+      float v = mesh.positions[i * 3 + c];
+      if (v < header->bounds_min[c]) header->bounds_min[c] = v;
+      if (v > header->bounds_max[c]) header->bounds_max[c] = v;
+    }
+  }
+}
+
+/**
+ * 32 byte vertex: float3 position, float3 normal, float2 uv
+ */
+static void BuildFloatVertices(const MeshData &mesh, MESH_FILE_HEADER *header,
+                               std::vector<uint8_t> *vertices) {
+  AddAttribute(header, MESH_SEMANTIC_POSITION, 3, MESH_TYPE_FLOAT, 0,
+               MESH_ENCODING_NONE, 3 * sizeof(float));
+  AddAttribute(header, MESH_SEMANTIC_NORMAL, 3, MESH_TYPE_FLOAT, 0,
+               MESH_ENCODING_NONE, 3 * sizeof(float));
+  AddAttribute(header, MESH_SEMANTIC_UV, 2, MESH_TYPE_FLOAT, 0,
+               MESH_ENCODING_NONE, 2 * sizeof(float));
+  for (int32_t c = 0; c < 3; ++c) {
+    header->position_scale[c] = 1.f;
+    header->position_bias[c] = 0.f;
+  }
+
+  vertices->reserve(mesh.VertexCount() * header->vertex_stride);
+  for (size_t i = 0; i < mesh.VertexCount(); ++i) {
+    Append(vertices, &mesh.positions[i * 3], 3);
+    Append(vertices, &mesh.normals[i * 3], 3);
+    Append(vertices, &mesh.uvs[i * 2], 2);
+  }
+}
+
+/**
+ * 16 byte vertex: unorm16x3 position (+2 bytes padding), octahedral
+ * snorm 10:10:10:2 normal, half2 uv.
+ * Decodes every vertex the way the GPU does and reports the largest error
+ * against the float mesh; fails when it is above what the format promises.
+ */
+static bool BuildQuantizedVertices(const MeshData &mesh,
+                                   MESH_FILE_HEADER *header,
+                                   std::vector<uint8_t> *vertices) {
+  AddAttribute(header, MESH_SEMANTIC_POSITION, 3, MESH_TYPE_UNSIGNED_SHORT, 1,
+               MESH_ENCODING_SCALE_BIAS, 4 * sizeof(uint16_t));
+  AddAttribute(header, MESH_SEMANTIC_NORMAL, 4, MESH_TYPE_INT_2_10_10_10_REV,
+               1, MESH_ENCODING_OCTAHEDRAL, sizeof(uint32_t));
+  AddAttribute(header, MESH_SEMANTIC_UV, 2, MESH_TYPE_HALF_FLOAT, 0,
+               MESH_ENCODING_NONE, 2 * sizeof(uint16_t));
+  for (int32_t c = 0; c < 3; ++c) {
+    float extent = header->bounds_max[c] - header->bounds_min[c];
+    header->position_scale[c] = extent > 0.f ? extent : 1.f;
+    header->position_bias[c] = header->bounds_min[c];
+  }
+
+  float max_position_error = 0.f;
+  float max_normal_error = 0.f;
+  float max_uv_error = 0.f;
+  vertices->reserve(mesh.VertexCount() * header->vertex_stride);
+  for (size_t i = 0; i < mesh.VertexCount(); ++i) {
+    uint16_t position[4] = {0, 0, 0, 0};
+    for (int32_t c = 0; c < 3; ++c) {
+      const float p = mesh.positions[i * 3 + c];
+      const float t =
+          (p - header->position_bias[c]) / header->position_scale[c];
+      position[c] = static_cast<uint16_t>(
+          roundf(std::max(0.f, std::min(1.f, t)) * 65535.f));
+      const float decoded =
+          position[c] / 65535.f * header->position_scale[c] +
+          header->position_bias[c];
+      max_position_error = std::max(max_position_error, fabsf(decoded - p));
+    }
+
+    const uint32_t normal = EncodeNormal(&mesh.normals[i * 3]);
+    float decoded_normal[3];
+    DecodeNormal(normal, decoded_normal);
+    max_normal_error = std::max(
+        max_normal_error, AngleDegrees(&mesh.normals[i * 3], decoded_normal));
+
+    uint16_t uv[2];
+    for (int32_t c = 0; c < 2; ++c) {
+      uv[c] = FloatToHalf(mesh.uvs[i * 2 + c]);
+      max_uv_error = std::max(
+          max_uv_error, fabsf(HalfToFloat(uv[c]) - mesh.uvs[i * 2 + c]));
+    }
+
+    Append(vertices, position, 4);
+    Append(vertices, &normal, 1);
+    Append(vertices, uv, 2);
+  }
+
+  float max_extent = 0.f;
+  for (int32_t c = 0; c < 3; ++c) {
+    max_extent = std::max(max_extent, header->position_scale[c]);
+  }
+  printf("Quantization error: position %g (%g of the bounds), normal %g deg, "
+         "uv %g\n",
+         max_position_error, max_position_error / max_extent,
+         max_normal_error, max_uv_error);
+
+  // Half a 16 bit step plus float rounding, and what 10 bit octahedral
+  // normals reach on typical meshes.
+  const float position_tolerance = max_extent / 65535.f;
+  const float normal_tolerance = 0.5f;
+  if (max_position_error > position_tolerance ||
+      max_normal_error > normal_tolerance) {
+    fprintf(stderr, "Quantization error above tolerance (%g, %g deg)\n",
+            position_tolerance, normal_tolerance);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Interleave the mesh and write it with its header.
+ */
+static bool WriteMesh(const MeshData &mesh, bool quantize,
+                      const char *file_name) {
+  MESH_FILE_HEADER header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kMeshMagic;
+  header.version = kMeshVersion;
+  header.vertex_count = mesh.VertexCount();
+  header.index_count = mesh.indices.size();
+  header.index_type = MESH_TYPE_UNSIGNED_SHORT;
+  ComputeBounds(mesh, &header);
+
+  std::vector<uint8_t> vertices;
+  if (quantize) {
+    if (!BuildQuantizedVertices(mesh, &header, &vertices)) return false;
+  } else {
+    BuildFloatVertices(mesh, &header, &vertices);
+  }
+  const uint32_t vertex_bytes = vertices.size();
+  const uint32_t index_bytes = mesh.indices.size() * sizeof(uint16_t);
+
+  header.vertex_offset = MeshAlign(sizeof(header));
+  header.index_offset = MeshAlign(header.vertex_offset + vertex_bytes);
+
+  std::vector<uint8_t> file(header.index_offset + index_bytes, 0);
+  memcpy(&file[0], &header, sizeof(header));
+  memcpy(&file[header.vertex_offset], vertices.data(), vertex_bytes);
+  memcpy(&file[header.index_offset], mesh.indices.data(), index_bytes);
+
+  if (!ValidateMeshHeader(&header, file.size())) {
+    fprintf(stderr, "Generated an invalid mesh header\n");
+    return false;
+  }
+
+  FILE *f = fopen(file_name, "wb");
+  if (!f) {
+    fprintf(stderr, "Unable to open %s\n", file_name);
+    return false;
+  }
+  bool ok = fwrite(file.data(), 1, file.size(), f) == file.size();
+  ok = fclose(f) == 0 && ok;
+
+  printf("%s: %u vertices (%u bytes/vertex), %u indices, %zu bytes\n",
+         file_name, header.vertex_count, header.vertex_stride,
+         header.index_count, file.size());
+  return ok;
+}
+
+int main(int argc, char *argv[]) {
+  bool tiled = false;
+  bool quantize = false;
+  bool optimize = true;
+  const char *output = NULL;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--tiled") == 0) {
+      tiled = true;
+    } else if (strcmp(argv[i], "--quantize") == 0) {
+      quantize = true;
+    } else if (strcmp(argv[i], "--no-optimize") == 0) {
+      optimize = false;
+    } else if (argv[i][0] != '-' && !output) {
+      output = argv[i];
+    } else {
+      output = NULL;
+      break;
+    }
+  }
+  if (!output) {
+    fprintf(stderr,
+            "usage: %s [--tiled] [--quantize] [--no-optimize] <output.mesh>\n",
+            argv[0]);
+    return 1;
+  }
+
+  MeshData mesh;
+  LoadTeapot(tiled, &mesh);
+  if (optimize) OptimizeMesh(&mesh);
+  return WriteMesh(mesh, quantize, output) ? 0 : 1;
+}
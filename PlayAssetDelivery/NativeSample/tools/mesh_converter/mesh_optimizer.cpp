@@ -0,0 +1,212 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mesh_optimizer.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace {
+
+// Forsyth's tuning values
+const int32_t kCacheSize = 32;
+const float kCacheDecayPower = 1.5f;
+const float kLastTriangleScore = 0.75f;
+const float kValenceBoostScale = 2.0f;
+const float kValenceBoostPower = 0.5f;
+
+float VertexScore(int32_t cache_position, uint32_t remaining_triangles) {
+  if (remaining_triangles == 0) return -1.f;
+
+  float score = 0.f;
+  if (cache_position >= 0) {
+    if (cache_position < 3) {
+      // The last triangle's vertices get a fixed score so the next triangle
+      // is not forced to share an edge with it
+      score = kLastTriangleScore;
+    } else {
+      const float scaler = 1.f / (kCacheSize - 3);
+      score = powf(1.f - (cache_position - 3) * scaler, kCacheDecayPower);
+    }
+  }
+  // Finish off vertices with few triangles left so they leave the cache
+  score += kValenceBoostScale *
+           powf(static_cast<float>(remaining_triangles), -kValenceBoostPower);
+  return score;
+}
+
+}  // namespace
+
+VertexCacheStats AnalyzeVertexCache(const uint16_t *indices,
+                                    size_t index_count, size_t vertex_count,
+                                    uint32_t cache_size) {
+  // FIFO: a vertex is a hit while fewer than cache_size misses happened
+  // since it was last transformed
+  std::vector<uint32_t> timestamps(vertex_count, 0);
+  uint32_t time = cache_size + 1;
+  VertexCacheStats stats = {0, 0.f, 0.f};
+  for (size_t i = 0; i < index_count; ++i) {
+    uint16_t v = indices[i];
+    if (time - timestamps[v] > cache_size) {
+      timestamps[v] = time++;
+      ++stats.transformed;
+    }
+  }
+  const size_t triangle_count = index_count / 3;
+  if (triangle_count) stats.acmr = float(stats.transformed) / triangle_count;
+  if (vertex_count) stats.atvr = float(stats.transformed) / vertex_count;
+  return stats;
+}
+
+void OptimizeVertexCache(uint16_t *indices, size_t index_count,
+                         size_t vertex_count) {
+  const size_t triangle_count = index_count / 3;
+  if (triangle_count == 0) return;
+
+  // Vertex to triangle adjacency in CSR form
+  std::vector<uint32_t> remaining(vertex_count, 0);
+  for (size_t i = 0; i < triangle_count * 3; ++i) ++remaining[indices[i]];
+  std::vector<uint32_t> adjacency_offset(vertex_count + 1, 0);
+  for (size_t v = 0; v < vertex_count; ++v) {
+    adjacency_offset[v + 1] = adjacency_offset[v] + remaining[v];
+  }
+  std::vector<uint32_t> adjacency(triangle_count * 3);
+  {
+    std::vector<uint32_t> fill(adjacency_offset.begin(),
+                               adjacency_offset.end() - 1);
+    for (size_t t = 0; t < triangle_count; ++t) {
+      for (size_t k = 0; k < 3; ++k) {
+        adjacency[fill[indices[t * 3 + k]]++] = t;
+      }
+    }
+  }
+
+  std::vector<int32_t> cache_position(vertex_count, -1);
+  std::vector<float> vertex_score(vertex_count);
+  for (size_t v = 0; v < vertex_count; ++v) {
+    vertex_score[v] = VertexScore(-1, remaining[v]);
+  }
+  std::vector<float> triangle_score(triangle_count);
+  std::vector<bool> emitted(triangle_count, false);
+  for (size_t t = 0; t < triangle_count; ++t) {
+    triangle_score[t] = vertex_score[indices[t * 3]] +
+                        vertex_score[indices[t * 3 + 1]] +
+                        vertex_score[indices[t * 3 + 2]];
+  }
+
+  std::vector<uint16_t> output;
+  output.reserve(triangle_count * 3);
+  // Cache holds up to kCacheSize entries plus the 3 pushed in per triangle
+  std::vector<uint16_t> cache, next_cache;
+  cache.reserve(kCacheSize + 3);
+  next_cache.reserve(kCacheSize + 3);
+  size_t scan_start = 0;
+
+  for (size_t emitted_count = 0; emitted_count < triangle_count;
+       ++emitted_count) {
+    // Best triangle touching the cache; fall back to the first triangle
+    // left when the cache is empty of useful vertices
+    int64_t best = -1;
+    float best_score = -1.f;
+    for (size_t c = 0; c < cache.size(); ++c) {
+      uint16_t v = cache[c];
+      for (uint32_t a = adjacency_offset[v];
+           a < adjacency_offset[v] + remaining[v]; ++a) {
+        uint32_t t = adjacency[a];
+        if (!emitted[t] && triangle_score[t] > best_score) {
+          best_score = triangle_score[t];
+          best = t;
+        }
+      }
+    }
+    if (best < 0) {
+      while (emitted[scan_start]) ++scan_start;
+      best = scan_start;
+    }
+
+    const uint16_t *tri = &indices[best * 3];
+    output.insert(output.end(), tri, tri + 3);
+    emitted[best] = true;
+
+    // Move the triangle's vertices to the front of the LRU cache
+    next_cache.assign(tri, tri + 3);
+    for (size_t k = 0; k < 3; ++k) {
+      uint16_t v = tri[k];
+      --remaining[v];
+      // Drop the triangle from the vertex's live adjacency, which is the
+      // first `remaining` entries of its CSR range
+      uint32_t begin = adjacency_offset[v];
+      uint32_t end = begin + remaining[v];
+      for (uint32_t a = begin; a <= end; ++a) {
+        if (adjacency[a] == static_cast<uint32_t>(best)) {
+          adjacency[a] = adjacency[end];
+          break;
+        }
+      }
+    }
+    for (size_t c = 0; c < cache.size(); ++c) {
+      uint16_t v = cache[c];
+      if (v != tri[0] && v != tri[1] && v != tri[2]) next_cache.push_back(v);
+    }
+    cache.swap(next_cache);
+
+    // Rescore everything that moved in or fell out of the cache
+    for (size_t c = 0; c < cache.size(); ++c) {
+      int32_t position = c < static_cast<size_t>(kCacheSize) ? c : -1;
+      cache_position[cache[c]] = position;
+    }
+    for (size_t c = 0; c < cache.size(); ++c) {
+      uint16_t v = cache[c];
+      float score = VertexScore(cache_position[v], remaining[v]);
+      float delta = score - vertex_score[v];
+      vertex_score[v] = score;
+      for (uint32_t a = adjacency_offset[v];
+           a < adjacency_offset[v] + remaining[v]; ++a) {
+        triangle_score[adjacency[a]] += delta;
+      }
+    }
+    if (cache.size() > static_cast<size_t>(kCacheSize)) {
+      cache.resize(kCacheSize);
+    }
+  }
+
+  std::copy(output.begin(), output.end(), indices);
+}
+
+size_t OptimizeVertexFetch(uint16_t *indices, size_t index_count,
+                           size_t vertex_count, std::vector<uint32_t> *remap) {
+  remap->assign(vertex_count, kUnusedVertex);
+  uint32_t next = 0;
+  for (size_t i = 0; i < index_count; ++i) {
+    uint32_t &slot = (*remap)[indices[i]];
+    if (slot == kUnusedVertex) slot = next++;
+    indices[i] = static_cast<uint16_t>(slot);
+  }
+  return next;
+}
+
+void RemapVertices(const std::vector<uint32_t> &remap, size_t new_count,
+                   size_t components, std::vector<float> *stream) {
+  std::vector<float> result(new_count * components);
+  for (size_t v = 0; v < remap.size(); ++v) {
+    if (remap[v] == kUnusedVertex) continue;
+    for (size_t c = 0; c < components; ++c) {
+      result[remap[v] * components + c] = (*stream)[v * components + c];
+    }
+  }
+  stream->swap(result);
+}
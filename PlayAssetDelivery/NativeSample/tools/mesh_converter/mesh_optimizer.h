@@ -0,0 +1,75 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// mesh_optimizer.h
+// Index and vertex reordering for triangle lists, used by mesh_converter.
+// No dependencies beyond the C++ library, so it can also be built into a
+// runtime loader.
+//--------------------------------------------------------------------------------
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/**
+ * Post-transform cache efficiency of a triangle list, simulated with a FIFO
+ * cache as most mobile GPUs implement it.
+ *   acmr: average cache miss ratio, transformed vertices per triangle
+ *         (0.5 is the ideal for a regular grid, 3 means no reuse at all)
+ *   atvr: average transformed vertex ratio, transformed vertices per vertex
+ *         (1.0 is the ideal)
+ */
+struct VertexCacheStats {
+  uint32_t transformed;
+  float acmr;
+  float atvr;
+};
+
+VertexCacheStats AnalyzeVertexCache(const uint16_t *indices,
+                                    size_t index_count, size_t vertex_count,
+                                    uint32_t cache_size);
+
+/**
+ * Reorder triangles for post-transform cache locality, in place.
+ * Linear-speed vertex cache optimization (T. Forsyth): greedily emits the
+ * triangle with the best score, where vertices score high while they sit in
+ * a simulated LRU cache and while few triangles are left that use them.
+ */
+void OptimizeVertexCache(uint16_t *indices, size_t index_count,
+                         size_t vertex_count);
+
+/**
+ * Renumber vertices in the order the index buffer first references them so
+ * that vertex fetch walks memory linearly. Rewrites the indices in place and
+ * fills remap with new index by old index; unreferenced vertices map to
+ * kUnusedVertex and are dropped. Returns the number of vertices kept.
+ */
+const uint32_t kUnusedVertex = 0xffffffff;
+size_t OptimizeVertexFetch(uint16_t *indices, size_t index_count,
+                           size_t vertex_count, std::vector<uint32_t> *remap);
+
+/**
+ * Apply a remap table from OptimizeVertexFetch() to one vertex stream of
+ * `components` floats per vertex.
+ */
+void RemapVertices(const std::vector<uint32_t> &remap, size_t new_count,
+                   size_t components, std::vector<float> *stream);
+
+#endif  // MESH_OPTIMIZER_H
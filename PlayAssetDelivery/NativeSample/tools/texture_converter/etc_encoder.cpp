@@ -0,0 +1,258 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "etc_encoder.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+
+// Intensity modifier tables, in selector order: +a, +b, -a, -b
+const int32_t kModifiers[8][4] = {
+    {2, 8, -2, -8},       {5, 17, -5, -17},     {9, 29, -9, -29},
+    {13, 42, -13, -42},   {18, 60, -18, -60},   {24, 80, -24, -80},
+    {33, 106, -33, -106}, {47, 183, -47, -183},
+};
+
+struct SUBBLOCK {
+  int32_t pixels[8][3];
+  int32_t positions[8];  // pixel index inside the block, x * 4 + y
+};
+
+struct SUBBLOCK_FIT {
+  int32_t color[3];  // quantized base color, 4 or 5 bits per channel
+  int32_t table;
+  int32_t selectors[8];
+  uint32_t error;
+};
+
+int32_t Clamp255(int32_t v) { return v < 0 ? 0 : (v > 255 ? 255 : v); }
+
+int32_t Expand4(int32_t c) { return (c << 4) | c; }
+int32_t Expand5(int32_t c) { return (c << 3) | (c >> 2); }
+
+/**
+ * Best table and selectors for a subblock around an expanded base color
+ */
+void FitTables(const SUBBLOCK &sub, const int32_t base[3], SUBBLOCK_FIT *fit) {
+  fit->error = 0xffffffff;
+  for (int32_t table = 0; table < 8; ++table) {
+    uint32_t error = 0;
+    int32_t selectors[8];
+    for (int32_t p = 0; p < 8; ++p) {
+      uint32_t best = 0xffffffff;
+      for (int32_t s = 0; s < 4; ++s) {
+        uint32_t e = 0;
+        for (int32_t c = 0; c < 3; ++c) {
+          int32_t d = Clamp255(base[c] + kModifiers[table][s]) -
+                      sub.pixels[p][c];
+          e += d * d;
+        }
+        if (e < best) {
+          best = e;
+          selectors[p] = s;
+        }
+      }
+      error += best;
+      if (error >= fit->error) break;
+    }
+    if (error < fit->error) {
+      fit->error = error;
+      fit->table = table;
+      memcpy(fit->selectors, selectors, sizeof(selectors));
+    }
+  }
+}
+
+/**
+ * Try the rounded average color and its brighter and darker neighbours.
+ * When `reference` is given (differential mode), candidates must stay
+ * within the 3 bit signed delta of it.
+ */
+void FitSubblock(const SUBBLOCK &sub, int32_t bits,
+                 const int32_t *reference, SUBBLOCK_FIT *fit) {
+  const int32_t max = (1 << bits) - 1;
+  float average[3] = {0.f, 0.f, 0.f};
+  for (int32_t p = 0; p < 8; ++p) {
+    for (int32_t c = 0; c < 3; ++c) average[c] += sub.pixels[p][c];
+  }
+
+  fit->error = 0xffffffff;
+  for (int32_t offset = -1; offset <= 1; ++offset) {
+    int32_t color[3];
+    int32_t base[3];
+    bool valid = true;
+    for (int32_t c = 0; c < 3; ++c) {
+      color[c] = static_cast<int32_t>(
+          roundf(average[c] / 8.f * max / 255.f)) + offset;
+      color[c] = std::max(0, std::min(max, color[c]));
+      if (reference) {
+        int32_t delta = color[c] - reference[c];
+        if (delta < -4 || delta > 3) valid = false;
+      }
+      base[c] = bits == 4 ? Expand4(color[c]) : Expand5(color[c]);
+    }
+    if (!valid) continue;
+
+    SUBBLOCK_FIT candidate;
+    FitTables(sub, base, &candidate);
+    if (candidate.error < fit->error) {
+      *fit = candidate;
+      memcpy(fit->color, color, sizeof(color));
+    }
+  }
+}
+
+void PackBlock(bool differential, bool flip, const SUBBLOCK_FIT fits[2],
+               const SUBBLOCK subs[2], uint8_t *out) {
+  for (int32_t c = 0; c < 3; ++c) {
+    if (differential) {
+      int32_t delta = fits[1].color[c] - fits[0].color[c];
+      out[c] = (fits[0].color[c] << 3) | (delta & 7);
+    } else {
+      out[c] = (fits[0].color[c] << 4) | fits[1].color[c];
+    }
+  }
+  out[3] = (fits[0].table << 5) | (fits[1].table << 2) |
+           (differential ? 2 : 0) | (flip ? 1 : 0);
+
+  uint32_t msb = 0, lsb = 0;
+  for (int32_t s = 0; s < 2; ++s) {
+    for (int32_t p = 0; p < 8; ++p) {
+      int32_t selector = fits[s].selectors[p];
+      int32_t position = subs[s].positions[p];
+      msb |= (selector >> 1) << position;
+      lsb |= (selector & 1) << position;
+    }
+  }
+  out[4] = msb >> 8;
+  out[5] = msb & 0xff;
+  out[6] = lsb >> 8;
+  out[7] = lsb & 0xff;
+}
+
+void EncodeBlock(const int32_t block[16][3], uint8_t *out) {
+  uint32_t best_error = 0xffffffff;
+  for (int32_t flip = 0; flip < 2; ++flip) {
+    SUBBLOCK subs[2];
+    int32_t counts[2] = {0, 0};
+    for (int32_t x = 0; x < 4; ++x) {
+      for (int32_t y = 0; y < 4; ++y) {
+        int32_t s = flip ? (y >= 2) : (x >= 2);
+        int32_t n = counts[s]++;
+        memcpy(subs[s].pixels[n], block[y * 4 + x], sizeof(int32_t) * 3);
+        subs[s].positions[n] = x * 4 + y;
+      }
+    }
+
+    // Individual mode, 4 bits per channel each
+    SUBBLOCK_FIT individual[2];
+    FitSubblock(subs[0], 4, nullptr, &individual[0]);
+    FitSubblock(subs[1], 4, nullptr, &individual[1]);
+    uint32_t error = individual[0].error + individual[1].error;
+    if (error < best_error) {
+      best_error = error;
+      PackBlock(false, flip, individual, subs, out);
+    }
+
+    // Differential mode, 5 bits plus a 3 bit delta
+    SUBBLOCK_FIT differential[2];
+    FitSubblock(subs[0], 5, nullptr, &differential[0]);
+    FitSubblock(subs[1], 5, differential[0].color, &differential[1]);
+    if (differential[1].error != 0xffffffff) {
+      error = differential[0].error + differential[1].error;
+      if (error < best_error) {
+        best_error = error;
+        PackBlock(true, flip, differential, subs, out);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+void EncodeEtc2Rgb(const uint8_t *rgba, int32_t width, int32_t height,
+                   std::vector<uint8_t> *blocks) {
+  const int32_t blocks_x = (width + kEtcBlockSize - 1) / kEtcBlockSize;
+  const int32_t blocks_y = (height + kEtcBlockSize - 1) / kEtcBlockSize;
+  blocks->resize(blocks_x * blocks_y * kEtcBlockBytes);
+
+  for (int32_t by = 0; by < blocks_y; ++by) {
+    for (int32_t bx = 0; bx < blocks_x; ++bx) {
+      int32_t block[16][3];
+      for (int32_t y = 0; y < 4; ++y) {
+        for (int32_t x = 0; x < 4; ++x) {
+          int32_t px = std::min(bx * 4 + x, width - 1);
+          int32_t py = std::min(by * 4 + y, height - 1);
+          const uint8_t *p = rgba + (py * width + px) * 4;
+          for (int32_t c = 0; c < 3; ++c) block[y * 4 + x][c] = p[c];
+        }
+      }
+      EncodeBlock(block,
+                  &(*blocks)[(by * blocks_x + bx) * kEtcBlockBytes]);
+    }
+  }
+}
+
+void DecodeEtc2Rgb(const uint8_t *blocks, int32_t width, int32_t height,
+                   std::vector<uint8_t> *rgba) {
+  const int32_t blocks_x = (width + kEtcBlockSize - 1) / kEtcBlockSize;
+  const int32_t blocks_y = (height + kEtcBlockSize - 1) / kEtcBlockSize;
+  rgba->assign(width * height * 4, 255);
+
+  for (int32_t by = 0; by < blocks_y; ++by) {
+    for (int32_t bx = 0; bx < blocks_x; ++bx) {
+      const uint8_t *b = blocks + (by * blocks_x + bx) * kEtcBlockBytes;
+      const bool differential = b[3] & 2;
+      const bool flip = b[3] & 1;
+      const int32_t tables[2] = {b[3] >> 5, (b[3] >> 2) & 7};
+      int32_t bases[2][3];
+      for (int32_t c = 0; c < 3; ++c) {
+        if (differential) {
+          int32_t c1 = b[c] >> 3;
+          int32_t delta = b[c] & 7;
+          if (delta >= 4) delta -= 8;
+          bases[0][c] = Expand5(c1);
+          bases[1][c] = Expand5(c1 + delta);
+        } else {
+          bases[0][c] = Expand4(b[c] >> 4);
+          bases[1][c] = Expand4(b[c] & 0xf);
+        }
+      }
+      const uint32_t msb = (b[4] << 8) | b[5];
+      const uint32_t lsb = (b[6] << 8) | b[7];
+
+      for (int32_t x = 0; x < 4; ++x) {
+        for (int32_t y = 0; y < 4; ++y) {
+          int32_t px = bx * 4 + x;
+          int32_t py = by * 4 + y;
+          if (px >= width || py >= height) continue;
+          int32_t s = flip ? (y >= 2) : (x >= 2);
+          int32_t position = x * 4 + y;
+          int32_t selector =
+              (((msb >> position) & 1) << 1) | ((lsb >> position) & 1);
+          uint8_t *p = &(*rgba)[(py * width + px) * 4];
+          for (int32_t c = 0; c < 3; ++c) {
+            p[c] = Clamp255(bases[s][c] + kModifiers[tables[s]][selector]);
+          }
+        }
+      }
+    }
+  }
+}
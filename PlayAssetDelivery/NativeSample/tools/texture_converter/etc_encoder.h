@@ -0,0 +1,48 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// etc_encoder.h
+// Small ETC2 RGB8 block encoder for texture_converter.
+// Only the ETC1 compatible individual and differential modes are produced,
+// which every ETC2 decoder (and ETC1 hardware) reads. The T, H and planar
+// modes are left out to keep the encoder simple.
+//--------------------------------------------------------------------------------
+#ifndef ETC_ENCODER_H
+#define ETC_ENCODER_H
+
+#include <stdint.h>
+
+#include <vector>
+
+const int32_t kEtcBlockSize = 4;
+const int32_t kEtcBlockBytes = 8;
+
+/**
+ * Encode an RGBA8 image, alpha is ignored. Edge blocks are padded by
+ * repeating the last row and column. Blocks are stored row by row.
+ */
+void EncodeEtc2Rgb(const uint8_t *rgba, int32_t width, int32_t height,
+                   std::vector<uint8_t> *blocks);
+
+/**
+ * Decode blocks written by EncodeEtc2Rgb() back to RGBA8 to measure the
+ * encoding error. Only the ETC1 compatible modes are understood.
+ */
+void DecodeEtc2Rgb(const uint8_t *blocks, int32_t width, int32_t height,
+                   std::vector<uint8_t> *rgba);
+
+#endif  // ETC_ENCODER_H
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// texture_converter.cpp
+// Host tool converting the JPEG textures of the asset packs into KTX files
+// with ETC2 RGB8 payloads and a full mip chain, loaded by Texture.cpp
+// without any decoding.
+//
+// usage: texture_converter <image> [<image> ...]
+//   writes <image without extension>.ktx next to every input and reports
+//   the PSNR of the compressed level 0
+//--------------------------------------------------------------------------------
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <third_party/stb/stb_image.h>
+
+#include "KtxFormat.h"
+#include "MipChain.h"
+#include "etc_encoder.h"
+
+static const uint32_t kGlRgb = 0x1907;  // GL_RGB
+
+/**
+ * Peak signal to noise ratio over the RGB channels, in dB
+ */
+static double Psnr(const std::vector<uint8_t> &a, const uint8_t *b,
+                   size_t pixels) {
+  double sum = 0.0;
+  for (size_t i = 0; i < pixels; ++i) {
+    for (int32_t c = 0; c < 3; ++c) {
+      double d = static_cast<double>(a[i * 4 + c]) - b[i * 4 + c];
+      sum += d * d;
+    }
+  }
+  double mse = sum / (pixels * 3);
+  return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+static void AppendUint32(std::vector<uint8_t> *out, uint32_t value) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+  out->insert(out->end(), bytes, bytes + sizeof(value));
+}
+
+/**
+ * KTX 1.1 with ETC2 RGB8 levels, largest first. Rows are stored bottom
+ * first as OpenGL expects, recorded in the KTXorientation key.
+ */
+static bool WriteKtx(const char *file_name, int32_t width, int32_t height,
+                     const std::vector<std::vector<uint8_t> > &levels) {
+  static const char kOrientation[] = "KTXorientation\0S=r,T=u";
+  std::vector<uint8_t> key_values;
+  AppendUint32(&key_values, sizeof(kOrientation));
+  key_values.insert(key_values.end(), kOrientation,
+                    kOrientation + sizeof(kOrientation));
+  key_values.resize((key_values.size() + 3) & ~3u, 0);
+
+  KTX1_HEADER header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.identifier, kKtx1Identifier, sizeof(kKtx1Identifier));
+  header.endianness = kKtxEndianness;
+  header.gl_type_size = 1;
+  header.gl_internal_format = KTX_FORMAT_ETC2_RGB8;
+  header.gl_base_internal_format = kGlRgb;
+  header.pixel_width = width;
+  header.pixel_height = height;
+  header.number_of_faces = 1;
+  header.number_of_mipmap_levels = levels.size();
+  header.bytes_of_key_value_data = key_values.size();
+
+  std::vector<uint8_t> file(reinterpret_cast<const uint8_t *>(&header),
+                            reinterpret_cast<const uint8_t *>(&header + 1));
+  file.insert(file.end(), key_values.begin(), key_values.end());
+  // ETC blocks are 8 bytes, no mip padding needed
+  for (size_t i = 0; i < levels.size(); ++i) {
+    AppendUint32(&file, levels[i].size());
+    file.insert(file.end(), levels[i].begin(), levels[i].end());
+  }
+
+  // Make sure the loader accepts what we wrote
+  KTX_TEXTURE check;
+  if (!ParseKtx(file.data(), file.size(), &check)) {
+    fprintf(stderr, "Generated an invalid KTX file\n");
+    return false;
+  }
+
+  FILE *f = fopen(file_name, "wb");
+  if (!f) {
+    fprintf(stderr, "Unable to open %s\n", file_name);
+    return false;
+  }
+  bool ok = fwrite(file.data(), 1, file.size(), f) == file.size();
+  ok = fclose(f) == 0 && ok;
+  return ok;
+}
+
+static bool Convert(const char *input) {
+  // Match the runtime decoder, which flips images for OpenGL
+  stbi_set_flip_vertically_on_load(1);
+  int32_t width, height, channels;
+  uint8_t *rgba = stbi_load(input, &width, &height, &channels, 4);
+  if (!rgba) {
+    fprintf(stderr, "Unable to decode %s\n", input);
+    return false;
+  }
+
+  // Filter the uncompressed image, so errors don't add up along the chain
+  MIP_CHAIN mips;
+  BuildMipChain(rgba, width, height, &mips);
+  std::vector<std::vector<uint8_t> > levels(MipLevelCount(width, height));
+  size_t total = 0;
+  for (size_t level = 0; level < levels.size(); ++level) {
+    const uint8_t *pixels =
+        level == 0 ? rgba : &mips.pixels[mips.offsets[level - 1]];
+    EncodeEtc2Rgb(pixels, MipLevelSize(width, level),
+                  MipLevelSize(height, level), &levels[level]);
+    total += levels[level].size();
+  }
+
+  std::vector<uint8_t> decoded;
+  DecodeEtc2Rgb(levels[0].data(), width, height, &decoded);
+  double psnr = Psnr(decoded, rgba, static_cast<size_t>(width) * height);
+  stbi_image_free(rgba);
+
+  std::string output(input);
+  size_t dot = output.rfind('.');
+  if (dot != std::string::npos) output.resize(dot);
+  output += ".ktx";
+  if (!WriteKtx(output.c_str(), width, height, levels)) return false;
+
+  printf("%s: %dx%d ETC2 RGB8, %zu levels, %zu bytes (RGBA8 level 0 %d "
+         "bytes), PSNR %.2f dB\n",
+         output.c_str(), width, height, levels.size(), total,
+         width * height * 4, psnr);
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <image> [<image> ...]\n", argv[0]);
+    return 1;
+  }
+  bool ok = true;
+  for (int i = 1; i < argc; ++i) {
+    ok = Convert(argv[i]) && ok;
+  }
+  return ok ? 0 : 1;
+}
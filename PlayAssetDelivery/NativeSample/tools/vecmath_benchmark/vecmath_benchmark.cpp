@@ -0,0 +1,174 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// vecmath_benchmark.cpp
+// Host tool timing the NEON/SSE paths of common/ndk_helper/vecmath.h
+// against the C++ ones (NDK_HELPER_VECMATH_SCALAR), on the same random
+// matrices and vectors. Fails unless both give the same results bit for
+// bit, as vecmath promises.
+//
+// usage: vecmath_benchmark [--count N] [--runs N]
+//   --count  matrices or vectors per operation, 1024 by default
+//   --runs   timed runs per operation, the best is kept, 20 by default
+//--------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "vecmath_kernels.h"
+
+static double NowNs() {
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Reproducible from run to run, in [-2, 2)
+static void FillRandom(std::vector<float>* values, uint32_t seed) {
+  for (size_t i = 0; i < values->size(); ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    (*values)[i] = (seed >> 8) / static_cast<float>(1 << 22) - 2.f;
+  }
+}
+
+/*
+ * Best of runs, in ns per item. Each run repeats the operation until it
+ * has taken a millisecond, so short ones aren't lost in the timer.
+ */
+template <typename F>
+static double Measure(int32_t runs, int32_t items, F run) {
+  double best = 0.0;
+  for (int32_t i = 0; i < runs; ++i) {
+    int32_t repeats = 0;
+    double start = NowNs();
+    double ns;
+    do {
+      run();
+      ++repeats;
+      ns = NowNs() - start;
+    } while (ns < 1e6);
+    ns /= static_cast<double>(repeats) * items;
+    if (i == 0 || ns < best) best = ns;
+  }
+  return best;
+}
+
+static bool g_mismatch = false;
+
+static void Report(const char* name, double simd_ns, double scalar_ns,
+                   const std::vector<float>& simd,
+                   const std::vector<float>& scalar) {
+  bool same = memcmp(simd.data(), scalar.data(),
+                     simd.size() * sizeof(float)) == 0;
+  printf("  %-16s %8.2f %8.2f ns/item %6.2fx%s\n", name, simd_ns, scalar_ns,
+         simd_ns > 0 ? scalar_ns / simd_ns : 0.0,
+         same ? "" : "  results differ");
+  if (!same) g_mismatch = true;
+}
+
+int main(int argc, char** argv) {
+  int32_t count = 1024;
+  int32_t runs = 20;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--count") && i + 1 < argc) {
+      count = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--runs") && i + 1 < argc) {
+      runs = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--count N] [--runs N]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (count <= 0 || runs <= 0) {
+    fprintf(stderr, "Counts must be positive\n");
+    return 1;
+  }
+
+  std::vector<float> lhs(count * 16);
+  std::vector<float> rhs(count * 16);
+  std::vector<float> vectors(count * 4);
+  FillRandom(&lhs, 1);
+  FillRandom(&rhs, 2);
+  FillRandom(&vectors, 3);
+
+  const VECMATH_KERNELS& simd = kSimdKernels;
+  const VECMATH_KERNELS& scalar = kScalarKernels;
+  std::vector<float> simd_out(count * 16);
+  std::vector<float> scalar_out(count * 16);
+  printf("%s against %s, %d items\n", simd.name, scalar.name, count);
+  printf("  %-16s %8s %8s\n", "", simd.name, scalar.name);
+
+  double simd_ns = Measure(runs, count, [&] {
+    simd.mat4_mul_mat4(lhs.data(), rhs.data(), simd_out.data(), count);
+  });
+  double scalar_ns = Measure(runs, count, [&] {
+    scalar.mat4_mul_mat4(lhs.data(), rhs.data(), scalar_out.data(), count);
+  });
+  Report("Mat4 * Mat4", simd_ns, scalar_ns, simd_out, scalar_out);
+
+  simd_out.assign(count * 4, 0.f);
+  scalar_out.assign(count * 4, 0.f);
+  simd_ns = Measure(runs, count, [&] {
+    simd.mat4_mul_vec4(lhs.data(), vectors.data(), simd_out.data(), count);
+  });
+  scalar_ns = Measure(runs, count, [&] {
+    scalar.mat4_mul_vec4(lhs.data(), vectors.data(), scalar_out.data(),
+                         count);
+  });
+  Report("Mat4 * Vec4", simd_ns, scalar_ns, simd_out, scalar_out);
+
+  simd_out.assign(count * 16, 0.f);
+  scalar_out.assign(count * 16, 0.f);
+  simd_ns = Measure(runs, count, [&] {
+    simd.multiply_pairs(lhs.data(), rhs.data(), simd_out.data(), count);
+  });
+  scalar_ns = Measure(runs, count, [&] {
+    scalar.multiply_pairs(lhs.data(), rhs.data(), scalar_out.data(), count);
+  });
+  Report("Multiply pairs", simd_ns, scalar_ns, simd_out, scalar_out);
+
+  simd_out.assign(count * 16, 0.f);
+  scalar_out.assign(count * 16, 0.f);
+  simd_ns = Measure(runs, count, [&] {
+    simd.multiply_one(lhs.data(), rhs.data(), simd_out.data(), count);
+  });
+  scalar_ns = Measure(runs, count, [&] {
+    scalar.multiply_one(lhs.data(), rhs.data(), scalar_out.data(), count);
+  });
+  Report("Multiply one", simd_ns, scalar_ns, simd_out, scalar_out);
+
+  simd_out.assign(count * 4, 0.f);
+  scalar_out.assign(count * 4, 0.f);
+  simd.load_array(vectors.data(), count);
+  scalar.load_array(vectors.data(), count);
+  simd_ns = Measure(runs, count, [&] { simd.transform_array(lhs.data()); });
+  scalar_ns =
+      Measure(runs, count, [&] { scalar.transform_array(lhs.data()); });
+  simd.read_array(simd_out.data());
+  scalar.read_array(scalar_out.data());
+  Report("Transform", simd_ns, scalar_ns, simd_out, scalar_out);
+
+  if (g_mismatch) {
+    fprintf(stderr, "The SIMD and scalar paths disagree\n");
+    return 1;
+  }
+  return 0;
+}
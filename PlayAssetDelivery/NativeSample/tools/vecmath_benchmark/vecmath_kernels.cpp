@@ -0,0 +1,105 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// vecmath_kernels.cpp
+// Built once as is and once with NDK_HELPER_VECMATH_SCALAR, with ndk_helper
+// defined to another namespace so both copies of vecmath link together.
+//--------------------------------------------------------------------------------
+#include "vecmath_kernels.h"
+
+#include "vecmath.h"
+
+using ndk_helper::Mat4;
+using ndk_helper::Vec4;
+using ndk_helper::Vec4Array;
+
+// The floats are read and written in place as Mat4 and Vec4
+static_assert(sizeof(Mat4) == 16 * sizeof(float), "Mat4 is not 16 floats");
+static_assert(sizeof(Vec4) == 4 * sizeof(float), "Vec4 is not 4 floats");
+
+namespace {
+
+Vec4Array g_in;
+Vec4Array g_out;
+
+void Mat4MulMat4(const float* lhs, const float* rhs, float* out,
+                 int32_t count) {
+  const Mat4* l = reinterpret_cast<const Mat4*>(lhs);
+  const Mat4* r = reinterpret_cast<const Mat4*>(rhs);
+  Mat4* o = reinterpret_cast<Mat4*>(out);
+  for (int32_t i = 0; i < count; ++i) o[i] = l[i] * r[i];
+}
+
+void Mat4MulVec4(const float* lhs, const float* rhs, float* out,
+                 int32_t count) {
+  const Mat4* l = reinterpret_cast<const Mat4*>(lhs);
+  const Vec4* r = reinterpret_cast<const Vec4*>(rhs);
+  Vec4* o = reinterpret_cast<Vec4*>(out);
+  for (int32_t i = 0; i < count; ++i) o[i] = l[i] * r[i];
+}
+
+void MultiplyPairs(const float* lhs, const float* rhs, float* out,
+                   int32_t count) {
+  Mat4::Multiply(reinterpret_cast<const Mat4*>(lhs),
+                 reinterpret_cast<const Mat4*>(rhs),
+                 reinterpret_cast<Mat4*>(out), count);
+}
+
+void MultiplyOne(const float* lhs, const float* rhs, float* out,
+                 int32_t count) {
+  Mat4::Multiply(*reinterpret_cast<const Mat4*>(lhs),
+                 reinterpret_cast<const Mat4*>(rhs),
+                 reinterpret_cast<Mat4*>(out), count);
+}
+
+void LoadArray(const float* vectors, int32_t count) {
+  g_in.Resize(count);
+  g_out.Resize(count);
+  for (int32_t i = 0; i < count; ++i) {
+    g_in.Set(i, Vec4(vectors[i * 4], vectors[i * 4 + 1], vectors[i * 4 + 2],
+                     vectors[i * 4 + 3]));
+  }
+}
+
+void TransformArray(const float* matrix) {
+  reinterpret_cast<const Mat4*>(matrix)->Transform(g_in, &g_out);
+}
+
+void ReadArray(float* vectors) {
+  for (int32_t i = 0; i < g_out.Size(); ++i) {
+    g_out.Get(i).Value(vectors[i * 4], vectors[i * 4 + 1], vectors[i * 4 + 2],
+                       vectors[i * 4 + 3]);
+  }
+}
+
+}  // namespace
+
+#if defined(NDK_HELPER_VECMATH_SCALAR)
+extern const VECMATH_KERNELS kScalarKernels = {
+    "scalar",
+#else
+extern const VECMATH_KERNELS kSimdKernels = {
+#if defined(NDK_HELPER_VECMATH_NEON)
+    "NEON",
+#elif defined(NDK_HELPER_VECMATH_SSE)
+    "SSE",
+#else
+    "scalar (no SIMD path for this target)",
+#endif
+#endif
+    Mat4MulMat4, Mat4MulVec4, MultiplyPairs, MultiplyOne,
+    LoadArray,   TransformArray, ReadArray};
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VECMATH_KERNELS_H_
+#define VECMATH_KERNELS_H_
+
+#include <stdint.h>
+
+/*
+ * The vecmath operations under test. vecmath_kernels.cpp is built twice,
+ * with the NEON/SSE paths and with NDK_HELPER_VECMATH_SCALAR, each copy in
+ * a namespace of its own. Matrices are column major, 16 floats each, and
+ * vectors 4 floats each.
+ */
+struct VECMATH_KERNELS {
+  const char* name;
+  // out[i] = lhs[i] * rhs[i], with Mat4::operator*
+  void (*mat4_mul_mat4)(const float* lhs, const float* rhs, float* out,
+                        int32_t count);
+  // out[i] = lhs[i] * rhs[i], with Mat4::operator*(const Vec4&)
+  void (*mat4_mul_vec4)(const float* lhs, const float* rhs, float* out,
+                        int32_t count);
+  // out[i] = lhs[i] * rhs[i], with the batched Mat4::Multiply()
+  void (*multiply_pairs)(const float* lhs, const float* rhs, float* out,
+                         int32_t count);
+  // out[i] = lhs * rhs[i], with the batched Mat4::Multiply()
+  void (*multiply_one)(const float* lhs, const float* rhs, float* out,
+                       int32_t count);
+  // Mat4::Transform() of a Vec4Array filled by load_array() beforehand
+  void (*load_array)(const float* vectors, int32_t count);
+  void (*transform_array)(const float* matrix);
+  void (*read_array)(float* vectors);
+};
+
+extern const VECMATH_KERNELS kSimdKernels;
+extern const VECMATH_KERNELS kScalarKernels;
+
+#endif /* VECMATH_KERNELS_H_ */